@@ -1,20 +1,42 @@
-#version 330
+#version 430
+
+// see world.vert for the feature defines
 
 uniform sampler2D diffuseTex;
-uniform float alphaMask;
 
 in VertexData
 {
     vec2 uv;
+#if defined(VERTEX_COLOR)
     vec4 color;
+#endif
+#if defined(LIGHTING)
+    vec3 normal;
+#endif
 } inData;
 
 out vec4 fragColor;
 
 void main()
 {
-	vec4 diffuseColor = texture2D(diffuseTex, inData.uv);
+    vec4 diffuseColor = texture(diffuseTex, inData.uv);
+
+#if defined(ALPHA_TEST)
+    if (diffuseColor.a < 0.5)
+        discard;
+#endif
+
+#if defined(VERTEX_COLOR)
+    diffuseColor *= inData.color;
+#endif
+
+#if defined(LIGHTING)
+    vec3 n = normalize(inData.normal);
+    vec3 light0Position = normalize(vec3(-0.4, 0.5, -0.6));
+    float NdotL0 = clamp(dot(n, light0Position), 0.0, 1.0);
+    vec3 diffuse = clamp(vec3(NdotL0 + 0.5), 0.0, 1.0);
+    diffuseColor = vec4(diffuseColor.rgb * diffuse, 1.0);
+#endif
 
-	if (diffuseColor.a < alphaMask) discard;
-	else fragColor = diffuseColor * inData.color;
+    fragColor = diffuseColor;
 }
\ No newline at end of file
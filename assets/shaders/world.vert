@@ -1,21 +1,117 @@
-#version 330
+#version 430
 
+// One source for every world program, features are switched on with the defines ShaderVariants prepends:
+// INSTANCED, BILLBOARD, SKINNED, ALPHA_TEST, VERTEX_COLOR, LIGHTING
+
+// only skinned vertices carry a normal to light with
+#if defined(LIGHTING) && !defined(SKINNED)
+#error LIGHTING needs SKINNED
+#endif
+
+#if defined(BILLBOARD)
+layout(location = 0) in vec2 vertex;
+layout(location = 1) in vec3 offset;
+layout(location = 2) in vec2 size;
+layout(location = 3) in vec4 color;
+layout(location = 4) in mat4x2 uvs;
+#elif defined(SKINNED)
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec2 normal; // octahedral
+layout(location = 2) in vec2 uv;
+layout(location = 3) in vec4 boneWeights;
+layout(location = 4) in uvec4 boneIndices;
+#else
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec2 uv;
 layout(location = 2) in vec4 color;
+#endif
+
+#if defined(INSTANCED)
+layout(location = 3) in uvec2 instanceRef; // x = transform index, y = material index
+#endif
 
 out VertexData
 {
     vec2 uv;
+#if defined(VERTEX_COLOR)
     vec4 color;
+#endif
+#if defined(LIGHTING)
+    vec3 normal;
+#endif
 } outData;
 
-uniform mat4 viewProj;
+layout(std140) uniform FrameBlock
+{
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+    vec4 time;
+};
+
+#if defined(INSTANCED)
+layout(std430, binding = 0) readonly buffer InstanceTransforms
+{
+    mat4 transforms[];
+};
+#elif defined(SKINNED)
+// every character's bones for the frame, 3 texels per bone holding the rows of an affine transform
+uniform samplerBuffer boneBuffer;
+uniform int boneBase; // where this draw's palette starts
+
+void AddBone(uint index, float weight, inout vec4 row0, inout vec4 row1, inout vec4 row2)
+{
+    int texel = (boneBase + int(index)) * 3;
+    row0 += texelFetch(boneBuffer, texel + 0) * weight;
+    row1 += texelFetch(boneBuffer, texel + 1) * weight;
+    row2 += texelFetch(boneBuffer, texel + 2) * weight;
+}
+
+vec3 OctDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+
+    return normalize(n);
+}
+#elif !defined(BILLBOARD)
+layout(std140) uniform ObjectBlock
+{
+    mat4 model;
+};
+#endif
 
 void main()
 {
+#if defined(BILLBOARD)
+    outData.uv = uvs[gl_VertexID];
+
+    vec4 p = viewProj * vec4(vec3(vertex.xy * vec2(0, size.y), 0) + offset, 1.0);
+    p.x += vertex.x * size.x;
+    gl_Position = p;
+#elif defined(SKINNED)
+    vec4 row0 = vec4(0.0), row1 = vec4(0.0), row2 = vec4(0.0);
+    AddBone(boneIndices[0], boneWeights[0], row0, row1, row2);
+    AddBone(boneIndices[1], boneWeights[1], row0, row1, row2);
+    AddBone(boneIndices[2], boneWeights[2], row0, row1, row2);
+
+    vec4 p = vec4(position, 1.0);
+
     outData.uv = uv;
-    outData.color = color;
+    gl_Position = viewProj * vec4(dot(row0, p), dot(row1, p), dot(row2, p), 1.0);
+#elif defined(INSTANCED)
+    outData.uv = uv;
+    gl_Position = viewProj * transforms[instanceRef.x] * vec4(position, 1.0);
+#else
+    outData.uv = uv;
+    gl_Position = viewProj * model * vec4(position, 1.0);
+#endif
 
-	gl_Position = viewProj * vec4(position, 1.0);
+#if defined(VERTEX_COLOR)
+    outData.color = color;
+#endif
+#if defined(LIGHTING)
+    outData.normal = OctDecode(normal);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,457 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include "Benchmark.h"
+
+#include "Core/File.h"
+#include "Core/FileSystem.h"
+#include "Core/Math/Math.h"
+#include "Render/OpenGL/StateCache.h"
+
+#include <SDL.h>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace Donut
+{
+
+static const float kOrbitRadius = 20.0f;
+
+static const char* kSectionNames[] = {"streaming", "physics", "update", "render"};
+static_assert(sizeof(kSectionNames) / sizeof(kSectionNames[0]) == (std::size_t)Benchmark::Section::Count);
+
+static double elapsedMs(uint64_t start, uint64_t end)
+{
+	return (end - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+static int parseInt(const std::string& flag, const char* value)
+{
+	try
+	{
+		return std::stoi(value);
+	}
+	catch (const std::exception&)
+	{
+		throw std::runtime_error(fmt::format("{0} expects a number, got '{1}'", flag, value));
+	}
+}
+
+static double parseDouble(const std::string& flag, const char* value)
+{
+	try
+	{
+		return std::stod(value);
+	}
+	catch (const std::exception&)
+	{
+		throw std::runtime_error(fmt::format("{0} expects a number, got '{1}'", flag, value));
+	}
+}
+
+static std::string escapeJson(const std::string& str)
+{
+	std::string escaped;
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+		escaped += c;
+	}
+
+	return escaped;
+}
+
+// just enough to read numbers back out of our own output
+static bool readJsonNumber(const std::string& json, const std::string& key, double& value)
+{
+	const auto keyPos = json.find("\"" + key + "\"");
+	if (keyPos == std::string::npos)
+		return false;
+
+	const auto colon = json.find(':', keyPos);
+	if (colon == std::string::npos)
+		return false;
+
+	char* end = nullptr;
+	value = std::strtod(json.c_str() + colon + 1, &end);
+	return end != json.c_str() + colon + 1;
+}
+
+// nearest rank
+static double percentile(std::vector<double> values, double p)
+{
+	if (values.empty())
+		return 0.0;
+
+	std::sort(values.begin(), values.end());
+	const auto rank = static_cast<std::size_t>(std::ceil(p * values.size()));
+	return values[std::min(std::max(rank, std::size_t(1)), values.size()) - 1];
+}
+
+Benchmark::ScopedSection::ScopedSection(Benchmark& benchmark, Section section)
+    : _benchmark(benchmark), _section(section), _start(SDL_GetPerformanceCounter())
+{
+}
+
+Benchmark::ScopedSection::~ScopedSection()
+{
+	if (_benchmark._frame < (int)_benchmark._samples.size())
+		_benchmark._samples[_benchmark._frame].sectionMs[(std::size_t)_section] +=
+		    elapsedMs(_start, SDL_GetPerformanceCounter());
+}
+
+Benchmark::Options Benchmark::ParseArgs(int argc, char** argv)
+{
+	Options options;
+	bool benchRequested = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if (arg == "--headless")
+		{
+			options.headless = true;
+			continue;
+		}
+
+		if (arg != "--bench" && arg.rfind("--bench-", 0) != 0)
+			continue;
+
+		if (value == nullptr)
+			throw std::runtime_error(fmt::format("{0} is missing its value", arg));
+
+		if (arg == "--bench")
+		{
+			benchRequested = true;
+			if (std::strcmp(value, "orbit") == 0)
+				options.mode = Mode::Orbit;
+			else if (std::strcmp(value, "flythrough") == 0)
+				options.mode = Mode::Flythrough;
+			else
+				throw std::runtime_error(fmt::format("unknown benchmark '{0}', expected orbit or flythrough", value));
+		}
+		else if (arg == "--bench-frames")
+		{
+			options.frames = parseInt(arg, value);
+			if (options.frames <= 0)
+				throw std::runtime_error(fmt::format("--bench-frames expects a positive count, got '{0}'", value));
+		}
+		else if (arg == "--bench-warmup")
+		{
+			options.warmupFrames = parseInt(arg, value);
+			if (options.warmupFrames < 0)
+				throw std::runtime_error(fmt::format("--bench-warmup can't be negative, got '{0}'", value));
+		}
+		else if (arg == "--bench-out")
+			options.outputPath = value;
+		else if (arg == "--bench-hitch")
+			options.hitchMs = parseDouble(arg, value);
+		else if (arg == "--bench-baseline")
+			options.baselinePath = value;
+		else if (arg == "--bench-trace")
+			options.tracePath = value;
+		else if (arg == "--bench-tolerance")
+			options.tolerance = parseDouble(arg, value) / 100.0;
+		else if (arg == "--bench-size")
+		{
+			if (std::sscanf(value, "%dx%d", &options.width, &options.height) != 2 || options.width <= 0 || options.height <= 0)
+				throw std::runtime_error(fmt::format("--bench-size expects <width>x<height>, got '{0}'", value));
+		}
+		else
+			throw std::runtime_error(fmt::format("unknown benchmark option {0}", arg));
+
+		i++;
+	}
+
+	// a flythrough runs as long as its path takes, a frame count would be silently replaced
+	if (options.mode == Mode::Flythrough && options.frames > 0)
+		throw std::runtime_error("--bench-frames doesn't apply to a flythrough, its length comes from the path");
+
+	// nothing to look at without a window, so headless always benchmarks
+	if ((benchRequested || options.headless) && options.frames <= 0)
+		options.frames = 600;
+
+	return options;
+}
+
+Benchmark::Benchmark(const Options& options): _options(options), _frame(0), _frameStart(0)
+{
+	glGenQueries((GLsizei)_queries.size(), _queries.data());
+	_queryFrames.fill(-1);
+	_samples.resize(_options.warmupFrames + _options.frames, FrameSample {});
+}
+
+Benchmark::~Benchmark()
+{
+	glDeleteQueries((GLsizei)_queries.size(), _queries.data());
+}
+
+void Benchmark::SetPath(std::vector<Waypoint> waypoints, double deltaTime)
+{
+	_waypoints = std::move(waypoints);
+	_legFirstFrame.assign(1, 0);
+
+	const double stepLength = _options.flySpeed * deltaTime;
+	for (std::size_t i = 0; i + 1 < _waypoints.size(); ++i)
+	{
+		const double length = (_waypoints[i + 1].position - _waypoints[i].position).Length();
+		const int frames = std::max(1, static_cast<int>(std::ceil(length / stepLength)));
+		_legFirstFrame.push_back(_legFirstFrame.back() + frames);
+	}
+
+	_options.frames = std::max(_legFirstFrame.back(), 1);
+	_samples.assign(_options.warmupFrames + _options.frames, FrameSample {});
+}
+
+std::size_t Benchmark::legAt(int frame, float& t) const
+{
+	const int measured = std::max(frame - _options.warmupFrames, 0);
+	const std::size_t legCount = _legFirstFrame.size() - 1;
+
+	const auto next = std::upper_bound(_legFirstFrame.begin(), _legFirstFrame.end(), measured);
+	const std::size_t leg = std::min(static_cast<std::size_t>(next - _legFirstFrame.begin()) - 1, legCount - 1);
+
+	const int first = _legFirstFrame[leg], last = _legFirstFrame[leg + 1];
+	t = std::min(static_cast<float>(measured - first) / (last - first), 1.0f);
+	return leg;
+}
+
+void Benchmark::GetCameraPose(const Vector3& origin, Vector3& position, Quaternion& orientation) const
+{
+	if (_options.mode == Mode::Flythrough && _waypoints.size() >= 2)
+	{
+		float t = 0.0f;
+		const std::size_t leg = legAt(_frame, t);
+		const Vector3& from = _waypoints[leg].position;
+		const Vector3 direction = _waypoints[leg + 1].position - from;
+
+		position = from + direction * t;
+		orientation = Quaternion(Vector3::Up, -std::atan2(direction.X, direction.Z));
+		return;
+	}
+
+	if (_options.mode == Mode::Flythrough && !_waypoints.empty())
+	{
+		position = _waypoints[0].position;
+		orientation = Quaternion::Identity;
+		return;
+	}
+
+	const float t =
+	    _options.frames > 0 ? static_cast<float>(std::max(_frame - _options.warmupFrames, 0)) / _options.frames : 0.0f;
+	const float angle = t * 2.0f * Math::Pi;
+
+	position = origin + Vector3(Math::Cos(angle) * kOrbitRadius, 0.0f, Math::Sin(angle) * kOrbitRadius);
+	orientation = Quaternion(Vector3::Up, -angle);
+}
+
+const std::string& Benchmark::GetStreamRequest() const
+{
+	static const std::string none;
+
+	if (_options.mode != Mode::Flythrough || _waypoints.empty())
+		return none;
+
+	// the first waypoint is loaded up front, the rest as each leg heads towards them
+	if (_frame == 0)
+		return _waypoints[0].regions;
+
+	const int measured = _frame - _options.warmupFrames;
+	if (measured < 0 || _waypoints.size() < 2)
+		return none;
+
+	const auto leg = std::lower_bound(_legFirstFrame.begin(), _legFirstFrame.end() - 1, measured);
+	if (leg == _legFirstFrame.end() - 1 || *leg != measured)
+		return none;
+
+	return _waypoints[(leg - _legFirstFrame.begin()) + 1].regions;
+}
+
+void Benchmark::BeginFrame()
+{
+	// the slot's last result is kQueryLatency frames old, long done on any sane driver
+	const std::size_t slot = _frame % kQueryLatency;
+	collectQuery(slot);
+
+	GL::StateCache::ResetStats();
+
+	_frameStart = SDL_GetPerformanceCounter();
+	glBeginQuery(GL_TIME_ELAPSED, _queries[slot]);
+	_queryFrames[slot] = _frame;
+}
+
+void Benchmark::EndFrame()
+{
+	glEndQuery(GL_TIME_ELAPSED);
+
+	auto& sample = _samples[_frame];
+	sample.cpuMs = elapsedMs(_frameStart, SDL_GetPerformanceCounter());
+	sample.draws = GL::StateCache::GetStats().draws;
+	sample.stateCalls = GL::StateCache::GetStats().issued;
+
+	_frame++;
+
+	if (IsDone())
+	{
+		for (std::size_t slot = 0; slot < kQueryLatency; ++slot) collectQuery(slot);
+	}
+}
+
+void Benchmark::collectQuery(std::size_t slot)
+{
+	if (_queryFrames[slot] < 0)
+		return;
+
+	GLuint64 elapsed = 0;
+	glGetQueryObjectui64v(_queries[slot], GL_QUERY_RESULT, &elapsed);
+	_samples[_queryFrames[slot]].gpuMs = elapsed / 1000000.0;
+	_queryFrames[slot] = -1;
+}
+
+Benchmark::Summary Benchmark::summarize() const
+{
+	Summary summary {};
+
+	std::vector<double> cpu, gpu;
+	for (auto it = _samples.begin() + _options.warmupFrames; it != _samples.end(); ++it)
+	{
+		cpu.push_back(it->cpuMs);
+		gpu.push_back(it->gpuMs);
+		summary.drawsMean += it->draws;
+
+		for (std::size_t i = 0; i < summary.sectionMeanMs.size(); ++i) summary.sectionMeanMs[i] += it->sectionMs[i];
+
+		if (it->cpuMs > _options.hitchMs)
+			summary.hitches++;
+
+		// any frame that had to wait on the loader
+		const double streamMs = it->sectionMs[(std::size_t)Section::Streaming];
+		if (streamMs >= 1.0)
+		{
+			summary.loadStalls++;
+			summary.loadStallTotalMs += streamMs;
+			summary.loadStallMaxMs = std::max(summary.loadStallMaxMs, streamMs);
+		}
+	}
+
+	const double count = std::max<double>(cpu.size(), 1.0);
+	summary.drawsMean /= count;
+	for (auto& mean : summary.sectionMeanMs) mean /= count;
+
+	summary.cpuP50 = percentile(cpu, 0.50);
+	summary.cpuP95 = percentile(cpu, 0.95);
+	summary.cpuP99 = percentile(cpu, 0.99);
+	summary.cpuMax = cpu.empty() ? 0.0 : *std::max_element(cpu.begin(), cpu.end());
+	summary.gpuP50 = percentile(gpu, 0.50);
+	summary.gpuP95 = percentile(gpu, 0.95);
+	summary.gpuP99 = percentile(gpu, 0.99);
+	summary.gpuMax = gpu.empty() ? 0.0 : *std::max_element(gpu.begin(), gpu.end());
+
+	return summary;
+}
+
+bool Benchmark::WriteJson() const
+{
+	std::ofstream file(_options.outputPath);
+	if (!file)
+	{
+		fprintf(stderr, "Could not write benchmark results to %s\n", _options.outputPath.c_str());
+		return false;
+	}
+
+	const Summary summary = summarize();
+	const char* mode = _options.mode == Mode::Flythrough ? "flythrough" : "orbit";
+
+	std::string sections;
+	for (std::size_t i = 0; i < summary.sectionMeanMs.size(); ++i)
+		sections += fmt::format("{0}\"{1}\": {2:.4f}", i == 0 ? "" : ", ", kSectionNames[i], summary.sectionMeanMs[i]);
+
+	file << "{\n";
+	file << fmt::format("  \"mode\": \"{0}\",\n", mode);
+	file << fmt::format("  \"renderer\": \"{0}\",\n", escapeJson(reinterpret_cast<const char*>(glGetString(GL_RENDERER))));
+	file << fmt::format("  \"version\": \"{0}\",\n", escapeJson(reinterpret_cast<const char*>(glGetString(GL_VERSION))));
+	file << fmt::format("  \"width\": {0},\n  \"height\": {1},\n", _options.width, _options.height);
+	file << fmt::format("  \"frames\": {0},\n  \"warmupFrames\": {1},\n", _options.frames, _options.warmupFrames);
+	file << "  \"summary\": {\n";
+	file << fmt::format("    \"cpuMsP50\": {0:.4f}, \"cpuMsP95\": {1:.4f}, \"cpuMsP99\": {2:.4f}, \"cpuMsMax\": {3:.4f},\n",
+	                    summary.cpuP50, summary.cpuP95, summary.cpuP99, summary.cpuMax);
+	file << fmt::format("    \"gpuMsP50\": {0:.4f}, \"gpuMsP95\": {1:.4f}, \"gpuMsP99\": {2:.4f}, \"gpuMsMax\": {3:.4f},\n",
+	                    summary.gpuP50, summary.gpuP95, summary.gpuP99, summary.gpuMax);
+	file << fmt::format("    \"drawsMean\": {0:.1f},\n", summary.drawsMean);
+	file << fmt::format("    \"sectionMsMean\": {{ {0} }},\n", sections);
+	file << fmt::format("    \"hitchMs\": {0:.1f}, \"hitches\": {1},\n", _options.hitchMs, summary.hitches);
+	file << fmt::format("    \"loadStalls\": {0}, \"loadStallMsTotal\": {1:.4f}, \"loadStallMsMax\": {2:.4f}\n",
+	                    summary.loadStalls, summary.loadStallTotalMs, summary.loadStallMaxMs);
+	file << "  },\n";
+	file << "  \"samples\": [\n";
+
+	for (auto it = _samples.begin() + _options.warmupFrames; it != _samples.end(); ++it)
+	{
+		file << fmt::format("    {{ \"cpuMs\": {0:.4f}, \"gpuMs\": {1:.4f}, \"draws\": {2}, \"stateCalls\": {3}", it->cpuMs,
+		                    it->gpuMs, it->draws, it->stateCalls);
+		for (std::size_t i = 0; i < it->sectionMs.size(); ++i)
+			file << fmt::format(", \"{0}Ms\": {1:.4f}", kSectionNames[i], it->sectionMs[i]);
+		file << (it + 1 == _samples.end() ? " }\n" : " },\n");
+	}
+
+	file << "  ]\n}\n";
+
+	std::cout << fmt::format("Benchmark ({0}): {1} frames, cpu p50 {2:.3f} / p95 {3:.3f} / p99 {4:.3f} / max {5:.3f} ms, "
+	                         "gpu p95 {6:.3f} ms, {7} hitches, {8} load stalls ({9:.1f} ms) -> {10}\n",
+	                         mode, _options.frames, summary.cpuP50, summary.cpuP95, summary.cpuP99, summary.cpuMax,
+	                         summary.gpuP95, summary.hitches, summary.loadStalls, summary.loadStallTotalMs,
+	                         _options.outputPath);
+
+	return true;
+}
+
+bool Benchmark::CompareBaseline() const
+{
+	if (_options.baselinePath.empty())
+		return true;
+
+	if (!FileSystem::exists(_options.baselinePath))
+	{
+		fprintf(stderr, "Benchmark baseline not found: %s\n", _options.baselinePath.c_str());
+		return false;
+	}
+
+	const std::string baseline = File::ReadAll(_options.baselinePath);
+	const Summary summary = summarize();
+
+	const std::pair<const char*, double> tracked[] = {
+	    {"cpuMsP50", summary.cpuP50},
+	    {"cpuMsP95", summary.cpuP95},
+	    {"cpuMsP99", summary.cpuP99},
+	    {"gpuMsP95", summary.gpuP95},
+	};
+
+	bool passed = true;
+	for (auto const& metric : tracked)
+	{
+		double before = 0.0;
+		if (!readJsonNumber(baseline, metric.first, before) || before <= 0.0)
+			continue;
+
+		const double change = (metric.second - before) / before;
+		const bool regressed = change > _options.tolerance;
+		passed &= !regressed;
+
+		std::cout << fmt::format("  {0}: {1:.3f} -> {2:.3f} ms ({3:+.1f}%){4}\n", metric.first, before, metric.second,
+		                         change * 100.0, regressed ? "  REGRESSED" : "");
+	}
+
+	std::cout << (passed ? "Benchmark within tolerance of baseline\n" : "Benchmark regressed against baseline\n");
+	return passed;
+}
+
+} // namespace Donut
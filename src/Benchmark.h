@@ -0,0 +1,140 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include "Core/Math/Quaternion.h"
+#include "Core/Math/Vector3.h"
+#include "Render/OpenGL/glad/glad.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Donut
+{
+
+// Drives the camera along a fixed path for a set number of frames and records CPU frame time (split by
+// subsystem), GL time (timer queries, read back a few frames late so they never stall) and draw calls for each one,
+// then writes them out as JSON and optionally checks them against a saved baseline.
+class Benchmark
+{
+public:
+	enum class Mode
+	{
+		Orbit,      // slow 360 degree turn around the start position
+		Flythrough, // along a waypoint list, streaming regions as it arrives
+	};
+
+	struct Options
+	{
+		bool headless = false;
+		Mode mode = Mode::Orbit;
+		int frames = 0; // 0 runs the game normally, a flythrough works its own length out
+		int warmupFrames = 30;
+		int width = 1280;
+		int height = 720;
+		float flySpeed = 40.0f;  // units per second
+		double hitchMs = 33.3;   // frames slower than this count as hitches
+		double tolerance = 0.10; // allowed slow down over the baseline
+		std::string outputPath = "benchmark.json";
+		std::string baselinePath;
+		std::string tracePath; // per-pass GPU timings, see GpuProfiler::WriteTrace
+	};
+
+	// CPU time buckets, timed with ScopedSection
+	enum class Section
+	{
+		Streaming,
+		Physics,
+		Update,
+		Render,
+		Count,
+	};
+
+	class ScopedSection
+	{
+	public:
+		ScopedSection(Benchmark& benchmark, Section section);
+		~ScopedSection();
+
+	private:
+		Benchmark& _benchmark;
+		Section _section;
+		uint64_t _start;
+	};
+
+	struct Waypoint
+	{
+		Vector3 position;
+		std::string regions; // dyna load string, see Level::DynaLoadData
+	};
+
+	// --headless, --bench <orbit|flythrough>, --bench-frames <n> (orbit only), --bench-warmup <n>, --bench-size <w>x<h>,
+	// --bench-out <file>, --bench-hitch <ms>, --bench-baseline <file>, --bench-tolerance <percent>,
+	// --bench-trace <file>
+	static Options ParseArgs(int argc, char** argv);
+
+	explicit Benchmark(const Options& options);
+	~Benchmark();
+
+	// flythrough only, fixes the frame count from the path length
+	void SetPath(std::vector<Waypoint> waypoints, double deltaTime);
+
+	bool IsDone() const { return _frame >= _options.warmupFrames + _options.frames; }
+
+	void GetCameraPose(const Vector3& origin, Vector3& position, Quaternion& orientation) const;
+
+	// regions to load this frame, empty most of the time
+	const std::string& GetStreamRequest() const;
+
+	void BeginFrame();
+	void EndFrame();
+
+	bool WriteJson() const;
+
+	// false if any tracked percentile regressed past the tolerance
+	bool CompareBaseline() const;
+
+private:
+	struct FrameSample
+	{
+		double cpuMs;
+		double gpuMs;
+		std::size_t draws;
+		std::size_t stateCalls;
+		std::array<double, (std::size_t)Section::Count> sectionMs;
+	};
+
+	struct Summary
+	{
+		double cpuP50, cpuP95, cpuP99, cpuMax;
+		double gpuP50, gpuP95, gpuP99, gpuMax;
+		double drawsMean;
+		std::array<double, (std::size_t)Section::Count> sectionMeanMs;
+		std::size_t hitches;
+		std::size_t loadStalls;
+		double loadStallTotalMs;
+		double loadStallMaxMs;
+	};
+
+	void collectQuery(std::size_t slot);
+	Summary summarize() const;
+
+	// which leg of the path a measured frame is on, and how far along it
+	std::size_t legAt(int frame, float& t) const;
+
+	static constexpr std::size_t kQueryLatency = 4;
+
+	Options _options;
+	int _frame;
+	uint64_t _frameStart;
+	std::array<GLuint, kQueryLatency> _queries;
+	std::array<int, kQueryLatency> _queryFrames; // -1 when the slot has no result pending
+	std::vector<FrameSample> _samples;
+
+	std::vector<Waypoint> _waypoints;
+	std::vector<int> _legFirstFrame; // measured frame each leg starts on, plus one past the end
+};
+
+} // namespace Donut
@@ -2,6 +2,7 @@
 
 #include <Character.h>
 #include <CharacterController.h>
+#include <FrameState.h>
 #include <Game.h>
 #include <P3D/P3D.generated.h>
 #include <P3D/P3DFile.h>
@@ -18,7 +19,6 @@ namespace Donut
 Character::Character(std::string name): _name(std::move(name)), _position(Vector3(0.0f)), _rotation(Quaternion())
 {
 	_characterController = std::make_unique<CharacterController>(this, &Game::GetInstance().GetWorldPhysics());
-	_boneBuffer = std::make_unique<GL::TextureBuffer>();
 }
 
 Character::~Character() = default;
@@ -69,21 +69,18 @@ void Character::LoadAnimations(const std::string& name)
 	SetAnimation(_animations.begin()->first);
 }
 
-void Character::Draw(const Matrix4x4& viewProjection, GL::ShaderProgram& shaderProgram, const ResourceManager& rm)
+void Character::Draw(GL::ShaderProgram& shaderProgram, const ResourceManager& rm, uint32_t boneBase)
 {
 	// wtf just
 	const auto localPosition = _position; // -Vector3(0.0f, _characterController->GetShape().getHalfHeight() * 2, 0.0f);
 	// const Matrix4x4 mvp        = glm::translate(viewProjection, localPosition) * glm::toMat4(_rotation);
 	// const Matrix4x4 mvp        = glm::translate(viewProjection, localPosition) * glm::toMat4(_rotation);
 
-	shaderProgram.Bind(); // todo optimize: should already be bound?
-	shaderProgram.SetUniformValue("viewProj", viewProjection);
-	shaderProgram.SetUniformValue("diffuseTex", 0); // todo optimize: should already be set
-	shaderProgram.SetUniformValue("boneBuffer", 1); // todo optimize: should already be set
+	// viewProj comes from the frame uniform block, samplers are set once at load
+	shaderProgram.Bind(); // filtered by the state cache when already bound
 
-	// bind the bone buffer to tex1
-	glActiveTexture(GL_TEXTURE1);
-	_boneBuffer->Bind();
+	// the shared palette is already bound to tex1, this character's bones start at boneBase
+	shaderProgram.SetUniformValue("boneBase", static_cast<int>(boneBase));
 
 	_skinModel->Draw();
 }
@@ -107,13 +104,20 @@ void Character::Update(double deltatime)
 
 	if (_currentAnimation != nullptr)
 		_skeleton->UpdatePose(*_currentAnimation, _animTime);
+}
 
-	// update our bonebuffer
-	auto joints = _skeleton->GetJoints();
-	std::vector<Matrix4x4> matrices(joints.size());
-	for (auto i = 0; i < joints.size(); i++) matrices[i] = joints[i].finalGlobal;
+void Character::WriteFrameState(FrameState& frame) const
+{
+	auto const& joints = _skeleton->GetJoints();
 
-	_boneBuffer->SetBuffer(matrices.data(), matrices.size() * sizeof(Matrix4x4));
+	frame.characterPosition = _position;
+	frame.characterPose.resize(joints.size());
+	frame.characterBones.resize(joints.size());
+	for (std::size_t i = 0; i < joints.size(); i++)
+	{
+		frame.characterPose[i] = joints[i].pose;
+		frame.characterBones[i] = joints[i].finalGlobal;
+	}
 }
 
 void Character::SetPosition(const Vector3& position)
@@ -16,7 +16,6 @@ namespace Donut
 namespace GL
 {
 class ShaderProgram;
-class TextureBuffer;
 class GLTexture2D;
 } // namespace GL
 
@@ -30,6 +29,7 @@ class Texture;
 } // namespace P3D
 
 class CharacterController;
+struct FrameState;
 class SkinModel;
 class SkinAnimation;
 class ResourceManager;
@@ -67,8 +67,12 @@ public:
 	CharacterController& GetCharacterController() const { return *_characterController; }
 	Skeleton& GetSkeleton() const { return *_skeleton; }
 
+	// simulation thread: advances the animation, the pose reaches the renderer through WriteFrameState
 	void Update(double deltatime);
-	void Draw(const Matrix4x4& viewProjection, GL::ShaderProgram&, const ResourceManager&);
+	void WriteFrameState(FrameState&) const;
+
+	// render thread: draws with the bones the published palette put at boneBase in the shared BonePalette
+	void Draw(GL::ShaderProgram&, const ResourceManager&, uint32_t boneBase);
 
 	// maybe change this to just anim names
 	const std::unordered_map<std::string, std::unique_ptr<SkinAnimation>>& GetAnimations() const { return _animations; }
@@ -92,8 +96,6 @@ private:
 	std::unique_ptr<SkinModel> _skinModel; // use std::weak_ptr when SkinModels are created as a shared_ptr
 	std::unique_ptr<Skeleton> _skeleton;
 
-	std::unique_ptr<GL::TextureBuffer> _boneBuffer;
-
 	// animations / bone buffers
 	std::unordered_map<std::string, std::unique_ptr<SkinAnimation>> _animations;
 	SkinAnimation* _currentAnimation;
@@ -0,0 +1,56 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace Donut
+{
+// Accumulates real frame time and hands it back as whole steps of a fixed length. A long frame (a load hitch, a
+// breakpoint) is clamped to maxDelta and at most maxSteps run per frame; whatever is still owed after that is
+// dropped, so the simulation slows down for a moment instead of spiralling further behind.
+class FixedTimestep
+{
+public:
+	FixedTimestep(double step, int maxSteps, double maxDelta)
+	    : _step(step), _maxSteps(maxSteps), _maxDelta(maxDelta), _accumulator(0.0), _droppedSteps(0)
+	{
+	}
+
+	// returns how many steps to run this frame
+	int Advance(double deltaTime)
+	{
+		_accumulator += std::min(deltaTime, _maxDelta);
+
+		int steps = static_cast<int>(_accumulator / _step);
+		if (steps > _maxSteps)
+		{
+			_droppedSteps += static_cast<uint64_t>(steps - _maxSteps);
+			steps = _maxSteps;
+			_accumulator = std::fmod(_accumulator, _step);
+		}
+		else
+		{
+			_accumulator -= steps * _step;
+		}
+
+		return steps;
+	}
+
+	double GetStep() const { return _step; }
+
+	// how far between the last two steps the current time is, for interpolating them
+	float GetAlpha() const { return static_cast<float>(_accumulator / _step); }
+
+	uint64_t GetDroppedSteps() const { return _droppedSteps; }
+
+private:
+	double _step;
+	int _maxSteps;
+	double _maxDelta;
+	double _accumulator;
+	uint64_t _droppedSteps;
+};
+} // namespace Donut
@@ -0,0 +1,110 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include "JobSystem.h"
+
+#include <algorithm>
+
+namespace Donut
+{
+
+JobSystem::JobSystem(std::size_t workerCount): _quit(false)
+{
+	// with no workers at all, Wait simply runs every job on the calling thread
+	if (workerCount == 0)
+		workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+	_workers.reserve(workerCount);
+	for (std::size_t i = 0; i < workerCount; ++i) _workers.emplace_back([this] { workerLoop(); });
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_quit = true;
+	}
+
+	_wake.notify_all();
+	for (auto& worker : _workers) worker.join();
+}
+
+void JobSystem::Run(Counter& counter, std::function<void()> job)
+{
+	counter._pending.fetch_add(1, std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_queue.push_back(Job {std::move(job), &counter});
+	}
+
+	_wake.notify_one();
+}
+
+void JobSystem::ParallelFor(Counter& counter, std::size_t count, const std::function<void(std::size_t)>& job)
+{
+	if (count == 0)
+		return;
+
+	counter._pending.fetch_add(count, std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (std::size_t i = 0; i < count; ++i) _queue.push_back(Job {[job, i] { job(i); }, &counter});
+	}
+
+	_wake.notify_all();
+}
+
+void JobSystem::Wait(Counter& counter)
+{
+	while (!counter.IsDone())
+	{
+		// jobs still running on the workers, nothing left to help with
+		if (!tryRunOne())
+			std::this_thread::yield();
+	}
+}
+
+bool JobSystem::tryRunOne()
+{
+	Job job;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_queue.empty())
+			return false;
+
+		job = std::move(_queue.front());
+		_queue.pop_front();
+	}
+
+	runJob(job);
+	return true;
+}
+
+void JobSystem::runJob(Job& job)
+{
+	job.function();
+	job.counter->_pending.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::workerLoop()
+{
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wake.wait(lock, [this] { return _quit || !_queue.empty(); });
+
+			if (_quit && _queue.empty())
+				return;
+
+			job = std::move(_queue.front());
+			_queue.pop_front();
+		}
+
+		runJob(job);
+	}
+}
+
+} // namespace Donut
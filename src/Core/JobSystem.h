@@ -0,0 +1,72 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Donut
+{
+
+// Fixed pool of worker threads pulling jobs off one shared queue. Jobs are grouped by a Counter that the caller
+// waits on; the waiting thread runs queued jobs itself rather than sleeping, so a wait on the main thread never
+// costs more than doing the work serially. Jobs must not touch GL, only the main thread owns the context.
+class JobSystem
+{
+public:
+	class Counter
+	{
+	public:
+		Counter(): _pending(0) {}
+		Counter(const Counter&) = delete;
+		Counter& operator=(const Counter&) = delete;
+
+		bool IsDone() const { return _pending.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class JobSystem;
+		std::atomic<std::size_t> _pending;
+	};
+
+	// 0 picks one fewer than the hardware threads, leaving a core for the main thread
+	explicit JobSystem(std::size_t workerCount = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	void Run(Counter& counter, std::function<void()> job);
+
+	// job(i) for every i in [0, count), spread over the workers
+	void ParallelFor(Counter& counter, std::size_t count, const std::function<void(std::size_t)>& job);
+
+	// returns once every job started with the counter has finished
+	void Wait(Counter& counter);
+
+	std::size_t GetWorkerCount() const { return _workers.size(); }
+
+private:
+	struct Job
+	{
+		std::function<void()> function;
+		Counter* counter;
+	};
+
+	void workerLoop();
+	bool tryRunOne();
+	void runJob(Job& job);
+
+	std::vector<std::thread> _workers;
+	std::deque<Job> _queue;
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	bool _quit;
+};
+
+} // namespace Donut
@@ -0,0 +1,96 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include "Frustum.h"
+
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define DONUT_FRUSTUM_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace Donut
+{
+
+Frustum::Frustum(const Matrix4x4& viewProj)
+{
+	// M[col][row], so row r is (M[0][r], M[1][r], M[2][r], M[3][r])
+	const auto row = [&viewProj](int r) {
+		return Vector4(viewProj.M[0][r], viewProj.M[1][r], viewProj.M[2][r], viewProj.M[3][r]);
+	};
+
+	const Vector4 r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+
+	_planes[Left] = r3 + r0;
+	_planes[Right] = r3 - r0;
+	_planes[Bottom] = r3 + r1;
+	_planes[Top] = r3 - r1;
+	_planes[Near] = r3 + r2; // -w <= z, a little loose for 0..w depth but never culls anything visible
+	_planes[Far] = r3 - r2;
+
+	for (auto& plane : _planes)
+	{
+		const float length = std::sqrt(plane.X * plane.X + plane.Y * plane.Y + plane.Z * plane.Z);
+		if (length > 0.0f)
+			plane /= length;
+	}
+}
+
+bool Frustum::Intersects(const BoundingSphere& sphere) const
+{
+	const Vector3 c = sphere.GetCenter();
+	const float r = sphere.GetRadius();
+
+	for (const auto& plane : _planes)
+	{
+		if (plane.X * c.X + plane.Y * c.Y + plane.Z * c.Z + plane.W < -r)
+			return false;
+	}
+
+	return true;
+}
+
+void Frustum::TestSpheres(const float* x, const float* y, const float* z, const float* radius, std::size_t count,
+                          uint8_t* visible) const
+{
+	std::size_t i = 0;
+
+#ifdef DONUT_FRUSTUM_SSE
+	__m128 px[PlaneCount], py[PlaneCount], pz[PlaneCount], pw[PlaneCount];
+	for (int p = 0; p < PlaneCount; ++p)
+	{
+		px[p] = _mm_set1_ps(_planes[p].X);
+		py[p] = _mm_set1_ps(_planes[p].Y);
+		pz[p] = _mm_set1_ps(_planes[p].Z);
+		pw[p] = _mm_set1_ps(_planes[p].W);
+	}
+
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 cx = _mm_loadu_ps(x + i);
+		const __m128 cy = _mm_loadu_ps(y + i);
+		const __m128 cz = _mm_loadu_ps(z + i);
+		const __m128 negR = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+		__m128 inside = _mm_cmpeq_ps(cx, cx); // all ones unless the centre is NaN
+		for (int p = 0; p < PlaneCount; ++p)
+		{
+			__m128 d = _mm_add_ps(_mm_mul_ps(px[p], cx), pw[p]);
+			d = _mm_add_ps(d, _mm_mul_ps(py[p], cy));
+			d = _mm_add_ps(d, _mm_mul_ps(pz[p], cz));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+		}
+
+		const int mask = _mm_movemask_ps(inside);
+		visible[i + 0] = (mask >> 0) & 1;
+		visible[i + 1] = (mask >> 1) & 1;
+		visible[i + 2] = (mask >> 2) & 1;
+		visible[i + 3] = (mask >> 3) & 1;
+	}
+#endif
+
+	for (; i < count; ++i)
+		visible[i] = Intersects(BoundingSphere(Vector3(x[i], y[i], z[i]), radius[i])) ? 1 : 0;
+}
+
+} // namespace Donut
@@ -0,0 +1,47 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include "Core/Math/BoundingSphere.h"
+#include "Core/Math/Matrix4x4.h"
+#include "Core/Math/Vector4.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Donut
+{
+
+// Six clip planes pulled out of a view-projection matrix, normals pointing inwards (xyz = normal, w = distance).
+class Frustum
+{
+public:
+	enum PlaneIndex
+	{
+		Left,
+		Right,
+		Bottom,
+		Top,
+		Near,
+		Far,
+		PlaneCount,
+	};
+
+	Frustum() = default;
+	explicit Frustum(const Matrix4x4& viewProj);
+
+	bool Intersects(const BoundingSphere& sphere) const;
+
+	// Tests count spheres stored as separate x/y/z/radius arrays, four at a time where SSE is available.
+	// visible[i] is 1 if sphere i touches the frustum, 0 otherwise.
+	void TestSpheres(const float* x, const float* y, const float* z, const float* radius, std::size_t count,
+	                 uint8_t* visible) const;
+
+	const Vector4& GetPlane(PlaneIndex index) const { return _planes[index]; }
+	const Vector4* GetPlanes() const { return _planes; }
+
+private:
+	Vector4 _planes[PlaneCount];
+};
+
+} // namespace Donut
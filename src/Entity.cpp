@@ -6,28 +6,17 @@
 namespace Donut
 {
 
-StaticEntity::StaticEntity(const P3D::StaticEntity& entity)
+StaticEntity::StaticEntity(const P3D::StaticEntity& entity, StaticBatch& staticBatch)
 {
 	_name = entity.GetName();
-	_mesh = std::make_unique<Mesh>(*entity.GetGeometry());
-	_mesh->Commit();
+	staticBatch.Add(*entity.GetGeometry());
 }
 
-void StaticEntity::Draw(GL::ShaderProgram& shader, bool opaque)
-{
-	_mesh->Draw(shader, opaque);
-}
-
-InstancedStaticEntity::InstancedStaticEntity(const P3D::Geometry& geometry, const std::vector<Matrix4x4>& transforms)
+InstancedStaticEntity::InstancedStaticEntity(const P3D::Geometry& geometry, const std::vector<Matrix4x4>& transforms,
+                                             InstancedBatch& instancedBatch)
 {
 	_name = geometry.GetName();
-	_mesh = std::make_unique<MeshInstanced>(geometry, transforms);
-	_mesh->Commit();
-}
-
-void InstancedStaticEntity::Draw(GL::ShaderProgram& shader, bool opaque)
-{
-	_mesh->Draw(shader, opaque);
+	instancedBatch.Add(geometry, transforms);
 }
 
 } // namespace Donut
@@ -2,7 +2,9 @@
 
 #pragma once
 
+#include <Render/InstancedBatch.h>
 #include <Render/Mesh.h>
+#include <Render/StaticBatch.h>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -35,30 +37,22 @@ protected:
 	std::string _name;
 };
 
+// geometry goes into the region's StaticBatch, which does the drawing
 class StaticEntity: public Entity
 {
 public:
-	StaticEntity(const P3D::StaticEntity&);
-
-	void Draw(GL::ShaderProgram&, bool opaque) override;
+	StaticEntity(const P3D::StaticEntity&, StaticBatch&);
 
 	const std::string GetClassName() const override { return "StaticEntity"; }
-
-protected:
-	std::unique_ptr<Mesh> _mesh;
 };
 
+// geometry and transforms go into the region's InstancedBatch, which does the drawing
 class InstancedStaticEntity: public Entity
 {
 public:
-	InstancedStaticEntity(const P3D::Geometry&, const std::vector<Matrix4x4>&);
-
-	void Draw(GL::ShaderProgram&, bool opaque) override;
+	InstancedStaticEntity(const P3D::Geometry&, const std::vector<Matrix4x4>&, InstancedBatch&);
 
 	const std::string GetClassName() const override { return "InstancedStaticEntity"; }
-
-protected:
-	std::unique_ptr<MeshInstanced> _mesh;
 };
 
 } // namespace Donut
@@ -0,0 +1,59 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include <FrameState.h>
+
+namespace Donut
+{
+
+static Vector3 lerp(const Vector3& a, const Vector3& b, float t)
+{
+	return a + (b - a) * t;
+}
+
+static Quaternion nlerp(const Quaternion& a, const Quaternion& b, float t)
+{
+	// take the short way round
+	const float dot = a.X * b.X + a.Y * b.Y + a.Z * b.Z + a.W * b.W;
+	const Quaternion target = dot < 0.0f ? -b : b;
+	return (a * (1.0f - t) + target * t).Normal();
+}
+
+static void lerpMatrices(const std::vector<Matrix4x4>& a, const std::vector<Matrix4x4>& b, float t,
+                         std::vector<Matrix4x4>& out)
+{
+	// a joint count change (new model) has nothing to blend from
+	if (a.size() != b.size())
+	{
+		out = b;
+		return;
+	}
+
+	out.resize(b.size());
+	for (std::size_t i = 0; i < b.size(); i++)
+	{
+		for (int col = 0; col < 4; col++)
+		{
+			for (int row = 0; row < 4; row++)
+				out[i].M[col][row] = a[i].M[col][row] + (b[i].M[col][row] - a[i].M[col][row]) * t;
+		}
+	}
+}
+
+void InterpolateFrameState(const FrameState& from, const FrameState& to, float alpha, FrameState& out)
+{
+	out.time = from.time + (to.time - from.time) * alpha;
+	out.deltaTime = to.deltaTime;
+
+	out.cameraPosition = lerp(from.cameraPosition, to.cameraPosition, alpha);
+	out.cameraOrientation = nlerp(from.cameraOrientation, to.cameraOrientation, alpha);
+	out.cameraFov = to.cameraFov;
+	out.view = Matrix4x4(out.cameraOrientation) * Matrix4x4::MakeTranslate(-out.cameraPosition);
+	out.proj = to.proj;
+
+	out.characterPosition = lerp(from.characterPosition, to.characterPosition, alpha);
+	lerpMatrices(from.characterPose, to.characterPose, alpha, out.characterPose);
+	lerpMatrices(from.characterBones, to.characterBones, alpha, out.characterBones);
+	lerpMatrices(from.worldSphereJoints, to.worldSphereJoints, alpha, out.worldSphereJoints);
+}
+
+} // namespace Donut
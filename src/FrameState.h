@@ -0,0 +1,48 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include "Core/Math/Matrix4x4.h"
+#include "Core/Math/Quaternion.h"
+#include "Core/Math/Vector3.h"
+
+#include <vector>
+
+namespace Donut
+{
+
+// What the main thread hands the simulation each frame: input is pumped on the main thread (SDL wants it there)
+// and boiled down to this before the simulation step starts.
+struct FrameInput
+{
+	double deltaTime = 0.0;           // real time since the last frame
+	float lookX = 0.0f, lookY = 0.0f; // mouse delta while the mouse is locked, summed until a step uses it
+	Vector3 move = Vector3(0.0f);     // camera velocity
+	int viewportWidth = 1, viewportHeight = 1;
+};
+
+// Everything the renderer needs out of one simulation step. The simulation fills one of these while the renderer
+// draws the previous one, so nothing the simulation owns is read while it's being written.
+struct FrameState
+{
+	double time = 0.0;
+	double deltaTime = 0.0;
+
+	Matrix4x4 view;
+	Matrix4x4 proj;
+	Vector3 cameraPosition;
+	Quaternion cameraOrientation;
+	float cameraFov = 0.0f;
+
+	Vector3 characterPosition;
+	std::vector<Matrix4x4> characterPose;  // joint space, for the debug skeleton
+	std::vector<Matrix4x4> characterBones; // skinning palette
+
+	std::vector<Matrix4x4> worldSphereJoints;
+};
+
+// out = from + (to - from) * alpha, for drawing between two fixed simulation steps. Matrices are blended per element,
+// close enough for the few degrees a joint turns in one step; the camera is rebuilt from its position and orientation.
+void InterpolateFrameState(const FrameState& from, const FrameState& to, float alpha, FrameState& out);
+
+} // namespace Donut
@@ -5,7 +5,9 @@
 #include <Game.h>
 #include <P3D/P3D.generated.h>
 #include <P3D/P3DFile.h>
+#include <Render/OpenGL/DeletionQueue.h>
 #include <Render/OpenGL/GLTexture2D.h>
+#include <Render/OpenGL/StateCache.h>
 #include <Render/Texture.h>
 #include <ResourceManager.h>
 #include "Core/FileSystem.h"
@@ -34,10 +36,7 @@ FrontendProject::FrontendProject()
 
 FrontendProject::~FrontendProject()
 {
-	if (_sampler != 0)
-	{
-		glDeleteSamplers(1, &_sampler);
-	}
+	GL::DeletionQueue::Retire(GL::DeletionQueue::Type::Sampler, _sampler);
 }
 
 void FrontendProject::AddMultiSprite(const P3D::FrontendMultiSprite& multiSprite, int32_t resX, int32_t resY)
@@ -162,7 +161,7 @@ void FrontendProject::Draw(const Matrix4x4& proj)
 		                  sprite.color);
 	}
 
-	glBindSampler(0, _sampler);
+	GL::StateCache::BindSampler(0, _sampler);
 	_spriteBatch.Flush(proj, 2.0f);
 }
 } // namespace Donut
@@ -3,10 +3,14 @@
 #include "Game.h"
 
 #include "AnimCamera.h"
+#include "Benchmark.h"
 #include "Audio/AudioManager.h"
 #include "Character.h"
+#include "Core/FixedTimestep.h"
 #include "Core/FpsTimer.h"
+#include "Core/JobSystem.h"
 #include "Core/Math/Math.h"
+#include "FrameState.h"
 #include "FreeCamera.h"
 #include "FrontendProject.h"
 #include "Input/Input.h"
@@ -16,14 +20,26 @@
 #include "Physics/WorldPhysics.h"
 #include "RCL/RCFFile.h"
 #include "RCL/RSDFile.h"
+#include "Render/BonePalette.h"
+#include "Render/DynamicResolution.h"
 #include "Render/Font.h"
+#include "Render/GpuProfiler.h"
+#include "Render/InstancedBatch.h"
 #include "Render/LineRenderer.h"
+#include "Render/Mesh.h"
+#include "Render/OpenGL/DeletionQueue.h"
 #include "Render/OpenGL/FrameBuffer.h"
+#include "Render/OpenGL/HeadlessContext.h"
+#include "Render/OpenGL/ProgramCache.h"
 #include "Render/OpenGL/ShaderProgram.h"
+#include "Render/OpenGL/StateCache.h"
 #include "Render/OpenGL/glad/glad.h"
 #include "Render/Shader.h"
+#include "Render/ShaderVariants.h"
 #include "Render/SkinModel.h"
 #include "Render/SpriteBatch.h"
+#include "Render/TextureStreamer.h"
+#include "Render/UniformBlocks.h"
 #include "Render/imgui/imgui.h"
 #include "Render/imgui/imgui_impl_opengl3.h"
 #include "Render/imgui/imgui_impl_sdl.h"
@@ -45,6 +61,13 @@ namespace Donut
 
 Game* Game::instance = nullptr;
 
+// the simulation always advances in steps of this, however fast frames come
+static const double kSimulationStep = 1.0 / 60.0;
+// a frame longer than this (a load, a breakpoint) only counts as this long
+static const double kMaxFrameDelta = 0.25;
+// steps run per frame at most while catching up, anything still owed after that is dropped
+static const int kMaxSimulationSteps = 5;
+
 #if _DEBUG
 const std::string kBuildString = "DEBUG BUILD";
 #else
@@ -72,29 +95,81 @@ Game::Game(int argc, char** argv)
 	//	Commands::RunScript(path.string());
 	//}
 
-	const std::string windowTitle = fmt::format("donut [{0}]", kBuildString);
+	_benchOptions = Benchmark::ParseArgs(argc, argv);
+
+	if (_benchOptions.headless)
+	{
+		if (SDL_Init(SDL_INIT_TIMER) != 0)
+			throw std::runtime_error("Could not initialize SDL Timer Subsystem: " + std::string(SDL_GetError()));
+
+		_headlessContext = std::make_unique<GL::HeadlessContext>(_benchOptions.width, _benchOptions.height);
+	}
+	else
+	{
+		const std::string windowTitle = fmt::format("donut [{0}]", kBuildString);
 
-	const int windowWidth = 1280, windowHeight = 960;
-	_window = std::make_unique<Window>(windowTitle, windowWidth, windowHeight);
+		const int windowWidth = 1280, windowHeight = 960;
+		_window = std::make_unique<Window>(windowTitle, windowWidth, windowHeight);
+	}
 
 	glEnable(GL_DEBUG_OUTPUT);
 	glDebugMessageCallback(MessageCallback, 0);
 	glDebugMessageControl(GL_DEBUG_SOURCE_API, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, 0, GL_FALSE);
 
-	ImGui::CreateContext();
-	ImGui_ImplSDL2_InitForOpenGL(static_cast<SDL_Window*>(*_window), static_cast<SDL_GLContext*>(*_window));
-	ImGui_ImplOpenGL3_Init("#version 130");
+	if (_window != nullptr)
+	{
+		ImGui::CreateContext();
+		ImGui_ImplSDL2_InitForOpenGL(static_cast<SDL_Window*>(*_window), static_cast<SDL_GLContext*>(*_window));
+		ImGui_ImplOpenGL3_Init("#version 130");
+	}
 
 	// const float dpi_scale = 2.0f;
 	// ImGuiIO& io = ImGui::GetIO();
 	// ImGui::GetStyle().ScaleAllSizes(dpi_scale);
 	// io.FontGlobalScale = dpi_scale;
 
+	_frameUniforms = std::make_unique<FrameUniforms>();
+	_objectUniforms = std::make_unique<ObjectUniformRing>(16384);
+	_instanceRefs = Mesh::CreateInstanceRefs();
+	_bonePalette = std::make_unique<BonePalette>();
+	_textureStreamer = std::make_unique<TextureStreamer>(256 << 20, 8 << 20);
+	_gpuProfiler = std::make_unique<GpuProfiler>();
+	_jobSystem = std::make_unique<JobSystem>();
+	_simThread = std::make_unique<JobSystem>(1);
+
+	// 60 fps on the GPU before anything else, down to half resolution to get there
+	if (_window != nullptr)
+		_dynamicResolution = std::make_unique<DynamicResolution>(1000.0f / 60.0f, 0.5f, 1.0f, 4);
+
+	auto setupWorldProgram = [](GL::ShaderProgram& program) {
+		BindUniformBlocks(program);
+
+		// sampler units never change, set them once
+		program.Bind();
+		program.SetUniformValue("diffuseTex", 0);
+		program.SetUniformValue("boneBuffer", 1);
+	};
+
+	_worldShaders = std::make_unique<ShaderVariants>(File::ReadAll("shaders/world.vert"), File::ReadAll("shaders/world.frag"),
+	                                                 setupWorldProgram);
+
+	// what the world and characters use, built now rather than on their first draw
+	_worldShaders->Precompile({
+	    VertexColorFeature,
+	    VertexColorFeature | AlphaTestFeature,
+	    BillboardFeature | VertexColorFeature,
+	    BillboardFeature | VertexColorFeature | AlphaTestFeature,
+	    InstancedFeature | VertexColorFeature,
+	    InstancedFeature | VertexColorFeature | AlphaTestFeature,
+	    SkinnedFeature | LightingFeature,
+	});
+
 	_lineRenderer = std::make_unique<LineRenderer>(1000000);
 	_worldPhysics = std::make_unique<WorldPhysics>(_lineRenderer.get());
 
-	// init sub classes
-	_audioManager = std::make_unique<AudioManager>();
+	// init sub classes, a headless run has no use for sound (and often no device)
+	if (!_benchOptions.headless)
+		_audioManager = std::make_unique<AudioManager>();
 	_resourceManager = std::make_unique<ResourceManager>();
 
 	if (FileSystem::exists("./art/frontend/scrooby2/resource/fonts/font0_16.p3d"))
@@ -129,9 +204,9 @@ Game::Game(int argc, char** argv)
 	// _level->LoadP3D("l1z6.p3d");
 	// _level->LoadP3D("l1z7.p3d");
 
-	const auto skinVertSrc = File::ReadAll("shaders/skin.vert");
-	const auto skinFragSrc = File::ReadAll("shaders/skin.frag");
-	_skinShaderProgram = std::make_unique<GL::ShaderProgram>(skinVertSrc, skinFragSrc);
+	const auto& programStats = GL::ProgramCache::GetStats();
+	std::cout << fmt::format("Program cache: {0} hits, {1} misses, {2} rejected\n", programStats.hits, programStats.misses,
+	                         programStats.rejected);
 
 	loadGlobal();
 	LoadModel("homer", "homer");
@@ -147,13 +222,40 @@ Game::Game(int argc, char** argv)
 
 Game::~Game()
 {
-	ImGui_ImplOpenGL3_Shutdown();
-	ImGui_ImplSDL2_Shutdown();
-	ImGui::DestroyContext();
+	if (_window != nullptr)
+	{
+		ImGui_ImplOpenGL3_Shutdown();
+		ImGui_ImplSDL2_Shutdown();
+		ImGui::DestroyContext();
+	}
 
-	// todo: might need to reset our unique_ptrs here in a certain order...
+	// nothing may still be stepping or recording while what it touches goes away
+	_simThread.reset();
+	_jobSystem.reset();
+
+	// everything that owns GL objects, users before what they use, while the context is still there to delete them
+	_level.reset();
+	_character.reset();
+	_npcCharacter.reset();
+	_worldPhysics.reset();
+	_lineRenderer.reset();
+	_textureFontP3D.reset();
+	_resourceManager.reset();
+	_textureStreamer.reset();
+	_worldShaders.reset();
+	InstancedBatch::ReleaseShaders();
+	SpriteBatch::ReleaseShaders();
+	_bonePalette.reset();
+	_instanceRefs.reset();
+	_objectUniforms.reset();
+	_frameUniforms.reset();
+	_dynamicResolution.reset();
+	_gpuProfiler.reset();
+
+	GL::DeletionQueue::Flush();
 
 	_window.reset();
+	_headlessContext.reset();
 
 	SDL_Quit();
 }
@@ -227,14 +329,19 @@ std::vector<std::pair<std::string, std::string>> models {
 
 void Game::OnInputTextEntry(const std::string& text) {}
 
-void Game::Run()
+int Game::Run()
 {
+	if (_benchOptions.frames > 0)
+		return runBenchmark();
+
 	// measure our delta time
 	uint64_t now = SDL_GetPerformanceCounter();
 	uint64_t last = 0;
 	double deltaTime = 0.0;
+	double time = 0.0;
 
 	FpsTimer timer;
+	GL::StateCache::Stats stateStats; // last frame's, shown in the overlay
 
 	SpriteBatch sprites(1024);
 	GL::ShaderProgram& spriteShader = sprites.GetShader();
@@ -246,6 +353,25 @@ void Game::Run()
 
 	Input::CaptureTextEntry(this, &Game::OnInputTextEntry);
 
+	// the simulation steps into one state while the last one it finished is drawn, then they swap
+	std::array<FrameState, 2> frames;
+	std::size_t drawIndex = 0;
+	JobSystem::Counter simulated;
+
+	// owned by the simulation job: the last two fixed steps, drawn blended by how far past the newer one we are
+	FixedTimestep timestep(kSimulationStep, kMaxSimulationSteps, kMaxFrameDelta);
+	std::array<FrameState, 2> steps;
+	std::size_t stepIndex = 0;
+	double simulationTime = 0.0;
+
+	// input piles up here until a step consumes it, written only while the simulation is idle
+	FrameInput input;
+	SDL_GetWindowSize(static_cast<SDL_Window*>(*_window), &input.viewportWidth, &input.viewportHeight);
+	_camera->SetAspectRatio(static_cast<float>(input.viewportWidth) / static_cast<float>(input.viewportHeight));
+	publishFrame(steps[0], simulationTime, 0.0);
+	steps[1] = steps[0];
+	frames[drawIndex] = steps[0];
+
 	SDL_Event event;
 	bool running = true;
 	while (running)
@@ -255,6 +381,7 @@ void Game::Run()
 
 		deltaTime = ((now - last) / (double)SDL_GetPerformanceFrequency());
 		timer.Update(deltaTime);
+		time += deltaTime;
 
 		Input::PreEvent();
 
@@ -270,12 +397,14 @@ void Game::Run()
 
 		LockMouse(Input::IsDown(Button::MouseRight));
 
+		input.deltaTime = deltaTime;
+		input.move = Vector3(0.0f);
+		SDL_GetWindowSize(static_cast<SDL_Window*>(*_window), &input.viewportWidth, &input.viewportHeight);
+
 		if (_mouseLocked)
 		{
-			const float mouseDeltaX = Input::GetMouseDeltaX();
-			const float mouseDeltaY = Input::GetMouseDeltaY();
-
-			_camera->LookDelta(mouseDeltaX * 0.25f, mouseDeltaY * 0.25f);
+			input.lookX += Input::GetMouseDeltaX() * 0.25f;
+			input.lookY += Input::GetMouseDeltaY() * 0.25f;
 		}
 
 		auto inputForce = Vector3(0.0f);
@@ -295,16 +424,30 @@ void Game::Run()
 		{
 			inputForce.Normalize();
 			inputForce *= Input::IsDown(Button::KeyLSHIFT) ? 60.0f : 10.0f;
-			_camera->Move(inputForce, static_cast<float>(deltaTime));
+			input.move = inputForce;
 		}
 
-		auto cameraTransform = animCamera->Update(deltaTime * 35.0);
-		//_camera->SetPosition(cameraTransform.Translation());
+		const FrameState& frame = frames[drawIndex];
+		FrameState& nextFrame = frames[drawIndex ^ 1];
+
+		_simThread->Run(simulated, [&] {
+			const double step = timestep.GetStep();
+			for (int i = timestep.Advance(input.deltaTime); i > 0; --i)
+			{
+				auto cameraTransform = animCamera->Update(step * 35.0);
+				//_camera->SetPosition(cameraTransform.Translation());
+
+				simulate(input, step);
+				input.lookX = input.lookY = 0.0f;
 
-		_worldPhysics->Update(static_cast<float>(deltaTime));
+				simulationTime += step;
+				stepIndex ^= 1;
+				publishFrame(steps[stepIndex], simulationTime, step);
+			}
 
-		_lineRenderer->DrawSkeleton(_character->GetPosition(), _character->GetSkeleton());
-		_level->Update(deltaTime);
+			InterpolateFrameState(steps[stepIndex ^ 1], steps[stepIndex], timestep.GetAlpha(), nextFrame);
+			nextFrame.deltaTime = input.deltaTime;
+		});
 
 		ImGui_ImplOpenGL3_NewFrame();
 		ImGui_ImplSDL2_NewFrame(static_cast<SDL_Window*>(*_window));
@@ -326,6 +469,9 @@ void Game::Run()
 		if (_debugAudioWindowOpen)
 			_audioManager->DebugGUI(&_debugAudioWindowOpen);
 
+		if (_debugGpuProfilerWindowOpen)
+			_gpuProfiler->ImGuiDebugWindow(&_debugGpuProfilerWindowOpen);
+
 		debugAboutMenu();
 
 		ImGuiIO& io = ImGui::GetIO();
@@ -335,20 +481,25 @@ void Game::Run()
 		                 ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize |
 		                     ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav))
 		{
-			auto const& camPos = _camera->GetPosition();
-			auto const& camRot = _camera->GetOrientation();
-			ImGui::Text("Camera Position: %s", camPos.ToString().c_str());
-			ImGui::Text("Camera Orientation: %s", camRot.ToString().c_str());
-
-			float fov = _camera->GetFOV();
+			ImGui::Text("Camera Position: %s", frame.cameraPosition.ToString().c_str());
+			ImGui::Text("Camera Orientation: %s", frame.cameraOrientation.ToString().c_str());
+			ImGui::Text("GL state calls: %zu issued, %zu filtered", stateStats.issued, stateStats.filtered);
+			ImGui::Text("Draw calls: %zu", stateStats.draws);
+			ImGui::Text("GL objects retired: %zu pending, %zu deleted", GL::DeletionQueue::GetPendingCount(),
+			            GL::DeletionQueue::GetDeletedLastFrame());
+			ImGui::Text("Render scale: %.0f%% (%dx%d)", _dynamicResolution->GetScale() * 100.0f,
+			            _dynamicResolution->GetRenderWidth(), _dynamicResolution->GetRenderHeight());
+			ImGui::Text("Textures: %zu MB of %zu MB, %zu MB decoded, %zu of %zu streaming in, %zu KB uploaded",
+			            _textureStreamer->GetResidentBytes() >> 20, _textureStreamer->GetBudget() >> 20,
+			            _textureStreamer->GetCpuBytes() >> 20, _textureStreamer->GetStreamingCount(),
+			            _textureStreamer->GetTextureCount(), _textureStreamer->GetUploadedLastFrame() >> 10);
+
+			float fov = frame.cameraFov;
 			if (ImGui::SliderFloat("FOV", &fov, 0.0f, 120.0f))
-				_camera->SetFOV(fov);
+				_simCommands.push_back([this, fov] { _camera->SetFOV(fov); });
 		}
 		ImGui::End();
 
-		if (_character != nullptr)
-			_character->Update(deltaTime);
-
 		ImGui::Render();
 
 		int viewportWidth = 0;
@@ -357,29 +508,17 @@ void Game::Run()
 		viewportWidth = (int)io.DisplaySize.x;
 		viewportHeight = (int)io.DisplaySize.y;
 
-		glViewport(0, 0, viewportWidth, viewportHeight);
-
-		glEnable(GL_DEPTH_TEST);
-		glEnable(GL_BLEND);
-
-		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		_camera->SetAspectRatio(static_cast<float>(viewportWidth) / static_cast<float>(viewportHeight));
-
-		Matrix4x4 viewMatrix = _camera->GetViewMatrix();
-		Matrix4x4 projMatrix = _camera->GetProjectionMatrix();
-		Matrix4x4 viewProjection = projMatrix * viewMatrix;
+		_gpuProfiler->BeginFrame();
 
-		if (_level != nullptr)
-			_level->Draw(viewProjection);
+		// the scene at whatever resolution fits the GPU budget, everything after the upscale at native resolution
+		_dynamicResolution->Update(*_gpuProfiler, viewportWidth, viewportHeight);
+		_dynamicResolution->BeginScene();
+		drawScene(_dynamicResolution->GetRenderWidth(), _dynamicResolution->GetRenderHeight(), frame);
 
-		if (_character != nullptr)
-			_character->Draw(viewProjection, *_skinShaderProgram, *_resourceManager);
-
-		glDisable(GL_DEPTH_TEST);
-		_lineRenderer->Flush(viewProjection);
-		glEnable(GL_DEPTH_TEST);
+		{
+			GpuProfiler::ScopedPass pass(*_gpuProfiler, "Upscale");
+			_dynamicResolution->Upscale();
+		}
 
 		Matrix4x4 proj = Matrix4x4::MakeOrtho(0.0f, viewportWidth, viewportHeight, 0.0f);
 
@@ -391,12 +530,199 @@ void Game::Run()
 			sprites.DrawText(font, fps, Vector2(32, 32), Vector4(1.0f, 1.0f, 0.0f, 1.0f));
 		}
 
-		sprites.Flush(proj);
-		// frontend->Draw(proj);
+		{
+			GpuProfiler::ScopedPass pass(*_gpuProfiler, "Sprites");
+			sprites.Flush(proj);
+			// frontend->Draw(proj);
+		}
+
+		stateStats = GL::StateCache::GetStats();
+		GL::StateCache::ResetStats();
 
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		{
+			GpuProfiler::ScopedPass pass(*_gpuProfiler, "ImGui");
+			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+			GL::StateCache::Invalidate(); // imgui restores what it touched, but behind our back
+		}
+
+		_gpuProfiler->EndFrame();
 		_window->Swap();
+
+		// whatever was released since, by this thread or any other, is deleted a few frames on
+		GL::DeletionQueue::Collect();
+
+		// the simulation is idle from here until the next Run, the only time anything else may touch its state
+		_simThread->Wait(simulated);
+		for (auto& command : _simCommands) command();
+		_simCommands.clear();
+
+		// Bullet can't be debug drawn while it steps; the lines go out with the next frame, which shows this state
+		_worldPhysics->DebugDraw();
+
+		drawIndex ^= 1;
 	}
+
+	return EXIT_SUCCESS;
+}
+
+void Game::simulate(const FrameInput& input, double deltaTime)
+{
+	if (input.lookX != 0.0f || input.lookY != 0.0f)
+		_camera->LookDelta(input.lookX, input.lookY);
+
+	if (input.move.LengthSquared() > 0.0f)
+		_camera->Move(input.move, static_cast<float>(deltaTime));
+
+	_camera->SetAspectRatio(static_cast<float>(input.viewportWidth) / static_cast<float>(input.viewportHeight));
+
+	_worldPhysics->Update(static_cast<float>(deltaTime));
+
+	_level->Update(deltaTime);
+
+	if (_character != nullptr)
+		_character->Update(deltaTime);
+}
+
+void Game::publishFrame(FrameState& frame, double time, double deltaTime) const
+{
+	frame.time = time;
+	frame.deltaTime = deltaTime;
+
+	frame.view = _camera->GetViewMatrix();
+	frame.proj = _camera->GetProjectionMatrix();
+	frame.cameraPosition = _camera->GetPosition();
+	frame.cameraOrientation = _camera->GetOrientation();
+	frame.cameraFov = _camera->GetFOV();
+
+	_level->WriteFrameState(frame);
+
+	if (_character != nullptr)
+		_character->WriteFrameState(frame);
+}
+
+void Game::drawScene(int viewportWidth, int viewportHeight, const FrameState& frame)
+{
+	glViewport(0, 0, viewportWidth, viewportHeight);
+
+	GL::StateCache::SetDepthTest(true);
+	GL::StateCache::SetBlend(true);
+
+	glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	Matrix4x4 viewProjection = frame.proj * frame.view;
+
+	_frameUniforms->Update(frame.view, frame.proj, frame.time, frame.deltaTime);
+	_objectUniforms->BeginFrame();
+	_textureStreamer->BeginFrame(frame.cameraPosition, frame.proj, viewportHeight);
+
+	if (_level != nullptr)
+		_level->Draw(frame);
+
+	if (_character != nullptr)
+	{
+		GpuProfiler::ScopedPass pass(*_gpuProfiler, "Skinned characters");
+
+		// every character's published bones in one upload, each draw then only passes its base
+		_bonePalette->Begin(frame.characterBones.size());
+		const uint32_t boneBase = _bonePalette->Write(frame.characterBones.data(), frame.characterBones.size());
+		_bonePalette->End();
+		_bonePalette->Bind(1);
+
+		_character->Draw(_worldShaders->Get(SkinnedFeature | LightingFeature), *_resourceManager, boneBase);
+	}
+
+	{
+		GpuProfiler::ScopedPass pass(*_gpuProfiler, "Lines");
+		if (_character != nullptr)
+			_lineRenderer->DrawSkeleton(frame.characterPosition, _character->GetSkeleton(), frame.characterPose);
+
+		GL::StateCache::SetDepthTest(false);
+		_lineRenderer->Flush(viewProjection);
+		GL::StateCache::SetDepthTest(true);
+	}
+
+	// what this frame's culling asked for, in time for the next one
+	GpuProfiler::ScopedPass pass(*_gpuProfiler, "Texture streaming");
+	_textureStreamer->Update();
+}
+
+int Game::runBenchmark()
+{
+	Benchmark benchmark(_benchOptions);
+
+	// offscreen so headless and windowed runs render exactly the same thing
+	GL::FrameBuffer target(_benchOptions.width, _benchOptions.height);
+
+	const Vector3 origin = _camera->GetPosition();
+	const double deltaTime = 1.0 / 60.0; // fixed, so every run animates identically
+	double time = 0.0;
+
+	// simulation and rendering take turns here, so the timings stay separable
+	FrameState frame;
+
+	if (_benchOptions.mode == Benchmark::Mode::Flythrough)
+	{
+		std::vector<Benchmark::Waypoint> path;
+		for (auto const& location : locations) path.push_back({std::get<1>(location), std::get<2>(location)});
+
+		benchmark.SetPath(std::move(path), deltaTime);
+	}
+
+	using Section = Benchmark::Section;
+
+	while (!benchmark.IsDone())
+	{
+		benchmark.BeginFrame();
+
+		{
+			Benchmark::ScopedSection section(benchmark, Section::Streaming);
+			const std::string& regions = benchmark.GetStreamRequest();
+			if (!regions.empty())
+				_level->DynaLoadData(regions);
+		}
+
+		Vector3 position;
+		Quaternion orientation;
+		benchmark.GetCameraPose(origin, position, orientation);
+		_camera->SetPosition(position);
+		_camera->SetQuaternion(orientation);
+
+		{
+			Benchmark::ScopedSection section(benchmark, Section::Physics);
+			_worldPhysics->Update(static_cast<float>(deltaTime));
+			_worldPhysics->DebugDraw();
+		}
+
+		{
+			Benchmark::ScopedSection section(benchmark, Section::Update);
+			_camera->SetAspectRatio(static_cast<float>(_benchOptions.width) / static_cast<float>(_benchOptions.height));
+			_level->Update(deltaTime);
+			_character->Update(deltaTime);
+			publishFrame(frame, time, deltaTime);
+		}
+
+		{
+			Benchmark::ScopedSection section(benchmark, Section::Render);
+			_gpuProfiler->BeginFrame();
+			target.Bind();
+			drawScene(_benchOptions.width, _benchOptions.height, frame);
+			_gpuProfiler->EndFrame();
+			GL::DeletionQueue::Collect();
+		}
+
+		benchmark.EndFrame();
+		time += deltaTime;
+	}
+
+	GL::FrameBuffer::Unbind();
+
+	if (!_benchOptions.tracePath.empty())
+		_gpuProfiler->WriteTrace(_benchOptions.tracePath);
+
+	const bool written = benchmark.WriteJson();
+	const bool passed = benchmark.CompareBaseline();
+	return written && passed ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 void Game::guiModelMenu(Character& character)
@@ -456,9 +782,9 @@ void Game::imguiMenuBar()
 		{
 			if (ImGui::MenuItem(std::get<0>(location).c_str()))
 			{
-				const Vector3& dest = std::get<1>(location);
+				const Vector3 dest = std::get<1>(location);
 				//_worldPhysics->GetCharacterController()->SetPosition(dest);
-				_camera->SetPosition(dest);
+				_simCommands.push_back([this, dest] { _camera->SetPosition(dest); });
 			}
 			if (ImGui::IsItemHovered())
 			{
@@ -494,7 +820,28 @@ void Game::imguiMenuBar()
 		ImGui::CheckboxFlags("Draw Frames", reinterpret_cast<unsigned int*>(&mode),
 		                     static_cast<unsigned int>(PhysicsDebugDrawMode::DrawFrames));
 
-		_worldPhysics->SetDebugDrawMode(mode);
+		if (mode != _worldPhysics->GetDebugDrawMode())
+			_simCommands.push_back([this, mode] { _worldPhysics->SetDebugDrawMode(mode); });
+
+		ImGui::EndMenu();
+	}
+
+	if (ImGui::BeginMenu("Resolution"))
+	{
+		bool enabled = _dynamicResolution->IsEnabled();
+		if (ImGui::Checkbox("Dynamic", &enabled))
+			_dynamicResolution->SetEnabled(enabled);
+
+		float targetMs = _dynamicResolution->GetTargetMs();
+		if (ImGui::SliderFloat("GPU budget (ms)", &targetMs, 4.0f, 50.0f))
+			_dynamicResolution->SetTargetMs(targetMs);
+
+		float minScale = _dynamicResolution->GetMinScale();
+		float maxScale = _dynamicResolution->GetMaxScale();
+		const bool minChanged = ImGui::SliderFloat("Min scale", &minScale, 0.25f, 1.0f);
+		const bool maxChanged = ImGui::SliderFloat("Max scale", &maxScale, 0.25f, 2.0f);
+		if (minChanged || maxChanged)
+			_dynamicResolution->SetScaleBounds(minScale, maxScale);
 
 		ImGui::EndMenu();
 	}
@@ -508,6 +855,9 @@ void Game::imguiMenuBar()
 	if (ImGui::MenuItem("Level Entities"))
 		_debugLevelWindowOpen = true;
 
+	if (ImGui::MenuItem("GPU Profiler"))
+		_debugGpuProfilerWindowOpen = true;
+
 	if (ImGui::MenuItem("About"))
 		_debugAboutWindowOpen = true;
 
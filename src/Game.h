@@ -2,6 +2,9 @@
 
 #pragma once
 
+#include "Benchmark.h"
+
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -17,6 +20,16 @@ class Level;
 class WorldPhysics;
 class FreeCamera;
 class Character;
+class FrameUniforms;
+class ObjectUniformRing;
+class BonePalette;
+class GpuProfiler;
+class DynamicResolution;
+class ShaderVariants;
+class JobSystem;
+class TextureStreamer;
+struct FrameInput;
+struct FrameState;
 
 namespace P3D
 {
@@ -26,8 +39,10 @@ class TextureFont;
 
 namespace GL
 {
+class HeadlessContext;
 class ShaderProgram;
-}
+class VertexBuffer;
+} // namespace GL
 
 class Game
 {
@@ -37,13 +52,20 @@ public:
 
 	Window& GetWindow() const { return *_window; }
 
-	void Run();
+	int Run(); // exit code
 	void LoadModel(const std::string&, const std::string&);
 
 	AudioManager& GetAudioManager() { return *_audioManager; }
 	ResourceManager& GetResourceManager() { return *_resourceManager; }
 	WorldPhysics& GetWorldPhysics() { return *_worldPhysics; }
 	LineRenderer& GetLineRenderer() { return *_lineRenderer; }
+	FrameUniforms& GetFrameUniforms() { return *_frameUniforms; }
+	ObjectUniformRing& GetObjectUniforms() { return *_objectUniforms; }
+	GL::VertexBuffer& GetInstanceRefs() { return *_instanceRefs; }
+	GpuProfiler& GetGpuProfiler() { return *_gpuProfiler; }
+	ShaderVariants& GetWorldShaders() { return *_worldShaders; }
+	JobSystem& GetJobSystem() { return *_jobSystem; }
+	TextureStreamer& GetTextureStreamer() { return *_textureStreamer; }
 
 	void LockMouse(bool lockMouse);
 
@@ -58,12 +80,33 @@ private:
 
 	void debugAboutMenu();
 
+	// simulation thread, owns the camera, physics, level and character state while it runs
+	void simulate(const FrameInput& input, double deltaTime);
+	void publishFrame(FrameState& frame, double time, double deltaTime) const;
+
+	// render thread, reads only what publishFrame copied out
+	void drawScene(int viewportWidth, int viewportHeight, const FrameState& frame);
+	int runBenchmark();
+
 	std::unique_ptr<Window> _window;
+	std::unique_ptr<GL::HeadlessContext> _headlessContext;
 	std::unique_ptr<AudioManager> _audioManager;
+	std::unique_ptr<TextureStreamer> _textureStreamer; // before the resource manager, its textures unregister on the way out
 	std::unique_ptr<ResourceManager> _resourceManager;
 	std::unique_ptr<FreeCamera> _camera;
 	std::unique_ptr<Character> _character;
 	std::unique_ptr<LineRenderer> _lineRenderer;
+	std::unique_ptr<FrameUniforms> _frameUniforms;
+	std::unique_ptr<ObjectUniformRing> _objectUniforms;
+	std::unique_ptr<GL::VertexBuffer> _instanceRefs; // the per-instance attribute every instanced mesh binding reads
+	std::unique_ptr<BonePalette> _bonePalette; // every skinned character's bones, one upload per frame
+	std::unique_ptr<GpuProfiler> _gpuProfiler;
+	std::unique_ptr<DynamicResolution> _dynamicResolution; // windowed only, the benchmark renders at a fixed size
+	std::unique_ptr<JobSystem> _jobSystem;
+	std::unique_ptr<JobSystem> _simThread; // one worker, a simulation step at a time
+
+	// changes to simulation state asked for by the UI, applied between steps
+	std::vector<std::function<void()>> _simCommands;
 	std::unique_ptr<Level> _level;
 	std::unique_ptr<WorldPhysics> _worldPhysics;
 	std::unique_ptr<P3D::P3DFile> _animP3D;
@@ -72,7 +115,9 @@ private:
 
 	std::unique_ptr<Character> _npcCharacter;
 
-	std::unique_ptr<GL::ShaderProgram> _skinShaderProgram;
+	std::unique_ptr<ShaderVariants> _worldShaders; // world.vert/frag, skinned characters included
+
+	Benchmark::Options _benchOptions;
 
 	bool _mouseLocked;
 	int _lockedMousePosX;
@@ -81,8 +126,9 @@ private:
 	bool _debugResourceManagerWindowOpen = false;
 	bool _debugLevelWindowOpen = false;
 	bool _debugAudioWindowOpen = false;
+	bool _debugGpuProfilerWindowOpen = false;
 	bool _debugAboutWindowOpen = false;
-	
+
 	static Game* instance;
 };
 
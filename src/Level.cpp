@@ -2,7 +2,10 @@
 
 #include "Render/imgui/imgui.h"
 #include <Core/File.h>
+#include <Core/JobSystem.h>
+#include <Core/Math/Frustum.h>
 #include <Entity.h>
+#include <FrameState.h>
 #include <Game.h>
 #include <Level.h>
 #include <P3D/P3D.generated.h>
@@ -10,13 +13,24 @@
 #include <Physics/WorldPhysics.h>
 #include <Render/BillboardBatch.h>
 #include <Render/Font.h>
+#include <Render/GpuProfiler.h>
+#include <Render/InstancedBatch.h>
 #include <Render/LineRenderer.h>
 #include <Render/Mesh.h>
+#include <Render/MeshOptimizer.h>
 #include <Render/OpenGL/ShaderProgram.h>
+#include <Render/OpenGL/StateCache.h>
 #include <Render/Shader.h>
+#include <Render/Texture.h>
+#include <Render/StaticBatch.h>
+#include <Render/TextureStreamer.h>
+#include <Render/UniformBlocks.h>
 #include <Render/WorldSphere.h>
 #include <ResourceManager.h>
+#include <algorithm>
 #include <array>
+#include <exception>
+#include <fmt/format.h>
 #include <iostream>
 
 namespace Donut
@@ -24,15 +38,6 @@ namespace Donut
 
 Level::Level()
 {
-	const auto worldVertSrc = File::ReadAll("shaders/world.vert");
-	const auto worldFragSrc = File::ReadAll("shaders/world.frag");
-	const auto worldInstancedVertSrc = File::ReadAll("shaders/world_instanced.vert");
-	const auto billboardBatchVertSrc = File::ReadAll("shaders/billboard_batch.vert");
-
-	_worldShader = std::make_unique<GL::ShaderProgram>(worldVertSrc, worldFragSrc);
-	_worldInstancedShader = std::make_unique<GL::ShaderProgram>(worldInstancedVertSrc, worldFragSrc);
-	_billboardBatchShader = std::make_unique<GL::ShaderProgram>(billboardBatchVertSrc, worldFragSrc);
-
 	// todo: move this into Game.cpp or something else ?
 	/*std::array<std::string, 7> carFiles {
 	    "art/cars/mrplo_v.p3d",
@@ -50,7 +55,7 @@ Level::Level()
 	    if (auto car = CompositeModel::LoadP3D(carFile))
 	    {
 	        auto transform = glm::translate(Matrix(1.0f), Vector3(240 + offset, 4.6f, -160));
-	        car->SetTransform(transform);
+	        car->AddInstance(transform);
 	        _compositeModels.push_back(std::move(car));
 	        offset += 3.0f;
 	    }
@@ -70,6 +75,7 @@ void Level::LoadP3D(const std::string& filename)
 	}
 
 	std::cout << "Loading level: " << filename << "\n";
+	_loadedFiles.insert(filename);
 
 	std::vector<std::unique_ptr<P3D::Locator2>> locators;
 
@@ -78,16 +84,61 @@ void Level::LoadP3D(const std::string& filename)
 	auto& rm = Game::GetInstance().GetResourceManager();
 	const auto& root = p3d.GetRoot();
 
+	auto staticBatch = std::make_unique<StaticBatch>();
+	auto instancedBatch = std::make_unique<InstancedBatch>();
+
+	// textures are decoded and get their mips built on the workers, only the uploads are left for this thread and
+	// each happens where its chunk comes up, so the file's load order is kept
+	struct PreparedTexture
+	{
+		std::shared_ptr<const P3D::Texture> source; // kept encoded, finer levels are decoded from it again
+		std::vector<MipChain::Level> levels;
+		std::exception_ptr error;
+	};
+
+	std::vector<const P3D::P3DChunk*> textureChunks;
+	for (const auto& chunk : root.GetChildren())
+	{
+		if (chunk->IsType(P3D::ChunkType::Texture))
+			textureChunks.push_back(chunk.get());
+	}
+
+	std::vector<PreparedTexture> preparedTextures(textureChunks.size());
+	JobSystem::Counter texturesPrepared;
+	Game::GetInstance().GetJobSystem().ParallelFor(texturesPrepared, textureChunks.size(), [&](std::size_t i) {
+		try
+		{
+			preparedTextures[i].source = P3D::Texture::Load(*textureChunks[i]);
+			preparedTextures[i].levels = Texture::Prepare(*preparedTextures[i].source);
+		}
+		catch (...)
+		{
+			// thrown again from this thread when the texture is reached, same as loading it here would have
+			preparedTextures[i].error = std::current_exception();
+		}
+	});
+
+	std::size_t nextTexture = 0;
 	for (const auto& chunk : root.GetChildren())
 	{
 		switch (chunk->GetType())
 		{
 		case P3D::ChunkType::Shader: rm.LoadShader(*P3D::Shader::Load(*chunk)); break;
-		case P3D::ChunkType::Texture: rm.LoadTexture(*P3D::Texture::Load(*chunk)); break;
+		case P3D::ChunkType::Texture:
+		{
+			Game::GetInstance().GetJobSystem().Wait(texturesPrepared);
+
+			PreparedTexture& prepared = preparedTextures[nextTexture++];
+			if (prepared.error != nullptr)
+				std::rethrow_exception(prepared.error);
+
+			rm.LoadTexture(std::move(prepared.source), std::move(prepared.levels));
+			break;
+		}
 		case P3D::ChunkType::Set: rm.LoadSet(*P3D::Set::Load(*chunk)); break;
 		case P3D::ChunkType::Geometry: rm.LoadGeometry(*P3D::Geometry::Load(*chunk)); break;
 		case P3D::ChunkType::StaticEntity:
-			_entities.emplace_back(std::make_unique<StaticEntity>(*P3D::StaticEntity::Load(*chunk)));
+			_entities.emplace_back(std::make_unique<StaticEntity>(*P3D::StaticEntity::Load(*chunk), *staticBatch));
 			break;
 		case P3D::ChunkType::StaticPhysics:
 		{
@@ -125,7 +176,8 @@ void Level::LoadP3D(const std::string& filename)
 			for (const auto& meshTransformsPair : meshTransforms)
 			{
 				const auto& geometry = geometries.at(meshesNameIndex.at(meshTransformsPair.first));
-				_instances.emplace_back(std::make_unique<InstancedStaticEntity>(*geometry, meshTransformsPair.second));
+				_instances.emplace_back(
+				    std::make_unique<InstancedStaticEntity>(*geometry, meshTransformsPair.second, *instancedBatch));
 			}
 
 			break;
@@ -156,7 +208,8 @@ void Level::LoadP3D(const std::string& filename)
 			for (const auto& meshTransformsPair : meshTransforms)
 			{
 				const auto& mesh = geometries.at(meshesNameIndex.at(meshTransformsPair.first));
-				_instances.emplace_back(std::make_unique<InstancedStaticEntity>(*mesh, meshTransformsPair.second));
+				_instances.emplace_back(
+				    std::make_unique<InstancedStaticEntity>(*mesh, meshTransformsPair.second, *instancedBatch));
 			}
 
 			break;
@@ -169,17 +222,20 @@ void Level::LoadP3D(const std::string& filename)
 			P3D::P3DUtil::GetDrawables(dynaPhys->GetInstanceList(), drawables, transforms);
 
 			const auto& animObjectWrapper = dynaPhys->GetAnimObjectWrapper();
+			if (drawables.empty())
+				break;
 
-			for (size_t i = 0; i < drawables.size(); ++i)
+			// every placement of the same object shares one model, and its meshes, to be drawn instanced
+			auto found = _compositeModelsByName.find(animObjectWrapper->GetName());
+			if (found == _compositeModelsByName.end())
 			{
-				const auto& drawable = drawables.at(i);
-				const auto& transform = transforms.at(i);
-
-				auto compositeModel = std::make_unique<CompositeModel>(CompositeModel_AnimObjectWrapper(*animObjectWrapper));
-				compositeModel->SetTransform(transform);
-				_compositeModels.push_back(std::move(compositeModel));
+				_compositeModels.push_back(
+				    std::make_unique<CompositeModel>(CompositeModel_AnimObjectWrapper(*animObjectWrapper)));
+				found = _compositeModelsByName.emplace(animObjectWrapper->GetName(), _compositeModels.back().get()).first;
 			}
 
+			for (const auto& transform : transforms) found->second->AddInstance(transform);
+
 			break;
 		}
 		case P3D::ChunkType::Intersect:
@@ -213,37 +269,46 @@ void Level::LoadP3D(const std::string& filename)
 		default: break;
 		}
 	}
+
+	staticBatch->Commit();
+	if (!staticBatch->IsEmpty())
+		_staticBatches.push_back(std::move(staticBatch));
+
+	instancedBatch->Commit();
+	if (!instancedBatch->IsEmpty())
+		_instancedBatches.push_back(std::move(instancedBatch));
+
+	const auto& meshStats = MeshOptimizer::GetStats();
+	std::cout << fmt::format("Mesh optimizer: {} meshes, {} -> {} prim groups, ACMR {:.3f} -> {:.3f}\n", meshStats.meshes,
+	                         meshStats.groupsIn, meshStats.groupsOut, meshStats.GetACMRIn(), meshStats.GetACMROut());
 }
 
 void Level::DynaLoadData(const std::string& dynaLoadData)
 {
-	/*	std::vector<std::string> regionsLoad, regionsUnload, interiorsLoad, interiorsUnload;
+	std::vector<std::string> regionsLoad, regionsUnload;
 
 	// todo: this will probably fuck up on an invalid string
 	std::size_t prev = 0, pos;
 	while ((pos = dynaLoadData.find_first_of(";:@$", prev)) != std::string::npos)
 	{
-	    const std::string file = dynaLoadData.substr(prev, pos - prev);
-	    switch (dynaLoadData.at(pos))
-	    {
-	    case ';': regionsLoad.push_back(file); break;
-	    case ':': regionsUnload.push_back(file); break;
-	    case '@': interiorsLoad.push_back(file); break;
-	    case '$': interiorsUnload.push_back(file); break;
-	    }
+		const std::string file = dynaLoadData.substr(prev, pos - prev);
+		switch (dynaLoadData.at(pos))
+		{
+		case ';': regionsLoad.push_back(file); break;
+		case ':': regionsUnload.push_back(file); break;
+		default: break; // todo: interiors (@ load, $ unload)
+		}
 
-	    prev = pos + 1;
+		prev = pos + 1;
 	}
 
 	// todo: be a right laugh to thread all this!!! stick it all in a queue etc.
 
 	// unload first
-	for (auto const& region : regionsUnload)
-	    unloadRegion(region);
+	for (auto const& region : regionsUnload) unloadRegion(region);
 
 	// load in more shit
-	for (auto const& region : regionsLoad)
-	    loadRegion(region);*/
+	for (auto const& region : regionsLoad) loadRegion(region);
 }
 
 void Level::ImGuiDebugWindow(bool* p_open) const
@@ -255,6 +320,39 @@ void Level::ImGuiDebugWindow(bool* p_open) const
 		return;
 	}
 
+	std::size_t batchCount = 0, rangeCount = 0;
+	for (const auto& staticBatch : _staticBatches)
+	{
+		batchCount += staticBatch->GetBatchCount();
+		rangeCount += staticBatch->GetSubRangeCount();
+	}
+
+	ImGui::Text("Static batches: %zu (%zu ranges)", batchCount, rangeCount);
+
+	const auto& meshStats = MeshOptimizer::GetStats();
+	ImGui::Text("ACMR: %.3f -> %.3f (%zu triangles)", meshStats.GetACMRIn(), meshStats.GetACMROut(), meshStats.triangles);
+
+	std::size_t materialCount = 0, commandCount = 0, instanceCount = 0, visibleCount = 0;
+	for (const auto& instancedBatch : _instancedBatches)
+	{
+		materialCount += instancedBatch->GetMaterialCount();
+		commandCount += instancedBatch->GetCommandCount();
+		instanceCount += instancedBatch->GetInstanceCount();
+		visibleCount += instancedBatch->GetVisibleCount();
+	}
+
+	ImGui::Text("Indirect batches: %zu (%zu commands)", materialCount, commandCount);
+
+	bool gpuCulling = InstancedBatch::IsGpuCulling();
+	if (ImGui::Checkbox("GPU instance culling", &gpuCulling))
+		InstancedBatch::SetGpuCulling(gpuCulling);
+
+	if (gpuCulling)
+		ImGui::Text("Instances: %zu", instanceCount);
+	else
+		ImGui::Text("Instances: %zu visible of %zu", visibleCount, instanceCount);
+	ImGui::Separator();
+
 	for (const auto& ent : _entities)
 	{
 		ImGui::TextDisabled("%s", ent->GetClassName().c_str());
@@ -267,11 +365,16 @@ void Level::ImGuiDebugWindow(bool* p_open) const
 
 void Level::loadRegion(const std::string& filename)
 {
+	if (_loadedFiles.count(filename) != 0)
+		return;
+
 	std::cout << "load region: " << filename << std::endl;
+	LoadP3D(filename);
 }
 
 void Level::unloadRegion(const std::string& filename)
 {
+	// todo: batches and entities aren't tracked per file yet, so a region stays resident once loaded
 	std::cout << "unload region: " << filename << std::endl;
 }
 
@@ -281,56 +384,118 @@ void Level::Update(double deltatime)
 	_worldSphere->Update(deltatime);
 }
 
-void Level::Draw(Matrix4x4& viewProj)
+void Level::WriteFrameState(FrameState& frame) const
 {
-	_worldShader->Bind();
-	_worldShader->SetUniformValue("viewProj", viewProj);
+	if (_worldSphere != nullptr)
+		_worldSphere->CopyJoints(frame.worldSphereJoints);
+}
 
-	glDisable(GL_DEPTH_TEST);
+static const std::size_t kInstancesPerRecordJob = 64;
 
-	if (_worldSphere != nullptr)
+void Level::Draw(const FrameState& frame)
+{
+	// viewProj comes from the per-frame uniform block, only the object block changes per draw
+	auto& objectUniforms = Game::GetInstance().GetObjectUniforms();
+	auto& profiler = Game::GetInstance().GetGpuProfiler();
+	auto& shaders = Game::GetInstance().GetWorldShaders();
+	auto& jobSystem = Game::GetInstance().GetJobSystem();
+	const auto& streamer = Game::GetInstance().GetTextureStreamer();
+
+	const Matrix4x4& viewProj = Game::GetInstance().GetFrameUniforms().GetBlock().viewProj;
+	const Frustum frustum(viewProj);
+
+	// composite models are culled and recorded on the workers while this thread gets on with the GL work below,
+	// material lookups go through the resource manager so they're done up front
+	for (const auto& compositeModel : _compositeModels) compositeModel->ResolveShaders();
+
+	// models with many instances are split so the work spreads over the workers, each job's slice is one set of
+	// instanced draws
+	_recordJobs.clear();
+	for (const auto& compositeModel : _compositeModels)
+	{
+		for (std::size_t first = 0; first < compositeModel->GetInstanceCount(); first += kInstancesPerRecordJob)
+			_recordJobs.push_back(RecordJob {compositeModel.get(), first});
+	}
+
+	const std::size_t jobCount = _recordJobs.size();
+	if (_opaqueLists.size() < jobCount)
 	{
-		glDisable(GL_BLEND);
-		_worldSphere->Draw(*_worldShader, viewProj, true);
-		glEnable(GL_BLEND);
-		_worldSphere->Draw(*_worldShader, viewProj, false);
+		_opaqueLists.resize(jobCount);
+		_translucentLists.resize(jobCount);
 	}
 
-	glDisable(GL_BLEND);
-	glEnable(GL_DEPTH_TEST);
+	JobSystem::Counter recorded;
+	jobSystem.ParallelFor(recorded, jobCount, [&](std::size_t job) {
+		CommandList& opaque = _opaqueLists[job];
+		CommandList& translucent = _translucentLists[job];
+		opaque.Clear();
+		translucent.Clear();
 
-	for (const auto& ent : _entities) ent->Draw(*_worldShader, true);
+		const RecordJob& slice = _recordJobs[job];
+		slice.model->Record(opaque, translucent, frustum, viewProj, streamer, slice.firstInstance, kInstancesPerRecordJob);
 
-	for (const auto& compositeModel : _compositeModels)
-		compositeModel->Draw(*_worldShader, viewProj, compositeModel->GetTransform(), true);
+		opaque.Sort();
+	});
 
-	_billboardBatchShader->Bind();
-	_billboardBatchShader->SetUniformValue("viewProj", viewProj);
-	for (const auto& billboardBatch : _billboardBatches) billboardBatch->Draw(*_billboardBatchShader, true);
+	{
+		GpuProfiler::ScopedPass pass(profiler, "Instance culling");
+		for (const auto& instancedBatch : _instancedBatches) instancedBatch->Cull(frustum);
+	}
 
-	_worldInstancedShader->Bind();
-	_worldInstancedShader->SetUniformValue("viewProj", viewProj);
+	// texture levels to suit what's on screen, the streamer acts on them once the frame is drawn
+	for (const auto& staticBatch : _staticBatches) staticBatch->RequestTextures(streamer, frustum);
+	for (const auto& instancedBatch : _instancedBatches) instancedBatch->RequestTextures(streamer, frustum);
 
-	for (const auto& ent : _instances) ent->Draw(*_worldInstancedShader, true);
+	GL::StateCache::SetDepthTest(false);
 
-	glEnable(GL_BLEND);
+	if (_worldSphere != nullptr)
+	{
+		GpuProfiler::ScopedPass pass(profiler, "World sphere");
+		GL::StateCache::SetBlend(false);
+		_worldSphere->Draw(shaders, true, frame.worldSphereJoints);
+		GL::StateCache::SetBlend(true);
+		_worldSphere->Draw(shaders, false, frame.worldSphereJoints);
+	}
 
-	_worldShader->Bind();
-	_worldShader->SetUniformValue("viewProj", viewProj);
+	GL::StateCache::SetBlend(false);
+	GL::StateCache::SetDepthTest(true);
 
-	for (const auto& ent : _entities) ent->Draw(*_worldShader, false);
+	{
+		GpuProfiler::ScopedPass pass(profiler, "Opaque world");
+		objectUniforms.PushIdentity();
+		for (const auto& staticBatch : _staticBatches) staticBatch->Draw(shaders);
+
+		// replayed in job order so the frame doesn't depend on which worker finished first
+		jobSystem.Wait(recorded);
+		for (std::size_t job = 0; job < jobCount; ++job) _opaqueLists[job].Execute(shaders, objectUniforms);
+		objectUniforms.PushIdentity();
+	}
 
-	for (const auto& compositeModel : _compositeModels)
-		compositeModel->Draw(*_worldShader, viewProj, compositeModel->GetTransform(), false);
+	{
+		GpuProfiler::ScopedPass pass(profiler, "Billboards");
+		for (const auto& billboardBatch : _billboardBatches) billboardBatch->Draw(shaders, true);
+	}
+
+	{
+		GpuProfiler::ScopedPass pass(profiler, "Instanced");
+		for (const auto& instancedBatch : _instancedBatches) instancedBatch->Draw(shaders, true);
+	}
+
+	GpuProfiler::ScopedPass pass(profiler, "Translucent");
+	GL::StateCache::SetBlend(true);
+
+	// blending needs one order across models and static geometry, so it's all gathered up before sorting
+	_translucent.Clear();
+	for (std::size_t job = 0; job < jobCount; ++job) _translucent.Append(_translucentLists[job]);
+	for (const auto& staticBatch : _staticBatches) staticBatch->RecordTranslucent(_translucent, frustum, viewProj);
 
-	_billboardBatchShader->Bind();
-	_billboardBatchShader->SetUniformValue("viewProj", viewProj);
-	for (const auto& billboardBatch : _billboardBatches) billboardBatch->Draw(*_billboardBatchShader, false);
+	_translucent.Sort();
+	_translucent.Execute(shaders, objectUniforms);
 
-	_worldInstancedShader->Bind();
-	_worldInstancedShader->SetUniformValue("viewProj", viewProj);
+	objectUniforms.PushIdentity();
+	for (const auto& billboardBatch : _billboardBatches) billboardBatch->Draw(shaders, false);
 
-	for (const auto& ent : _instances) ent->Draw(*_worldInstancedShader, false);
+	for (const auto& instancedBatch : _instancedBatches) instancedBatch->Draw(shaders, false);
 }
 
 } // namespace Donut
@@ -3,25 +3,25 @@
 #pragma once
 
 #include "Core/Math/Fwd.h"
+#include "Render/CommandList.h"
 
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace Donut
 {
 
-namespace GL
-{
-class ShaderProgram;
-}
-
 class BillboardBatch;
 class CompositeModel;
 class LineRenderer;
 class Entity;
+struct FrameState;
 class ResourceManager;
+class StaticBatch;
+class InstancedBatch;
 class WorldSphere;
 
 class Level
@@ -30,8 +30,12 @@ public:
 	Level();
 	~Level();
 
+	// simulation thread
 	void Update(double deltatime);
-	void Draw(Matrix4x4& viewProj);
+	void WriteFrameState(FrameState&) const;
+
+	// render thread
+	void Draw(const FrameState&);
 	void LoadP3D(const std::string& filename);
 
 	void DynaLoadData(const std::string& dynaLoadData);
@@ -44,13 +48,28 @@ private:
 
 	std::unique_ptr<WorldSphere> _worldSphere;
 	std::vector<std::unique_ptr<Entity>> _entities;
+	std::vector<std::unique_ptr<StaticBatch>> _staticBatches;
+	std::vector<std::unique_ptr<InstancedBatch>> _instancedBatches;
 	std::vector<std::unique_ptr<Entity>> _instances;
 	std::vector<std::unique_ptr<BillboardBatch>> _billboardBatches;
-	std::unique_ptr<GL::ShaderProgram> _worldShader;
-	std::unique_ptr<GL::ShaderProgram> _worldInstancedShader;
-	std::unique_ptr<GL::ShaderProgram> _billboardBatchShader;
 
 	std::vector<std::unique_ptr<CompositeModel>> _compositeModels;
+	std::unordered_map<std::string, CompositeModel*> _compositeModelsByName; // by anim object wrapper
+
+	// a slice of one model's instances, recorded by one job
+	struct RecordJob
+	{
+		CompositeModel* model;
+		std::size_t firstInstance;
+	};
+	std::vector<RecordJob> _recordJobs;
+
+	// one pair per recording job, kept around so their storage is reused from frame to frame
+	std::vector<CommandList> _opaqueLists;
+	std::vector<CommandList> _translucentLists;
+
+	// every job's translucent draws and the static batches', sorted back to front as one
+	CommandList _translucent;
 
 	class Path
 	{
@@ -59,6 +78,8 @@ private:
 	};
 
 	std::vector<Path> _paths;
+
+	std::unordered_set<std::string> _loadedFiles;
 };
 
 } // namespace Donut
@@ -1241,7 +1241,7 @@ Texture::Texture(const P3DChunk& chunk)
 		{
 		case ChunkType::Image:
 		{
-			_image = std::make_unique<Image>(*child);
+			_images.push_back(std::make_unique<Image>(*child));
 			break;
 		}
 		default: break;
@@ -1319,7 +1319,7 @@ public:
 	const uint32_t& GetTextureType() const { return _textureType; }
 	const uint32_t& GetUsage() const { return _usage; }
 	const uint32_t& GetPriority() const { return _priority; }
-	const std::unique_ptr<Image>& GetImage() const { return _image; }
+	const std::vector<std::unique_ptr<Image>>& GetImages() const { return _images; }
 
 private:
 	std::string _name;
@@ -1332,7 +1332,7 @@ private:
 	uint32_t _textureType;
 	uint32_t _usage;
 	uint32_t _priority;
-	std::unique_ptr<Image> _image;
+	std::vector<std::unique_ptr<Image>> _images;
 };
 
 class Image
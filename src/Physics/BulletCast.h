@@ -54,4 +54,13 @@ inline btMatrix3x3 BulletCast(const Matrix3x3& m)
 {
 	return btMatrix3x3(m.M[0][0], m.M[0][1], m.M[0][2], m.M[1][0], m.M[1][1], m.M[1][2], m.M[2][0], m.M[2][1], m.M[2][2]);
 }
+
+template <>
+inline Matrix4x4 BulletCast(const btTransform& t)
+{
+	const btMatrix3x3& b = t.getBasis();
+	const btVector3& o = t.getOrigin();
+	return Matrix4x4(b[0][0], b[1][0], b[2][0], 0.0f, b[0][1], b[1][1], b[2][1], 0.0f, b[0][2], b[1][2], b[2][2], 0.0f, o.x(),
+	                 o.y(), o.z(), 1.0f);
+}
 } // namespace Donut
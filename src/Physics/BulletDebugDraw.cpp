@@ -9,15 +9,65 @@ namespace Donut
 {
 BulletDebugDraw::BulletDebugDraw(LineRenderer* lineRenderer): m_debugMode(DBG_NoDebug), m_lineRenderer(lineRenderer) {}
 
+static Vector4 debugColour(const btVector3& color)
+{
+	return Vector4(color.x(), color.y(), color.z(), 0.75f);
+}
+
 void BulletDebugDraw::drawLine(const btVector3& from, const btVector3& to, const btVector3& color)
 {
 	if (m_lineRenderer == nullptr)
 		return;
 
-	Vector3 c = BulletCast<Vector3>(color);
-	Vector4 drawColour(c.X, c.Y, c.Z, 0.75f);
+	m_lineRenderer->DrawLine(BulletCast<Vector3>(from), BulletCast<Vector3>(to), debugColour(color));
+}
+
+void BulletDebugDraw::drawSphere(btScalar radius, const btTransform& transform, const btVector3& color)
+{
+	if (m_lineRenderer == nullptr)
+		return;
+
+	m_lineRenderer->DrawSphere(BulletCast<Matrix4x4>(transform), radius, debugColour(color));
+}
+
+void BulletDebugDraw::drawBox(const btVector3& bbMin, const btVector3& bbMax, const btVector3& color)
+{
+	drawAabb(bbMin, bbMax, color);
+}
+
+void BulletDebugDraw::drawBox(const btVector3& bbMin, const btVector3& bbMax, const btTransform& trans,
+                              const btVector3& color)
+{
+	if (m_lineRenderer == nullptr)
+		return;
+
+	m_lineRenderer->DrawBox(BulletCast<Matrix4x4>(trans), BulletCast<Vector3>(bbMin), BulletCast<Vector3>(bbMax),
+	                        debugColour(color));
+}
+
+void BulletDebugDraw::drawAabb(const btVector3& from, const btVector3& to, const btVector3& color)
+{
+	if (m_lineRenderer == nullptr)
+		return;
+
+	m_lineRenderer->DrawAABBox(BulletCast<Vector3>(from), BulletCast<Vector3>(to), debugColour(color));
+}
+
+void BulletDebugDraw::drawCone(btScalar radius, btScalar height, int upAxis, const btTransform& transform,
+                               const btVector3& color)
+{
+	if (m_lineRenderer == nullptr)
+		return;
+
+	// bullet's cone is centred on the origin with the apex up the given axis, ours sits on its base with the apex up Y
+	const Matrix4x4 axes[] = {
+	    Matrix4x4(0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f),
+	    Matrix4x4::Identity,
+	    Matrix4x4(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f),
+	};
 
-	m_lineRenderer->DrawLine(BulletCast<Vector3>(from), BulletCast<Vector3>(to), drawColour);
+	const Matrix4x4 local = axes[upAxis % 3] * Matrix4x4::MakeTranslate(Vector3(0.0f, -height * 0.5f, 0.0f));
+	m_lineRenderer->DrawCone(BulletCast<Matrix4x4>(transform) * local, radius, height, debugColour(color));
 }
 
 void BulletDebugDraw::drawContactPoint(const btVector3& PointOnB, const btVector3& normalOnB, btScalar distance, int lifeTime,
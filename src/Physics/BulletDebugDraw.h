@@ -14,6 +14,13 @@ public:
 	BulletDebugDraw(LineRenderer* lineRenderer);
 
 	virtual void drawLine(const btVector3& from, const btVector3& to, const btVector3& color);
+
+	// shapes go to the line renderer's instanced meshes rather than being expanded into lines here
+	virtual void drawSphere(btScalar radius, const btTransform& transform, const btVector3& color);
+	virtual void drawBox(const btVector3& bbMin, const btVector3& bbMax, const btVector3& color);
+	virtual void drawBox(const btVector3& bbMin, const btVector3& bbMax, const btTransform& trans, const btVector3& color);
+	virtual void drawAabb(const btVector3& from, const btVector3& to, const btVector3& color);
+	virtual void drawCone(btScalar radius, btScalar height, int upAxis, const btTransform& transform, const btVector3& color);
 	virtual void drawTransform(const btTransform& transform, btScalar orthoLen);
 	virtual void drawContactPoint(const btVector3& PointOnB, const btVector3& normalOnB, btScalar distance, int lifeTime,
 	                              const btVector3& color);
@@ -57,12 +57,17 @@ WorldPhysics::~WorldPhysics()
 
 void WorldPhysics::Update(const float dt) const
 {
-	// _dynamicsWorld->stepSimulation(dt);
-	_dynamicsWorld->debugDrawWorld();
+	// dt is already a fixed step, no substepping or interpolation on bullet's side
+	_dynamicsWorld->stepSimulation(dt, 0);
 
 	// _char->Update(_dynamicsWorld, dt);
 }
 
+void WorldPhysics::DebugDraw() const
+{
+	_dynamicsWorld->debugDrawWorld();
+}
+
 void WorldPhysics::AddIntersect(const P3D::Intersect& intersect)
 {
 	// copy this shit over first (todo: free it?)
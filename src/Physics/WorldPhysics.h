@@ -43,6 +43,7 @@ public:
 	~WorldPhysics();
 
 	void Update(float dt) const;
+	void DebugDraw() const; // render thread, feeds the line renderer
 
 	void AddIntersect(const P3D::Intersect&);
 	void AddCollisionVolume(const P3D::CollisionVolume&);
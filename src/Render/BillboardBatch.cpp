@@ -6,9 +6,11 @@
 #include "P3D/P3D.generated.h"
 #include "Render/OpenGL/IndexBuffer.h"
 #include "Render/OpenGL/ShaderProgram.h"
+#include "Render/OpenGL/StateCache.h"
 #include "Render/OpenGL/VertexBinding.h"
 #include "Render/OpenGL/VertexBuffer.h"
 #include "Render/Shader.h"
+#include "Render/ShaderVariants.h"
 #include "ResourceManager.h"
 
 #include <array>
@@ -33,7 +35,7 @@ static std::array<Vector2, 4> quadVertices = {
     Vector2(-0.5, -0.5),
 };
 
-static std::array<uint32_t, 6> indices = {0, 1, 2, 2, 3, 0};
+static std::array<uint16_t, 6> indices = {0, 1, 2, 2, 3, 0};
 
 BillboardBatch::BillboardBatch(const P3D::BillboardQuadGroup& billboardQuadGroup)
 {
@@ -58,7 +60,7 @@ BillboardBatch::BillboardBatch(const P3D::BillboardQuadGroup& billboardQuadGroup
 	}
 
 	_vertexBuffer = std::make_shared<GL::VertexBuffer>(quadVertices.data(), quadVertices.size(), vertStride);
-	_indexBuffer = std::make_shared<GL::IndexBuffer>(indices.data(), indices.size(), GL_UNSIGNED_INT);
+	_indexBuffer = std::make_shared<GL::IndexBuffer>(indices.data(), indices.size(), GL_UNSIGNED_SHORT);
 	_instanceBuffer = std::make_shared<GL::VertexBuffer>(quadInstances.data(), _numQuads, instanceStride);
 
 	GL::ArrayElement vertexLayout[] = {
@@ -73,14 +75,14 @@ BillboardBatch::BillboardBatch(const P3D::BillboardQuadGroup& billboardQuadGroup
 	};
 
 	_vertexBinding = std::make_shared<GL::VertexBinding>();
-	_vertexBinding->Create(vertexLayout, 8, *_indexBuffer, GL::ElementType::AE_UINT);
+	_vertexBinding->Create(vertexLayout, 8, *_indexBuffer, GL::ElementType::AE_USHORT);
 
 	_shader = billboardQuadGroup.GetShader();
 	_zTest = billboardQuadGroup.GetZTest() == 1;
 	_zWrite = billboardQuadGroup.GetZWrite() == 1;
 }
 
-void BillboardBatch::Draw(GL::ShaderProgram& shader, bool opaque)
+void BillboardBatch::Draw(ShaderVariants& shaders, bool opaque)
 {
 	auto const& material = Game::GetInstance().GetResourceManager().GetShader(_shader);
 
@@ -102,34 +104,34 @@ void BillboardBatch::Draw(GL::ShaderProgram& shader, bool opaque)
 
 		if (blendMode == BlendMode::Alpha)
 		{
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			GL::StateCache::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 		}
 		else if (blendMode == BlendMode::Additive)
 		{
-			glBlendFunc(GL_ONE, GL_ONE);
+			GL::StateCache::BlendFunc(GL_ONE, GL_ONE);
 		}
 	}
 
 	if (_zTest)
 	{
-		glEnable(GL_DEPTH_TEST);
+		GL::StateCache::SetDepthTest(true);
 	}
 	else
 	{
-		glDisable(GL_DEPTH_TEST);
+		GL::StateCache::SetDepthTest(false);
 	}
 
-	glDepthMask(_zWrite ? GL_TRUE : GL_FALSE);
+	GL::StateCache::DepthMask(_zWrite);
 
-	shader.SetUniformValue("alphaMask", material->IsAlphaTested() ? 0.5f : 0.0f);
+	shaders.Get(BillboardFeature | VertexColorFeature | material->GetShaderFeatures()).Bind();
 
 	_vertexBinding->Bind();
 
 	material->Bind(0);
-	glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, _numQuads);
-	_vertexBinding->Unbind();
+	GL::StateCache::CountDraw();
+	glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0, _numQuads);
 
-	glEnable(GL_DEPTH_TEST);
-	glDepthMask(GL_TRUE);
+	GL::StateCache::SetDepthTest(true);
+	GL::StateCache::DepthMask(true);
 }
 } // namespace Donut
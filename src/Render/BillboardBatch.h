@@ -9,7 +9,6 @@ namespace Donut
 {
 namespace GL
 {
-class ShaderProgram;
 class VertexBuffer;
 class IndexBuffer;
 class VertexBinding;
@@ -21,13 +20,14 @@ class BillboardQuadGroup;
 }
 
 class Shader;
+class ShaderVariants;
 
 class BillboardBatch
 {
 public:
 	BillboardBatch(const P3D::BillboardQuadGroup& billboardQuadGroup);
 
-	void Draw(GL::ShaderProgram& shader, bool opaque);
+	void Draw(ShaderVariants& shaders, bool opaque);
 
 private:
 	std::shared_ptr<GL::VertexBuffer> _vertexBuffer;
@@ -0,0 +1,69 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include "BonePalette.h"
+
+#include "Core/Math/Matrix4x4.h"
+#include "Render/OpenGL/TextureBuffer.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace Donut
+{
+
+BonePalette::BonePalette(): _mapped(nullptr), _capacity(0), _count(0)
+{
+	_buffer = std::make_unique<GL::TextureBuffer>();
+}
+
+BonePalette::~BonePalette() = default;
+
+void BonePalette::Begin(std::size_t boneCount)
+{
+	assert(_mapped == nullptr);
+
+	// never map nothing, the texture still needs a range to point at
+	_capacity = std::max<std::size_t>(boneCount, 1);
+	_count = 0;
+	_mapped = static_cast<float*>(_buffer->Map(_capacity * kTexelsPerBone * 4 * sizeof(float)));
+}
+
+uint32_t BonePalette::Write(const Matrix4x4* bones, std::size_t count)
+{
+	assert(_mapped != nullptr);
+	assert(_count + count <= _capacity);
+
+	const uint32_t base = static_cast<uint32_t>(_count);
+
+	// rows of the column major matrix, the bottom one is always (0, 0, 0, 1)
+	float* out = _mapped + _count * kTexelsPerBone * 4;
+	for (std::size_t i = 0; i < count; i++)
+	{
+		const Matrix4x4& bone = bones[i];
+		for (std::size_t row = 0; row < kTexelsPerBone; row++)
+		{
+			*out++ = bone.M[0][row];
+			*out++ = bone.M[1][row];
+			*out++ = bone.M[2][row];
+			*out++ = bone.M[3][row];
+		}
+	}
+
+	_count += count;
+	return base;
+}
+
+void BonePalette::End()
+{
+	assert(_mapped != nullptr);
+
+	_buffer->Unmap();
+	_mapped = nullptr;
+}
+
+void BonePalette::Bind(GLuint unit)
+{
+	_buffer->Bind(unit);
+}
+
+} // namespace Donut
@@ -0,0 +1,49 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include "Render/OpenGL/glad/glad.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace Donut
+{
+class Matrix4x4;
+
+namespace GL
+{
+class TextureBuffer;
+} // namespace GL
+
+// Every skinned character's bones for one frame, in one buffer. Each palette is written straight into mapped stream
+// memory as 3x4 matrices (the three rows of an affine transform, one texel each) and a draw only passes the bone
+// index its palette starts at, so the whole frame is one upload however many characters are on screen.
+class BonePalette
+{
+public:
+	static constexpr std::size_t kTexelsPerBone = 3;
+
+	BonePalette();
+	~BonePalette();
+
+	// maps room for boneCount bones, every Write of the frame has to fit in it
+	void Begin(std::size_t boneCount);
+
+	// copies one character's bones in, returns the base index its draws pass as boneBase
+	uint32_t Write(const Matrix4x4* bones, std::size_t count);
+
+	// hands the written bones to the texture, bind afterwards
+	void End();
+
+	void Bind(GLuint unit);
+
+private:
+	std::unique_ptr<GL::TextureBuffer> _buffer;
+	float* _mapped;
+	std::size_t _capacity;
+	std::size_t _count;
+};
+
+} // namespace Donut
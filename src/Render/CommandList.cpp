@@ -0,0 +1,227 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include <Render/CommandList.h>
+#include <Render/OpenGL/ShaderProgram.h>
+#include <Render/OpenGL/StateCache.h>
+#include <Render/OpenGL/VertexBinding.h>
+#include <Render/ShaderVariants.h>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+
+namespace Donut
+{
+
+// view depth that maps to the last depth bucket of a sort key
+static const float kKeyDepthRange = 1000.0f;
+
+static uint64_t pointerId(const void* pointer, uint32_t bits)
+{
+	// allocations are at least 16 byte aligned, the low bits never differ
+	return (reinterpret_cast<uintptr_t>(pointer) >> 4) & ((1ull << bits) - 1);
+}
+
+uint64_t CommandList::MakeOpaqueKey(uint32_t features, const Shader* material, const GL::VertexBinding* geometry,
+                                    float depth)
+{
+	const float depthClamped = std::min(std::max(depth / kKeyDepthRange, 0.0f), 1.0f);
+	const uint64_t depthBits = static_cast<uint64_t>(depthClamped * 1023.0f);
+
+	return (static_cast<uint64_t>(features & 0x3F) << 58) | (pointerId(material, 24) << 34) |
+	       (pointerId(geometry, 24) << 10) | depthBits;
+}
+
+uint64_t CommandList::MakeTranslucentKey(BlendMode blendMode, uint32_t features, const Shader* material,
+                                         const GL::VertexBinding* geometry, float depth)
+{
+	// the top half of a positive float's bits orders like the float itself, with a bucket every 1/128th of a doubling:
+	// fine up close, coarse far away, no range to pick
+	uint32_t depthBits = 0;
+	if (depth > 0.0f)
+		std::memcpy(&depthBits, &depth, sizeof(depthBits));
+	const uint64_t farFirst = 0xFFFF - (depthBits >> 16);
+
+	return (farFirst << 48) | ((static_cast<uint64_t>(blendMode) & 0x3) << 46) |
+	       (static_cast<uint64_t>(features & 0x3F) << 40) | (pointerId(material, 24) << 16) | pointerId(geometry, 16);
+}
+
+CommandList::ObjectHandle CommandList::PushObject(const Matrix4x4& model)
+{
+	_objects.push_back(ObjectBlock {model});
+	return static_cast<ObjectHandle>(_objects.size() - 1);
+}
+
+uint32_t CommandList::PushInstances(const Matrix4x4* transforms, std::size_t count)
+{
+	const uint32_t first = static_cast<uint32_t>(_instances.size());
+	_instances.insert(_instances.end(), transforms, transforms + count);
+	return first;
+}
+
+void CommandList::Append(const CommandList& other)
+{
+	const auto objectBase = static_cast<ObjectHandle>(_objects.size());
+	_objects.insert(_objects.end(), other._objects.begin(), other._objects.end());
+
+	const uint32_t instanceBase = other._instances.empty() ? 0 : PushInstances(other._instances.data(), other._instances.size());
+
+	for (DrawItem item : other._items)
+	{
+		if (item.instanceCount > 0)
+			item.firstInstance += instanceBase;
+		else if (item.object != kIdentity)
+			item.object += objectBase;
+
+		_items.push_back(item);
+	}
+}
+
+void CommandList::Sort()
+{
+	const std::size_t count = _items.size();
+	if (count < 2)
+		return;
+
+	_keys.resize(count);
+	_order.resize(count);
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		_keys[i] = _items[i].sortKey;
+		_order[i] = static_cast<uint32_t>(i);
+	}
+
+	_keysScratch.resize(count);
+	_orderScratch.resize(count);
+
+	// least significant byte first, each pass stable, so the result is ordered by the whole key with ties left in
+	// recording order; keys and indices move rather than whole draws, and a byte every key shares is skipped
+	for (uint32_t shift = 0; shift < 64; shift += 8)
+	{
+		std::array<uint32_t, 256> offsets {};
+		for (uint64_t key : _keys) offsets[(key >> shift) & 0xFF]++;
+
+		if (offsets[(_keys[0] >> shift) & 0xFF] == count)
+			continue;
+
+		uint32_t total = 0;
+		for (uint32_t& offset : offsets)
+		{
+			const uint32_t bucket = offset;
+			offset = total;
+			total += bucket;
+		}
+
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const uint32_t slot = offsets[(_keys[i] >> shift) & 0xFF]++;
+			_keysScratch[slot] = _keys[i];
+			_orderScratch[slot] = _order[i];
+		}
+
+		std::swap(_keys, _keysScratch);
+		std::swap(_order, _orderScratch);
+	}
+
+	_itemsScratch.resize(count);
+	for (std::size_t i = 0; i < count; ++i) _itemsScratch[i] = _items[_order[i]];
+	std::swap(_items, _itemsScratch);
+}
+
+void CommandList::Clear()
+{
+	_items.clear();
+	_objects.clear();
+	_instances.clear();
+}
+
+void CommandList::Execute(ShaderVariants& shaders, ObjectUniformRing& objectUniforms) const
+{
+	if (_items.empty())
+		return;
+
+	// every block in one upload, draws just bind their slice
+	std::size_t objectBase = _objects.empty() ? 0 : objectUniforms.Upload(_objects.data(), _objects.size());
+
+	// Instance transforms go up a window at a time, as many as a draw can address and a stream region holds. When
+	// the whole list fits that's one upload at the start; past that a draw outside the bound window moves it on, and
+	// one that doesn't fit in a window is split across several.
+	ObjectHandle boundObject = kIdentity - 1;
+	const std::size_t instanceCount = _instances.size();
+	const std::size_t windowSize = std::min<std::size_t>(kMaxInstances, objectUniforms.GetInstanceCapacity());
+	std::size_t windowStart = 0;
+	std::size_t windowEnd = 0;
+
+	const auto drawInstanced = [&](const DrawItem& item) {
+		std::size_t first = item.firstInstance;
+		std::size_t remaining = item.instanceCount;
+		while (remaining > 0)
+		{
+			if (first < windowStart || first + std::min(remaining, windowSize) > windowEnd)
+			{
+				// each upload can move the ring on a region, the object blocks go up again alongside so the ones
+				// still to be drawn from are never in the region it wraps back round to
+				if (windowEnd != 0 && !_objects.empty())
+				{
+					objectBase = objectUniforms.Upload(_objects.data(), _objects.size());
+					boundObject = kIdentity - 1;
+				}
+
+				windowStart = std::min(first, std::max(instanceCount, windowSize) - windowSize);
+				windowEnd = std::min(windowStart + windowSize, instanceCount);
+
+				const std::size_t base =
+				    objectUniforms.UploadInstances(&_instances[windowStart], windowEnd - windowStart);
+				objectUniforms.BindInstances(base, windowEnd - windowStart);
+			}
+
+			const std::size_t count = std::min(remaining, windowEnd - first);
+
+			GL::StateCache::CountDraw();
+			glDrawElementsInstancedBaseInstance(item.primitive, static_cast<GLsizei>(item.indexCount), item.indexType,
+			                                    reinterpret_cast<void*>(item.indexOffset), static_cast<GLsizei>(count),
+			                                    static_cast<GLuint>(first - windowStart));
+			first += count;
+			remaining -= count;
+		}
+	};
+
+	for (const auto& item : _items)
+	{
+		GL::StateCache::SetDepthTest(item.state.depthTest);
+		GL::StateCache::SetBlend(item.state.blend);
+		if (item.state.blend)
+		{
+			if (item.state.blendMode == BlendMode::Alpha)
+				GL::StateCache::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			else if (item.state.blendMode == BlendMode::Additive)
+				GL::StateCache::BlendFunc(GL_ONE, GL_ONE);
+		}
+
+		shaders.Get(item.features).Bind();
+		item.material->Bind(0);
+		item.geometry->Bind();
+
+		if (item.instanceCount > 0)
+		{
+			drawInstanced(item);
+			continue;
+		}
+
+		if (item.object != boundObject)
+		{
+			if (item.object == kIdentity)
+				objectUniforms.PushIdentity();
+			else
+				objectUniforms.Bind(objectBase, item.object);
+			boundObject = item.object;
+		}
+
+		GL::StateCache::CountDraw();
+		glDrawElements(item.primitive, static_cast<GLsizei>(item.indexCount), item.indexType,
+		               reinterpret_cast<void*>(item.indexOffset));
+	}
+}
+
+} // namespace Donut
@@ -0,0 +1,100 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include "Core/Math/Matrix4x4.h"
+#include "Render/Shader.h"
+#include "Render/UniformBlocks.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Donut
+{
+
+class ShaderVariants;
+
+namespace GL
+{
+class VertexBinding;
+}
+
+// fixed-function state a draw needs, applied through StateCache on replay
+struct StateBlock
+{
+	bool depthTest = true;
+	bool blend = false;
+	BlendMode blendMode = BlendMode::None;
+};
+
+// one indexed draw, everything by handle so it can be built without the GL context
+struct DrawItem
+{
+	uint64_t sortKey;
+	StateBlock state;
+	uint32_t features; // ShaderFeature bits for the world shader variant
+	const Shader* material;
+	GL::VertexBinding* geometry;
+	GLenum primitive;
+	GLenum indexType;
+	std::size_t indexCount;
+	std::size_t indexOffset; // bytes
+	uint32_t object;         // from PushObject, or kIdentity
+
+	// instanced draws read their transforms from the list's instances instead of an object block
+	uint32_t firstInstance = 0; // from PushInstances
+	uint32_t instanceCount = 0; // 0 for a plain draw
+};
+
+// Draws recorded on any thread and replayed on the GL thread. Recording only touches CPU memory: object blocks are
+// copied into the list and referenced by index, so worker jobs can each fill their own list and the main thread
+// executes them in order afterwards. Uploading the blocks and binding state happens in Execute.
+class CommandList
+{
+public:
+	using ObjectHandle = uint32_t;
+	static constexpr ObjectHandle kIdentity = ~0u;
+
+	// the most instance transforms one draw can reach at once, the instanced vertex bindings can't index past it;
+	// Execute splits a list holding more into windows of at most this many
+	static constexpr uint32_t kMaxInstances = 1 << 16;
+
+	ObjectHandle PushObject(const Matrix4x4& model);
+
+	// copies count world transforms in for an instanced draw, returns its firstInstance
+	uint32_t PushInstances(const Matrix4x4* transforms, std::size_t count);
+
+	void Draw(const DrawItem& item) { _items.push_back(item); }
+
+	// copies another list's draws in after this one's, with their object blocks and instance transforms
+	void Append(const CommandList& other);
+
+	// orders by sortKey, recording order breaks ties; a radix sort, linear in the number of draws
+	void Sort();
+	void Clear();
+
+	// GL thread only
+	void Execute(ShaderVariants& shaders, ObjectUniformRing& objectUniforms) const;
+
+	std::size_t GetDrawCount() const { return _items.size(); }
+
+	// groups opaque draws by shader variant, then material, then geometry, nearest first within those
+	static uint64_t MakeOpaqueKey(uint32_t features, const Shader* material, const GL::VertexBinding* geometry, float depth);
+
+	// farthest first for blending, draws at about the same depth grouped by blend mode, shader variant and material
+	static uint64_t MakeTranslucentKey(BlendMode blendMode, uint32_t features, const Shader* material,
+	                                   const GL::VertexBinding* geometry, float depth);
+
+private:
+	std::vector<DrawItem> _items;
+	std::vector<ObjectBlock> _objects;
+	std::vector<Matrix4x4> _instances;
+
+	// Sort scratch, kept so a steady frame doesn't allocate
+	std::vector<uint64_t> _keys, _keysScratch;
+	std::vector<uint32_t> _order, _orderScratch;
+	std::vector<DrawItem> _itemsScratch;
+};
+
+} // namespace Donut
@@ -4,8 +4,15 @@
 #include <P3D/P3D.generated.h>
 #include <P3D/P3DFile.h>
 #include <Render/CompositeModel.h>
+#include <Render/TextureStreamer.h>
+#include <Render/UniformBlocks.h>
 #include "Core/FileSystem.h"
+#include "Core/Math/Frustum.h"
+
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
 
 namespace Donut
 {
@@ -61,6 +68,7 @@ CompositeModel::CompositeModel(const ICompositeModel& provider)
 		meshNames.insert({meshP3D->GetName(), _meshes.size()});
 		auto mesh = std::make_unique<Mesh>(*meshP3D);
 		mesh->Commit();
+		mesh->CommitInstanced();
 		_meshes.push_back(std::move(mesh));
 	}
 
@@ -120,12 +128,68 @@ std::unique_ptr<CompositeModel> CompositeModel::LoadP3D(const std::string& filen
 	return std::make_unique<CompositeModel>(CompositeModel_Chunk(p3d.GetRoot()));
 }
 
-void CompositeModel::Draw(GL::ShaderProgram& shader, const Matrix4x4& viewProj, const Matrix4x4& modelMatrix, bool opaque)
+void CompositeModel::ResolveShaders()
 {
+	for (auto& mesh : _meshes) mesh->ResolveShaders();
+}
+
+void CompositeModel::Record(CommandList& opaque, CommandList& translucent, const Frustum& frustum,
+                            const Matrix4x4& viewProj, const TextureStreamer& streamer, std::size_t first,
+                            std::size_t count) const
+{
+	// several jobs can be recording different instances of this model at once
+	thread_local std::vector<Matrix4x4> visible;
+	thread_local std::vector<float> visibleDepths;
+
+	const std::size_t last = std::min(first + count, _instances.size());
 	for (const auto& prop : _props)
 	{
-		shader.SetUniformValue("viewProj", viewProj * modelMatrix * prop.transform);
-		_meshes[prop.meshIndex]->Draw(shader, opaque);
+		const Mesh& mesh = *_meshes[prop.meshIndex];
+		const BoundingSphere local = mesh.GetBoundingSphere();
+		const Vector3 c = local.GetCenter();
+
+		visible.clear();
+		visibleDepths.clear();
+		float nearest = std::numeric_limits<float>::max();
+		float largest = 0.0f;
+
+		for (std::size_t i = first; i < last; ++i)
+		{
+			const Matrix4x4 world = _instances[i] * prop.transform;
+
+			const Vector3 centre(world.M[0][0] * c.X + world.M[1][0] * c.Y + world.M[2][0] * c.Z + world.M[3][0],
+			                     world.M[0][1] * c.X + world.M[1][1] * c.Y + world.M[2][1] * c.Z + world.M[3][1],
+			                     world.M[0][2] * c.X + world.M[1][2] * c.Y + world.M[2][2] * c.Z + world.M[3][2]);
+
+			float scale = 0.0f;
+			for (int col = 0; col < 3; ++col)
+				scale = std::max(scale, std::sqrt(world.M[col][0] * world.M[col][0] + world.M[col][1] * world.M[col][1] +
+				                                  world.M[col][2] * world.M[col][2]));
+
+			const BoundingSphere sphere(centre, local.GetRadius() * scale);
+			if (!frustum.Intersects(sphere))
+				continue;
+
+			// clip space w, the distance along the view direction
+			const float depth = viewProj.M[0][3] * centre.X + viewProj.M[1][3] * centre.Y +
+			                    viewProj.M[2][3] * centre.Z + viewProj.M[3][3];
+
+			nearest = std::min(nearest, depth);
+			largest = std::max(largest, streamer.GetScreenSize(sphere));
+			visible.push_back(world);
+			visibleDepths.push_back(depth);
+		}
+
+		if (visible.empty())
+			continue;
+
+		mesh.RequestTextures(streamer, largest);
+
+		// one instance goes down the plain path, nothing to gain from the transform buffer
+		if (visible.size() == 1)
+			mesh.Record(opaque, translucent, visible[0], nearest);
+		else
+			mesh.RecordInstanced(opaque, translucent, visible.data(), visibleDepths.data(), visible.size(), nearest);
 	}
 }
 } // namespace Donut
@@ -10,6 +10,9 @@
 
 namespace Donut
 {
+class Frustum;
+class TextureStreamer;
+
 class ICompositeModel
 {
 public:
@@ -63,6 +66,8 @@ private:
 	std::vector<std::unique_ptr<P3D::Texture>> _textures;
 };
 
+// The meshes of one composite drawable source and every placement of it in the world. Placements share the meshes
+// and are drawn together: each prop mesh is one instanced draw over the instances that survive culling.
 class CompositeModel
 {
 public:
@@ -70,10 +75,16 @@ public:
 
 	static std::unique_ptr<CompositeModel> LoadP3D(const std::string&);
 
-	void Draw(GL::ShaderProgram&, const Matrix4x4&, const Matrix4x4&, bool);
+	// GL thread, before Record
+	void ResolveShaders();
+
+	// culls each prop of instances [first, first + count) against the frustum and records one instanced draw per prop
+	// for the visible ones, asking the streamer for texture levels to suit the nearest; safe to call from a job
+	void Record(CommandList& opaque, CommandList& translucent, const Frustum& frustum, const Matrix4x4& viewProj,
+	            const TextureStreamer& streamer, std::size_t first, std::size_t count) const;
 
-	void SetTransform(const Matrix4x4& transform) { _transform = transform; }
-	const Matrix4x4& GetTransform() const { return _transform; }
+	void AddInstance(const Matrix4x4& transform) { _instances.push_back(transform); }
+	std::size_t GetInstanceCount() const { return _instances.size(); }
 
 private:
 	struct DrawableProp
@@ -82,7 +93,7 @@ private:
 		Matrix4x4 transform;
 	};
 
-	Matrix4x4 _transform;
+	std::vector<Matrix4x4> _instances;
 	std::vector<std::unique_ptr<Mesh>> _meshes;
 	std::vector<std::unique_ptr<BillboardBatch>> _billboards;
 	std::vector<DrawableProp> _props;
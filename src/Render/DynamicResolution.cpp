@@ -0,0 +1,161 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include "DynamicResolution.h"
+
+#include "Core/Math/Vector2.h"
+#include "Render/GpuProfiler.h"
+#include "Render/OpenGL/FrameBuffer.h"
+#include "Render/OpenGL/ShaderProgram.h"
+#include "Render/OpenGL/StateCache.h"
+#include "Render/OpenGL/VertexBinding.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace Donut
+{
+std::string UpscaleVertSrc = R"glsl(
+		#version 330 core
+
+		uniform vec2 uvScale; // the drawn part of the target
+
+		out vec2 frag_texcoord;
+
+		void main()
+		{
+			// one triangle covering the screen, (0, 0) (2, 0) (0, 2) in uv
+			vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+
+			frag_texcoord = corner * uvScale;
+			gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+		}
+	)glsl";
+
+std::string UpscaleFragSrc = R"glsl(
+		#version 330 core
+
+		uniform sampler2D sceneTexture;
+		uniform vec2 uvMax; // last texel centre drawn to, filtering mustn't reach past it
+
+		in vec2 frag_texcoord;
+
+		out vec4 outColor;
+
+		void main()
+		{
+			outColor = vec4(texture(sceneTexture, min(frag_texcoord, uvMax)).rgb, 1.0);
+		}
+	)glsl";
+
+// only move when the frame is over budget or this far under it, so the scale doesn't hunt around the target
+static const float kGrowHeadroom = 1.15f;
+
+// per measured frame, the timings run a few frames behind so big steps would overshoot
+static const float kMaxScaleDown = 0.1f;
+static const float kMaxScaleUp = 0.02f;
+
+DynamicResolution::DynamicResolution(float targetMs, float minScale, float maxScale, int samples)
+    : _targetMs(targetMs), _minScale(minScale), _maxScale(maxScale), _samples(samples), _enabled(true),
+      _scale(maxScale), _lastFrameIndex(0), _nativeWidth(0), _nativeHeight(0), _renderWidth(1), _renderHeight(1)
+{
+	_upscaleShader = std::make_unique<GL::ShaderProgram>(UpscaleVertSrc, UpscaleFragSrc);
+	_upscaleShader->Bind();
+	_upscaleShader->SetUniformValue("sceneTexture", 0);
+
+	_emptyBinding = std::make_unique<GL::VertexBinding>();
+	_emptyBinding->Create(nullptr, 0);
+}
+
+DynamicResolution::~DynamicResolution() = default;
+
+void DynamicResolution::SetScaleBounds(float minScale, float maxScale)
+{
+	minScale = std::min(minScale, maxScale);
+	if (minScale == _minScale && maxScale == _maxScale)
+		return;
+
+	// the target is sized for the largest scale, only that needs a new one
+	if (maxScale != _maxScale)
+		_target.reset();
+
+	_minScale = minScale;
+	_maxScale = maxScale;
+	_scale = std::min(std::max(_scale, _minScale), _maxScale);
+}
+
+void DynamicResolution::Update(const GpuProfiler& profiler, int nativeWidth, int nativeHeight)
+{
+	if (_target == nullptr || nativeWidth != _nativeWidth || nativeHeight != _nativeHeight)
+	{
+		_nativeWidth = nativeWidth;
+		_nativeHeight = nativeHeight;
+		createTarget();
+	}
+
+	const GpuProfiler::Frame* latest = profiler.GetLatest();
+	if (!_enabled)
+	{
+		_scale = _maxScale;
+	}
+	else if (latest != nullptr && latest->index != _lastFrameIndex && latest->gpuMs > 0.0)
+	{
+		_lastFrameIndex = latest->index;
+
+		// GPU time goes roughly with the pixel count, i.e. the square of the scale
+		const float ratio = _targetMs / static_cast<float>(latest->gpuMs);
+		if (ratio < 1.0f || ratio > kGrowHeadroom)
+		{
+			const float wanted = _scale * std::sqrt(ratio);
+			_scale += std::min(std::max(wanted - _scale, -kMaxScaleDown), kMaxScaleUp);
+			_scale = std::min(std::max(_scale, _minScale), _maxScale);
+		}
+	}
+
+	_renderWidth = std::max(1, static_cast<int>(_nativeWidth * _scale + 0.5f));
+	_renderHeight = std::max(1, static_cast<int>(_nativeHeight * _scale + 0.5f));
+}
+
+void DynamicResolution::BeginScene()
+{
+	_target->Bind();
+}
+
+void DynamicResolution::Upscale()
+{
+	_target->Resolve(_renderWidth, _renderHeight);
+
+	GL::FrameBuffer::Unbind();
+	glViewport(0, 0, _nativeWidth, _nativeHeight);
+
+	GL::StateCache::SetDepthTest(false);
+	GL::StateCache::SetBlend(false);
+
+	const float targetWidth = static_cast<float>(_target->GetWidth());
+	const float targetHeight = static_cast<float>(_target->GetHeight());
+
+	_upscaleShader->Bind();
+	_upscaleShader->SetUniformValue("uvScale", Vector2(_renderWidth / targetWidth, _renderHeight / targetHeight));
+	_upscaleShader->SetUniformValue("uvMax", Vector2((_renderWidth - 0.5f) / targetWidth, (_renderHeight - 0.5f) / targetHeight));
+
+	GL::StateCache::BindTexture(0, GL_TEXTURE_2D, _target->GetColorTexture(0));
+	_emptyBinding->Bind();
+
+	GL::StateCache::CountDraw();
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	GL::StateCache::SetDepthTest(true);
+}
+
+void DynamicResolution::createTarget()
+{
+	GL::FrameBuffer::Format format;
+	format.EnableDepthBuffer(true, false);
+	format.SetSamples(_samples);
+
+	const int width = std::max(1, static_cast<int>(std::ceil(_nativeWidth * _maxScale)));
+	const int height = std::max(1, static_cast<int>(std::ceil(_nativeHeight * _maxScale)));
+	_target = std::make_unique<GL::FrameBuffer>(width, height, format);
+}
+
+} // namespace Donut
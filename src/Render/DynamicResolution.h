@@ -0,0 +1,75 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+namespace Donut
+{
+
+class GpuProfiler;
+
+namespace GL
+{
+class FrameBuffer;
+class ShaderProgram;
+class VertexBinding;
+} // namespace GL
+
+// The 3D scene goes into an offscreen (multisampled) target whose resolution follows the GPU frame time: frames over
+// budget shrink the scale quickly, frames with headroom grow it back slowly, always within [minScale, maxScale] of the
+// window size. The target is allocated once at the largest scale and only its bottom-left corner is drawn to, so a
+// scale change costs nothing. Upscale() stretches that corner over the window before the UI draws at native size.
+class DynamicResolution
+{
+public:
+	DynamicResolution(float targetMs, float minScale, float maxScale, int samples);
+	~DynamicResolution();
+
+	// picks this frame's render size from the newest GPU timings the profiler has resolved
+	void Update(const GpuProfiler& profiler, int nativeWidth, int nativeHeight);
+
+	// binds the offscreen target, the scene then draws to GetRenderWidth() x GetRenderHeight()
+	void BeginScene();
+
+	// resolves the scene and draws it over the whole default framebuffer
+	void Upscale();
+
+	int GetRenderWidth() const { return _renderWidth; }
+	int GetRenderHeight() const { return _renderHeight; }
+	float GetScale() const { return _scale; }
+
+	void SetEnabled(bool enabled) { _enabled = enabled; }
+	bool IsEnabled() const { return _enabled; }
+
+	float GetTargetMs() const { return _targetMs; }
+	void SetTargetMs(float targetMs) { _targetMs = targetMs; }
+
+	float GetMinScale() const { return _minScale; }
+	float GetMaxScale() const { return _maxScale; }
+	void SetScaleBounds(float minScale, float maxScale);
+
+private:
+	void createTarget();
+
+	float _targetMs;
+	float _minScale;
+	float _maxScale;
+	int _samples;
+	bool _enabled;
+
+	float _scale;
+	uint64_t _lastFrameIndex;
+
+	int _nativeWidth;
+	int _nativeHeight;
+	int _renderWidth;
+	int _renderHeight;
+
+	std::unique_ptr<GL::FrameBuffer> _target;
+	std::unique_ptr<GL::ShaderProgram> _upscaleShader;
+	std::unique_ptr<GL::VertexBinding> _emptyBinding; // the full screen triangle comes from gl_VertexID
+};
+
+} // namespace Donut
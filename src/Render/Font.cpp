@@ -14,21 +14,33 @@ Font::Font(P3D::TextureFont& fontP3D)
 
 	for (const auto& texture : fontP3D.GetTextures()) { _textures.push_back(std::make_shared<Texture>(*texture)); }
 
+	// flat table so text layout is an index per character rather than a tree walk
 	for (const auto& glyph : fontP3D.GetGlyphs())
 	{
-		_glyphs.insert({glyph.id, Glyph {glyph.textureId, glyph.bottomLeftX, glyph.bottomLeftY, glyph.topRightX,
-		                                 glyph.topRightY, glyph.leftBearing, glyph.rightBearing, glyph.width, glyph.advance}});
+		const int32_t id = glyph.id;
+		if (id < 0 || id > kMaxCodepoint)
+			continue;
+
+		if (id >= static_cast<int32_t>(_glyphIndex.size()))
+			_glyphIndex.resize(id + 1, kNoGlyph);
+
+		// first one wins on duplicates
+		if (_glyphIndex[id] != kNoGlyph)
+			continue;
+
+		_glyphIndex[id] = static_cast<uint16_t>(_glyphs.size());
+		_glyphs.push_back(Glyph {glyph.textureId, glyph.bottomLeftX, glyph.bottomLeftY, glyph.topRightX, glyph.topRightY,
+		                         glyph.leftBearing, glyph.rightBearing, glyph.width, glyph.advance});
 	}
 }
 
 bool Font::TryGetGlyph(int32_t id, Font::Glyph& glyph) const
 {
-	if (_glyphs.find(id) != _glyphs.end())
-	{
-		glyph = _glyphs.at(id);
-		return true;
-	}
+	const Glyph* found = FindGlyph(id);
+	if (found == nullptr)
+		return false;
 
-	return false;
+	glyph = *found;
+	return true;
 }
 } // namespace Donut
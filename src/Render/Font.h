@@ -2,7 +2,7 @@
 
 #pragma once
 
-#include <map>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -38,9 +38,23 @@ public:
 
 	bool TryGetGlyph(int32_t id, Glyph& glyph) const;
 
+	// nullptr if the font has no glyph for the codepoint
+	const Glyph* FindGlyph(int32_t id) const
+	{
+		if (id < 0 || id >= static_cast<int32_t>(_glyphIndex.size()) || _glyphIndex[id] == kNoGlyph)
+			return nullptr;
+
+		return &_glyphs[_glyphIndex[id]];
+	}
+
 private:
+	// codepoints past the BMP are dropped, none of the game's fonts go that high
+	static constexpr int32_t kMaxCodepoint = 0xFFFF;
+	static constexpr uint16_t kNoGlyph = 0xFFFF;
+
 	float _height;
 	std::vector<std::shared_ptr<Texture>> _textures;
-	std::map<int32_t, Glyph> _glyphs;
+	std::vector<Glyph> _glyphs;
+	std::vector<uint16_t> _glyphIndex; // by codepoint, into _glyphs
 };
 } // namespace Donut
@@ -0,0 +1,327 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include "GpuProfiler.h"
+
+#include "Render/OpenGL/DeletionQueue.h"
+#include "Render/imgui/imgui.h"
+
+#include <SDL.h>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace Donut
+{
+
+static constexpr std::size_t kNoPass = ~std::size_t(0); // pushed past kMaxPasses, popped without a query
+
+static double elapsedMs(uint64_t start, uint64_t end)
+{
+	return (end - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+// same colour for the same pass every frame
+static ImU32 passColor(const char* name)
+{
+	uint32_t hash = 2166136261u;
+	for (const char* c = name; *c != '\0'; ++c) hash = (hash ^ static_cast<uint8_t>(*c)) * 16777619u;
+
+	return ImColor::HSV((hash % 360) / 360.0f, 0.55f, 0.75f);
+}
+
+GpuProfiler::GpuProfiler(): _frameIndex(0), _gpuEpochNs(0), _dropped(0), _enabled(true), _inFrame(false)
+{
+	for (auto& slot : _slots)
+	{
+		glGenQueries((GLsizei)slot.queries.size(), slot.queries.data());
+		slot.frameIndex = 0;
+		slot.cpuStart = 0;
+		slot.cpuMs = 0.0;
+		slot.pending = false;
+	}
+
+	// doesn't wait for the GPU, just reports where its clock is as of the commands issued so far
+	_cpuEpoch = SDL_GetPerformanceCounter();
+	GLint64 gpuNow = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+	_gpuEpochNs = gpuNow;
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	for (auto& slot : _slots)
+	{
+		for (GLuint query : slot.queries) GL::DeletionQueue::Retire(GL::DeletionQueue::Type::Query, query);
+	}
+}
+
+void GpuProfiler::BeginFrame()
+{
+	if (!_enabled)
+		return;
+
+	// this slot was last used kLatency frames ago
+	Slot& slot = current();
+	if (slot.pending)
+		resolve(slot);
+
+	slot.passes.clear();
+	slot.frameIndex = _frameIndex;
+	slot.cpuStart = SDL_GetPerformanceCounter();
+	_stack.clear();
+
+	glQueryCounter(slot.queries[0], GL_TIMESTAMP);
+	_inFrame = true;
+}
+
+void GpuProfiler::EndFrame()
+{
+	if (!_inFrame)
+		return;
+
+	while (!_stack.empty()) Pop();
+
+	Slot& slot = current();
+	glQueryCounter(slot.queries[1], GL_TIMESTAMP);
+	slot.cpuMs = elapsedMs(slot.cpuStart, SDL_GetPerformanceCounter());
+	slot.pending = true;
+
+	_frameIndex++;
+	_inFrame = false;
+}
+
+void GpuProfiler::Push(const char* name)
+{
+	if (!_inFrame)
+		return;
+
+	Slot& slot = current();
+	if (slot.passes.size() >= kMaxPasses)
+	{
+		_stack.push_back(kNoPass);
+		return;
+	}
+
+	const std::size_t index = slot.passes.size();
+	const double now = elapsedMs(slot.cpuStart, SDL_GetPerformanceCounter());
+	slot.passes.push_back(Pass {name, static_cast<int>(_stack.size()), now, now, 0.0, 0.0});
+	_stack.push_back(index);
+
+	glQueryCounter(slot.queries[2 + index * 2], GL_TIMESTAMP);
+}
+
+void GpuProfiler::Pop()
+{
+	if (!_inFrame || _stack.empty())
+		return;
+
+	const std::size_t index = _stack.back();
+	_stack.pop_back();
+	if (index == kNoPass)
+		return;
+
+	Slot& slot = current();
+	glQueryCounter(slot.queries[3 + index * 2], GL_TIMESTAMP);
+	slot.passes[index].cpuEndMs = elapsedMs(slot.cpuStart, SDL_GetPerformanceCounter());
+}
+
+void GpuProfiler::resolve(Slot& slot)
+{
+	slot.pending = false;
+
+	// the frame end is the last query issued for the slot, once it's done the rest are too
+	GLint available = 0;
+	glGetQueryObjectiv(slot.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+	{
+		_dropped++;
+		return;
+	}
+
+	auto result = [&slot](std::size_t query) {
+		GLuint64 value = 0;
+		glGetQueryObjectui64v(slot.queries[query], GL_QUERY_RESULT, &value);
+		return value;
+	};
+
+	const GLuint64 frameBegin = result(0);
+	const GLuint64 frameEnd = result(1);
+
+	Frame frame;
+	frame.index = slot.frameIndex;
+	frame.cpuStartMs = elapsedMs(_cpuEpoch, slot.cpuStart);
+	frame.gpuStartMs = (static_cast<int64_t>(frameBegin) - _gpuEpochNs) / 1000000.0;
+	frame.cpuMs = slot.cpuMs;
+	frame.gpuMs = (frameEnd - frameBegin) / 1000000.0;
+	frame.passes = slot.passes;
+
+	for (std::size_t i = 0; i < frame.passes.size(); ++i)
+	{
+		frame.passes[i].gpuBeginMs = (static_cast<int64_t>(result(2 + i * 2)) - static_cast<int64_t>(frameBegin)) / 1000000.0;
+		frame.passes[i].gpuEndMs = (static_cast<int64_t>(result(3 + i * 2)) - static_cast<int64_t>(frameBegin)) / 1000000.0;
+	}
+
+	_history.push_back(std::move(frame));
+	if (_history.size() > kHistory)
+		_history.pop_front();
+}
+
+bool GpuProfiler::WriteTrace(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file)
+	{
+		fprintf(stderr, "Could not write GPU trace to %s\n", path.c_str());
+		return false;
+	}
+
+	const int cpuTrack = 1, gpuTrack = 2;
+
+	file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+	file << fmt::format("{{\"ph\": \"M\", \"pid\": 0, \"tid\": {0}, \"name\": \"thread_name\", \"args\": {{\"name\": \"CPU\"}}}},\n",
+	                    cpuTrack);
+	file << fmt::format("{{\"ph\": \"M\", \"pid\": 0, \"tid\": {0}, \"name\": \"thread_name\", \"args\": {{\"name\": \"GPU\"}}}}",
+	                    gpuTrack);
+
+	// trace timestamps are in microseconds
+	auto event = [&file](const std::string& name, int track, double startMs, double durationMs) {
+		file << fmt::format(",\n{{\"ph\": \"X\", \"pid\": 0, \"tid\": {0}, \"name\": \"{1}\", \"ts\": {2:.3f}, \"dur\": {3:.3f}}}",
+		                    track, name, startMs * 1000.0, durationMs * 1000.0);
+	};
+
+	for (auto const& frame : _history)
+	{
+		const std::string frameName = fmt::format("Frame {0}", frame.index);
+		event(frameName, cpuTrack, frame.cpuStartMs, frame.cpuMs);
+		event(frameName, gpuTrack, frame.gpuStartMs, frame.gpuMs);
+
+		for (auto const& pass : frame.passes)
+		{
+			event(pass.name, cpuTrack, frame.cpuStartMs + pass.cpuBeginMs, pass.cpuEndMs - pass.cpuBeginMs);
+			event(pass.name, gpuTrack, frame.gpuStartMs + pass.gpuBeginMs, pass.gpuEndMs - pass.gpuBeginMs);
+		}
+	}
+
+	file << "\n]}\n";
+
+	std::cout << fmt::format("Wrote {0} frames of GPU timings to {1}\n", _history.size(), path);
+	return true;
+}
+
+void GpuProfiler::ImGuiDebugWindow(bool* p_open)
+{
+	ImGui::SetNextWindowSize(ImVec2(640, 360), ImGuiCond_FirstUseEver);
+	if (!ImGui::Begin("GPU Profiler", p_open))
+	{
+		ImGui::End();
+		return;
+	}
+
+	ImGui::Checkbox("Enabled", &_enabled);
+	ImGui::SameLine();
+	if (ImGui::Button("Export trace"))
+		WriteTrace("gpu_trace.json");
+
+	const Frame* frame = GetLatest();
+	if (frame == nullptr)
+	{
+		ImGui::Text("Waiting for results...");
+		ImGui::End();
+		return;
+	}
+
+	ImGui::Text("Frame %llu: CPU %.3f ms, GPU %.3f ms, %zu dropped", (unsigned long long)frame->index, frame->cpuMs,
+	            frame->gpuMs, _dropped);
+
+	// timeline, one track for CPU submission and one for GPU execution, nested passes stacked below their parent
+	int depth = 1;
+	double span = std::max(frame->cpuMs, frame->gpuMs);
+	for (auto const& pass : frame->passes)
+	{
+		depth = std::max(depth, pass.depth + 1);
+		span = std::max(span, pass.gpuEndMs);
+	}
+
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	const ImVec2 origin = ImGui::GetCursorScreenPos();
+	const float labelWidth = 40.0f;
+	const float width = std::max(ImGui::GetContentRegionAvail().x - labelWidth, 1.0f);
+	const float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+	const float trackHeight = depth * rowHeight + 4.0f;
+	const float scale = static_cast<float>(width / std::max(span, 0.001));
+
+	for (int track = 0; track < 2; ++track)
+	{
+		const bool gpu = track == 1;
+		const float top = origin.y + track * trackHeight;
+		drawList->AddText(ImVec2(origin.x, top), ImGui::GetColorU32(ImGuiCol_Text), gpu ? "GPU" : "CPU");
+
+		for (auto const& pass : frame->passes)
+		{
+			const double begin = gpu ? pass.gpuBeginMs : pass.cpuBeginMs;
+			const double end = gpu ? pass.gpuEndMs : pass.cpuEndMs;
+
+			const ImVec2 min(origin.x + labelWidth + static_cast<float>(begin) * scale, top + pass.depth * rowHeight);
+			const ImVec2 max(std::max(origin.x + labelWidth + static_cast<float>(end) * scale, min.x + 1.0f),
+			                 min.y + rowHeight - 1.0f);
+
+			drawList->AddRectFilled(min, max, passColor(pass.name));
+			drawList->PushClipRect(min, max, true);
+			drawList->AddText(ImVec2(min.x + 2.0f, min.y), IM_COL32_WHITE, pass.name);
+			drawList->PopClipRect();
+
+			if (ImGui::IsMouseHoveringRect(min, max))
+				ImGui::SetTooltip("%s\nGPU %.3f ms\nCPU %.3f ms", pass.name, pass.gpuEndMs - pass.gpuBeginMs,
+				                  pass.cpuEndMs - pass.cpuBeginMs);
+		}
+	}
+
+	ImGui::Dummy(ImVec2(labelWidth + width, trackHeight * 2.0f));
+	ImGui::Separator();
+
+	// averages over the history, matched by name since a pass can come and go between frames
+	ImGui::Columns(4, "passes");
+	ImGui::Text("Pass");
+	ImGui::NextColumn();
+	ImGui::Text("GPU ms");
+	ImGui::NextColumn();
+	ImGui::Text("GPU avg");
+	ImGui::NextColumn();
+	ImGui::Text("CPU ms");
+	ImGui::NextColumn();
+	ImGui::Separator();
+
+	for (auto const& pass : frame->passes)
+	{
+		double total = 0.0;
+		std::size_t count = 0;
+		for (auto const& past : _history)
+		{
+			for (auto const& other : past.passes)
+			{
+				if (other.depth == pass.depth && std::strcmp(other.name, pass.name) == 0)
+				{
+					total += other.gpuEndMs - other.gpuBeginMs;
+					count++;
+				}
+			}
+		}
+
+		ImGui::Text("%*s%s", pass.depth * 2, "", pass.name);
+		ImGui::NextColumn();
+		ImGui::Text("%.3f", pass.gpuEndMs - pass.gpuBeginMs);
+		ImGui::NextColumn();
+		ImGui::Text("%.3f", count > 0 ? total / count : 0.0);
+		ImGui::NextColumn();
+		ImGui::Text("%.3f", pass.cpuEndMs - pass.cpuBeginMs);
+		ImGui::NextColumn();
+	}
+
+	ImGui::Columns(1);
+	ImGui::End();
+}
+
+} // namespace Donut
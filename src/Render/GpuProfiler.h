@@ -0,0 +1,100 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include "Render/OpenGL/glad/glad.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace Donut
+{
+
+// Per-pass GPU timings from GL_TIMESTAMP queries. Each frame in flight has its own set of queries and results are
+// only read back kLatency frames later; a frame whose queries still aren't done by then is dropped rather than
+// waited on, so the profiler never stalls the pipeline. CPU submit time is recorded for every pass alongside.
+class GpuProfiler
+{
+public:
+	static constexpr std::size_t kLatency = 3;    // frames between issuing queries and reading them
+	static constexpr std::size_t kMaxPasses = 32; // per frame, deeper or later passes aren't timed
+	static constexpr std::size_t kHistory = 300;  // resolved frames kept for averages and export
+
+	struct Pass
+	{
+		const char* name; // must outlive the profiler, string literals
+		int depth;
+		double cpuBeginMs, cpuEndMs; // from the frame's CPU start
+		double gpuBeginMs, gpuEndMs; // from the frame's GPU start
+	};
+
+	struct Frame
+	{
+		uint64_t index;
+		double cpuStartMs; // since the profiler was created
+		double gpuStartMs; // on the same clock, lined up once at creation
+		double cpuMs;
+		double gpuMs;
+		std::vector<Pass> passes;
+	};
+
+	class ScopedPass
+	{
+	public:
+		ScopedPass(GpuProfiler& profiler, const char* name): _profiler(profiler) { _profiler.Push(name); }
+		~ScopedPass() { _profiler.Pop(); }
+
+	private:
+		GpuProfiler& _profiler;
+	};
+
+	GpuProfiler();
+	~GpuProfiler();
+
+	void SetEnabled(bool enabled) { _enabled = enabled; }
+	bool IsEnabled() const { return _enabled; }
+
+	void BeginFrame();
+	void EndFrame();
+
+	void Push(const char* name);
+	void Pop();
+
+	// newest frame with results, nullptr until the first one resolves
+	const Frame* GetLatest() const { return _history.empty() ? nullptr : &_history.back(); }
+
+	// Chrome trace event format (chrome://tracing, Perfetto), CPU and GPU passes on separate tracks
+	bool WriteTrace(const std::string& path) const;
+
+	void ImGuiDebugWindow(bool* p_open);
+
+private:
+	struct Slot
+	{
+		std::array<GLuint, (kMaxPasses + 1) * 2> queries; // [0, 1] the whole frame, then begin/end per pass
+		std::vector<Pass> passes;
+		uint64_t frameIndex;
+		uint64_t cpuStart;
+		double cpuMs;
+		bool pending;
+	};
+
+	void resolve(Slot& slot);
+	Slot& current() { return _slots[_frameIndex % kLatency]; }
+
+	std::array<Slot, kLatency> _slots;
+	std::vector<std::size_t> _stack; // open passes
+	std::deque<Frame> _history;
+	uint64_t _frameIndex;
+	uint64_t _cpuEpoch;
+	int64_t _gpuEpochNs; // GPU timestamp at _cpuEpoch
+	std::size_t _dropped;
+	bool _enabled;
+	bool _inFrame;
+};
+
+} // namespace Donut
@@ -0,0 +1,398 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include "InstancedBatch.h"
+
+#include "Core/File.h"
+#include "Core/Math/Frustum.h"
+#include "Game.h"
+#include "P3D/P3D.generated.h"
+#include "Render/MeshOptimizer.h"
+#include "Render/OpenGL/IndexBuffer.h"
+#include "Render/OpenGL/ShaderProgram.h"
+#include "Render/OpenGL/StateCache.h"
+#include "Render/OpenGL/StorageBuffer.h"
+#include "Render/OpenGL/VertexBinding.h"
+#include "Render/OpenGL/VertexBuffer.h"
+#include "Render/Shader.h"
+#include "Render/ShaderVariants.h"
+#include "Render/TextureStreamer.h"
+#include "Render/UniformBlocks.h"
+#include "ResourceManager.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Donut
+{
+
+// see cull_instances.comp
+enum CullBinding : GLuint
+{
+	CullSpheresBinding = 0,
+	CullInstanceGroupsBinding,
+	CullGroupsBinding,
+	CullCommandRefsBinding,
+	CullCommandsBinding,
+	CullInstanceRefsBinding,
+};
+
+static const GLuint kCullGroupSize = 64;
+
+std::unique_ptr<GL::ShaderProgram> InstancedBatch::CullShader;
+bool InstancedBatch::CullShaderLoaded = false;
+bool InstancedBatch::GpuCulling = true;
+
+InstancedBatch::InstancedBatch() = default;
+
+InstancedBatch::~InstancedBatch() = default;
+
+void InstancedBatch::Add(const P3D::Geometry& geometry, const std::vector<Matrix4x4>& transforms)
+{
+	if (transforms.empty())
+		return;
+
+	const uint32_t firstTransform = static_cast<uint32_t>(_transforms.size());
+	const uint32_t group = static_cast<uint32_t>(_groups.size());
+	_transforms.insert(_transforms.end(), transforms.begin(), transforms.end());
+	_groups.push_back(Group {0, 0});
+	_groupFirstTransform.push_back(firstTransform);
+
+	std::vector<Vertex> vertices;
+	std::vector<MeshOptimizer::PrimGroup> groups;
+
+	for (auto const& prim : geometry.GetPrimitiveGroups())
+	{
+		if (prim->GetVertices().empty() || prim->GetIndices().empty())
+			continue;
+
+		groups.push_back(PackPrimitiveGroup(*prim, vertices));
+	}
+
+	const auto remap = MeshOptimizer::Optimize(groups, vertices.size());
+	vertices = MeshOptimizer::RemapVertices(vertices, remap);
+
+	// every command of this geometry shares one base vertex
+	const GLint baseVertex = static_cast<GLint>(_vertices.size());
+	_vertices.insert(_vertices.end(), vertices.begin(), vertices.end());
+
+	for (auto& primGroup : groups)
+	{
+		DrawCommand command {};
+		command.count = static_cast<GLuint>(primGroup.indices.size());
+		command.instanceCount = static_cast<GLuint>(transforms.size());
+		command.firstIndex = static_cast<GLuint>(_indices.size());
+		command.baseVertex = baseVertex;
+
+		_indices.insert(_indices.end(), primGroup.indices.begin(), primGroup.indices.end());
+
+		_pending[{primGroup.shaderName, primGroup.mode}].push_back(PendingCommand {command, firstTransform, group});
+	}
+
+	Vector3 boundsMin(0.0f), boundsMax(0.0f);
+	if (!vertices.empty())
+		boundsMin = boundsMax = vertices[0].pos;
+
+	for (auto const& vertex : vertices)
+	{
+		boundsMin = Vector3(std::min(boundsMin.X, vertex.pos.X), std::min(boundsMin.Y, vertex.pos.Y),
+		                    std::min(boundsMin.Z, vertex.pos.Z));
+		boundsMax = Vector3(std::max(boundsMax.X, vertex.pos.X), std::max(boundsMax.Y, vertex.pos.Y),
+		                    std::max(boundsMax.Z, vertex.pos.Z));
+	}
+
+	// the box's bounding sphere, moved into world space for each instance
+	const Vector3 centre = (boundsMin + boundsMax) * 0.5f;
+	const float radius = (boundsMax - boundsMin).Length() * 0.5f;
+
+	for (auto const& m : transforms)
+	{
+		float scale = 0.0f;
+		for (int col = 0; col < 3; ++col)
+			scale = std::max(scale, std::sqrt(m.M[col][0] * m.M[col][0] + m.M[col][1] * m.M[col][1] + m.M[col][2] * m.M[col][2]));
+
+		_sphereX.push_back(m.M[0][0] * centre.X + m.M[1][0] * centre.Y + m.M[2][0] * centre.Z + m.M[3][0]);
+		_sphereY.push_back(m.M[0][1] * centre.X + m.M[1][1] * centre.Y + m.M[2][1] * centre.Z + m.M[3][1]);
+		_sphereZ.push_back(m.M[0][2] * centre.X + m.M[1][2] * centre.Y + m.M[2][2] * centre.Z + m.M[3][2]);
+		_sphereRadius.push_back(radius * scale);
+		_instanceGroups.push_back(group);
+	}
+}
+
+void InstancedBatch::Commit()
+{
+	if (_pending.empty())
+		return;
+
+	auto& rm = Game::GetInstance().GetResourceManager();
+
+	std::vector<InstanceRef> instanceRefs;
+	std::vector<std::vector<CommandRef>> groupCommands(_groups.size());
+
+	// commands of one material sit next to each other so a single indirect call covers them
+	for (auto& pending : _pending)
+	{
+		const uint32_t materialIndex = static_cast<uint32_t>(_materials.size());
+
+		Material material {pending.first.first, pending.first.second, rm.GetShader(pending.first.first), _commands.size(),
+		                   pending.second.size()};
+
+		for (auto& pendingCommand : pending.second)
+		{
+			DrawCommand command = pendingCommand.command;
+			command.baseInstance = static_cast<GLuint>(instanceRefs.size());
+
+			for (uint32_t i = 0; i < command.instanceCount; ++i)
+				instanceRefs.push_back(InstanceRef {pendingCommand.firstTransform + i, materialIndex});
+
+			groupCommands[pendingCommand.group].push_back(CommandRef {static_cast<uint32_t>(_commands.size()), materialIndex});
+			_commands.push_back(command);
+		}
+
+		_materials.push_back(std::move(material));
+	}
+
+	_pending.clear();
+
+	for (std::size_t i = 0; i < _groups.size(); ++i)
+	{
+		_groups[i].firstCommandRef = static_cast<uint32_t>(_commandRefs.size());
+		_groups[i].commandRefCount = static_cast<uint32_t>(groupCommands[i].size());
+		_commandRefs.insert(_commandRefs.end(), groupCommands[i].begin(), groupCommands[i].end());
+	}
+
+	_vertexBuffer = std::make_unique<GL::VertexBuffer>(_vertices.data(), _vertices.size(), sizeof(Vertex));
+	// indices are local to each geometry, the commands carry the base vertex
+	_indexBuffer = std::make_unique<GL::IndexBuffer>(_indices, *std::max_element(_indices.begin(), _indices.end()) + 1);
+	_instanceRefBuffer =
+	    std::make_unique<GL::VertexBuffer>(instanceRefs.data(), instanceRefs.size(), sizeof(InstanceRef), GL_DYNAMIC_DRAW);
+
+	_transformBuffer =
+	    std::make_unique<GL::StorageBuffer>(_transforms.data(), _transforms.size() * sizeof(Matrix4x4), GL_STATIC_DRAW);
+	_commandBuffer =
+	    std::make_unique<GL::StorageBuffer>(_commands.data(), _commands.size() * sizeof(DrawCommand), GL_DYNAMIC_DRAW);
+
+	std::vector<DrawCommand> commandTemplate = _commands;
+	for (auto& command : commandTemplate) command.instanceCount = 0;
+
+	std::vector<Vector4> spheres(_sphereX.size());
+	for (std::size_t i = 0; i < spheres.size(); ++i) spheres[i] = Vector4(_sphereX[i], _sphereY[i], _sphereZ[i], _sphereRadius[i]);
+
+	_commandTemplateBuffer = std::make_unique<GL::StorageBuffer>(commandTemplate.data(),
+	                                                             commandTemplate.size() * sizeof(DrawCommand), GL_STATIC_DRAW);
+	_sphereBuffer = std::make_unique<GL::StorageBuffer>(spheres.data(), spheres.size() * sizeof(Vector4), GL_STATIC_DRAW);
+	_instanceGroupBuffer = std::make_unique<GL::StorageBuffer>(_instanceGroups.data(),
+	                                                           _instanceGroups.size() * sizeof(uint32_t), GL_STATIC_DRAW);
+	_groupBuffer = std::make_unique<GL::StorageBuffer>(_groups.data(), _groups.size() * sizeof(Group), GL_STATIC_DRAW);
+	_commandRefBuffer =
+	    std::make_unique<GL::StorageBuffer>(_commandRefs.data(), _commandRefs.size() * sizeof(CommandRef), GL_STATIC_DRAW);
+
+	GL::ArrayElement vertexLayout[] = {
+	    GL::ArrayElement(_vertexBuffer.get(), 0, 3, GL::AE_FLOAT, sizeof(Vertex), offsetof(Vertex, pos)),
+	    GL::ArrayElement(_vertexBuffer.get(), 1, 2, GL::AE_HALF_FLOAT, sizeof(Vertex), offsetof(Vertex, uv)),
+	    GL::ArrayElement(_vertexBuffer.get(), 2, 4, GL::AE_UBYTE_NORM, sizeof(Vertex), offsetof(Vertex, color)),
+	    GL::ArrayElement(_instanceRefBuffer.get(), 3, 2, GL::AE_UINT, sizeof(InstanceRef), 0, 1),
+	};
+
+	_vertexBinding = std::make_unique<GL::VertexBinding>();
+	_vertexBinding->Create(vertexLayout, 4, *_indexBuffer, (GL::ElementType)_indexBuffer->GetType());
+
+	// the GPU has its copy now
+	_vertices.clear();
+	_vertices.shrink_to_fit();
+	_indices.clear();
+	_indices.shrink_to_fit();
+}
+
+void InstancedBatch::Draw(ShaderVariants& shaders, bool opaque)
+{
+	if (_materials.empty())
+		return;
+
+	_vertexBinding->Bind();
+	_transformBuffer->BindBase(GL_SHADER_STORAGE_BUFFER, InstanceTransformsBinding);
+	_commandBuffer->Bind(GL_DRAW_INDIRECT_BUFFER);
+
+	for (auto& material : _materials)
+	{
+		if (material.cacheShader == nullptr)
+			material.cacheShader = Game::GetInstance().GetResourceManager().GetShader(material.shaderName);
+
+		if (material.cacheShader == nullptr)
+			continue;
+
+		bool trans = (!material.cacheShader->IsAlphaTested() && material.cacheShader->IsTranslucent());
+
+		if (trans == opaque)
+			continue;
+
+		if (!opaque)
+		{
+			auto blendMode = material.cacheShader->GetBlendMode();
+
+			if (blendMode == BlendMode::Alpha)
+			{
+				GL::StateCache::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			}
+			else if (blendMode == BlendMode::Additive)
+			{
+				GL::StateCache::BlendFunc(GL_ONE, GL_ONE);
+			}
+		}
+
+		shaders.Get(InstancedFeature | VertexColorFeature | material.cacheShader->GetShaderFeatures()).Bind();
+		material.cacheShader->Bind(0);
+
+		GL::StateCache::CountDraw();
+		glMultiDrawElementsIndirect(material.mode, _indexBuffer->GetType(),
+		                            reinterpret_cast<const void*>(material.firstCommand * sizeof(DrawCommand)),
+		                            static_cast<GLsizei>(material.commandCount), 0);
+	}
+}
+
+void InstancedBatch::Cull(const Frustum& frustum)
+{
+	if (_materials.empty())
+		return;
+
+	if (IsGpuCulling())
+		cullGpu(frustum);
+	else
+		cullCpu(frustum);
+}
+
+void InstancedBatch::RequestTextures(const TextureStreamer& streamer, const Frustum& frustum)
+{
+	if (_materials.empty())
+		return;
+
+	// the CPU cull already knows what's visible, the GPU one never says
+	const std::size_t instanceCount = _transforms.size();
+	if (IsGpuCulling())
+	{
+		_visible.resize(instanceCount);
+		frustum.TestSpheres(_sphereX.data(), _sphereY.data(), _sphereZ.data(), _sphereRadius.data(), instanceCount,
+		                    _visible.data());
+	}
+
+	_groupScreenSizes.assign(_groups.size(), 0.0f);
+	for (std::size_t i = 0; i < instanceCount; ++i)
+	{
+		if (!_visible[i])
+			continue;
+
+		const float size =
+		    streamer.GetScreenSize(BoundingSphere(Vector3(_sphereX[i], _sphereY[i], _sphereZ[i]), _sphereRadius[i]));
+		float& largest = _groupScreenSizes[_instanceGroups[i]];
+		largest = std::max(largest, size);
+	}
+
+	for (std::size_t groupIndex = 0; groupIndex < _groups.size(); ++groupIndex)
+	{
+		if (_groupScreenSizes[groupIndex] <= 0.0f)
+			continue;
+
+		const Group& group = _groups[groupIndex];
+		for (uint32_t r = group.firstCommandRef; r < group.firstCommandRef + group.commandRefCount; ++r)
+		{
+			const Shader* shader = _materials[_commandRefs[r].materialIndex].cacheShader;
+			if (shader != nullptr)
+				streamer.Request(shader->GetDiffuseTexture(), _groupScreenSizes[groupIndex]);
+		}
+	}
+}
+
+void InstancedBatch::cullCpu(const Frustum& frustum)
+{
+	const std::size_t instanceCount = _transforms.size();
+	_visible.resize(instanceCount);
+	frustum.TestSpheres(_sphereX.data(), _sphereY.data(), _sphereZ.data(), _sphereRadius.data(), instanceCount,
+	                    _visible.data());
+
+	_visibleCount = 0;
+	for (uint8_t v : _visible) _visibleCount += v;
+
+	// Rebuild every command's run of references, packed back to back.
+	// Commands keep their slot in the buffer so the per material ranges Draw uses stay valid.
+	_culledRefs.clear();
+	_culledCommands = _commands;
+
+	for (std::size_t groupIndex = 0; groupIndex < _groups.size(); ++groupIndex)
+	{
+		const Group& group = _groups[groupIndex];
+		for (uint32_t r = group.firstCommandRef; r < group.firstCommandRef + group.commandRefCount; ++r)
+		{
+			const CommandRef& ref = _commandRefs[r];
+			DrawCommand& command = _culledCommands[ref.commandIndex];
+			const uint32_t firstTransform = _groupFirstTransform[groupIndex];
+
+			command.baseInstance = static_cast<GLuint>(_culledRefs.size());
+			command.instanceCount = 0;
+
+			for (uint32_t i = 0; i < _commands[ref.commandIndex].instanceCount; ++i)
+			{
+				if (!_visible[firstTransform + i])
+					continue;
+
+				_culledRefs.push_back(InstanceRef {firstTransform + i, ref.materialIndex});
+				command.instanceCount++;
+			}
+		}
+	}
+
+	if (!_culledRefs.empty())
+		_instanceRefBuffer->UpdateBuffer(_culledRefs.data(), 0, _culledRefs.size() * sizeof(InstanceRef));
+
+	_commandBuffer->UpdateBuffer(_culledCommands.data(), 0, _culledCommands.size() * sizeof(DrawCommand));
+}
+
+void InstancedBatch::cullGpu(const Frustum& frustum)
+{
+	GL::ShaderProgram& shader = *getCullShader();
+
+	// start from zero instances in every command, the shader appends the visible ones
+	glBindBuffer(GL_COPY_READ_BUFFER, _commandTemplateBuffer->GetHandle());
+	glBindBuffer(GL_COPY_WRITE_BUFFER, _commandBuffer->GetHandle());
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, _commandBuffer->GetSize());
+
+	shader.Bind();
+	shader.SetUniformValue(shader.GetUniformLocation("frustumPlanes[0]"), Frustum::PlaneCount, frustum.GetPlanes());
+	shader.SetUniformValue(shader.GetUniformLocation("instanceCount"), static_cast<int>(_transforms.size()));
+
+	_sphereBuffer->BindBase(GL_SHADER_STORAGE_BUFFER, CullSpheresBinding);
+	_instanceGroupBuffer->BindBase(GL_SHADER_STORAGE_BUFFER, CullInstanceGroupsBinding);
+	_groupBuffer->BindBase(GL_SHADER_STORAGE_BUFFER, CullGroupsBinding);
+	_commandRefBuffer->BindBase(GL_SHADER_STORAGE_BUFFER, CullCommandRefsBinding);
+	_commandBuffer->BindBase(GL_SHADER_STORAGE_BUFFER, CullCommandsBinding);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CullInstanceRefsBinding, _instanceRefBuffer->GetVBO());
+
+	const GLuint groupCount = static_cast<GLuint>((_transforms.size() + kCullGroupSize - 1) / kCullGroupSize);
+	glDispatchCompute(groupCount, 1, 1);
+
+	// the draw reads the commands and the references as vertex attributes
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+GL::ShaderProgram* InstancedBatch::getCullShader()
+{
+	if (!CullShaderLoaded)
+	{
+		CullShaderLoaded = true;
+
+		const auto cullSrc = File::ReadAll("shaders/cull_instances.comp");
+		CullShader = std::make_unique<GL::ShaderProgram>(cullSrc);
+
+		// no compute, cull on the CPU instead
+		if (!CullShader->IsValid())
+			CullShader.reset();
+	}
+
+	return CullShader.get();
+}
+
+void InstancedBatch::ReleaseShaders()
+{
+	CullShader.reset();
+	CullShaderLoaded = false;
+}
+
+} // namespace Donut
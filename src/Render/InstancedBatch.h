@@ -0,0 +1,177 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include "Core/Math/Matrix4x4.h"
+#include "Core/Math/Vector2.h"
+#include "Core/Math/Vector3.h"
+#include "Core/Math/Vector4.h"
+#include "Render/OpenGL/glad/glad.h"
+#include "Render/VertexPacking.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Donut
+{
+class Frustum;
+class ShaderVariants;
+class TextureStreamer;
+
+namespace GL
+{
+class ShaderProgram;
+class StorageBuffer;
+class VertexBuffer;
+class IndexBuffer;
+class VertexBinding;
+} // namespace GL
+
+namespace P3D
+{
+class Geometry;
+}
+
+class Shader;
+
+// All instanced geometry of a region in shared buffers, submitted with one glMultiDrawElementsIndirect per material.
+// Every primitive group becomes a DrawElementsIndirectCommand whose baseInstance points at its own run of instance
+// references; the vertex shader uses those to fetch the transform and material from SSBOs.
+// Cull() rewrites those runs every frame with only the instances whose bounding sphere touches the frustum, on the GPU
+// with a compute pass when the cull program is available, otherwise on the CPU.
+class InstancedBatch
+{
+public:
+	// layout fixed by GL
+	struct DrawCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// per-instance vertex attribute, see INSTANCED in world.vert
+	struct InstanceRef
+	{
+		uint32_t transformIndex;
+		uint32_t materialIndex;
+	};
+
+	InstancedBatch();
+	~InstancedBatch();
+
+	// CPU side only until Commit
+	void Add(const P3D::Geometry& geometry, const std::vector<Matrix4x4>& transforms);
+	void Commit();
+
+	// binds the INSTANCED variant of each material
+	void Draw(ShaderVariants& shaders, bool opaque);
+
+	// call once per frame before Draw
+	void Cull(const Frustum& frustum);
+
+	// after Cull, asks for material textures to suit the nearest visible instance of each geometry
+	void RequestTextures(const TextureStreamer& streamer, const Frustum& frustum);
+
+	static void SetGpuCulling(bool enabled) { GpuCulling = enabled; }
+	static bool IsGpuCulling() { return GpuCulling && getCullShader() != nullptr; }
+
+	// the shared cull shader, while the context is still there to delete it
+	static void ReleaseShaders();
+
+	bool IsEmpty() const { return _materials.empty(); }
+	std::size_t GetCommandCount() const { return _commands.size(); }
+	std::size_t GetMaterialCount() const { return _materials.size(); }
+	std::size_t GetInstanceCount() const { return _transforms.size(); }
+
+	// only known after a CPU cull, the GPU path never reads its result back
+	std::size_t GetVisibleCount() const { return _visibleCount; }
+
+private:
+	struct Vertex
+	{
+		Vector3 pos;
+		Half2 uv;
+		UByte4 color;
+	};
+
+	struct PendingCommand
+	{
+		DrawCommand command;
+		uint32_t firstTransform;
+		uint32_t group;
+	};
+
+	// one per added geometry, all its commands share the same visible instances
+	struct Group
+	{
+		uint32_t firstCommandRef;
+		uint32_t commandRefCount;
+	};
+
+	struct CommandRef
+	{
+		uint32_t commandIndex;
+		uint32_t materialIndex;
+	};
+
+	struct Material
+	{
+		std::string shaderName;
+		GLenum mode;
+		Shader* cacheShader;
+		std::size_t firstCommand;
+		std::size_t commandCount;
+	};
+
+	void cullCpu(const Frustum& frustum);
+	void cullGpu(const Frustum& frustum);
+
+	static GL::ShaderProgram* getCullShader();
+
+	std::vector<Vertex> _vertices;
+	std::vector<uint32_t> _indices;
+	std::vector<Matrix4x4> _transforms;
+	std::map<std::pair<std::string, GLenum>, std::vector<PendingCommand>> _pending;
+
+	std::vector<Material> _materials;
+	std::vector<DrawCommand> _commands;
+
+	// world space bounding spheres, one per transform, split up for Frustum::TestSpheres
+	std::vector<float> _sphereX, _sphereY, _sphereZ, _sphereRadius;
+	std::vector<uint32_t> _instanceGroups;
+	std::vector<Group> _groups;
+	std::vector<uint32_t> _groupFirstTransform;
+	std::vector<CommandRef> _commandRefs;
+
+	std::vector<uint8_t> _visible;
+	std::vector<float> _groupScreenSizes;
+	std::vector<InstanceRef> _culledRefs;
+	std::vector<DrawCommand> _culledCommands;
+	std::size_t _visibleCount = 0;
+
+	std::unique_ptr<GL::VertexBuffer> _vertexBuffer;
+	std::unique_ptr<GL::IndexBuffer> _indexBuffer;
+	std::unique_ptr<GL::VertexBuffer> _instanceRefBuffer;
+	std::unique_ptr<GL::VertexBinding> _vertexBinding;
+	std::unique_ptr<GL::StorageBuffer> _transformBuffer;
+	std::unique_ptr<GL::StorageBuffer> _commandBuffer;
+
+	// GPU culling inputs
+	std::unique_ptr<GL::StorageBuffer> _commandTemplateBuffer; // _commands with every instanceCount zeroed
+	std::unique_ptr<GL::StorageBuffer> _sphereBuffer;
+	std::unique_ptr<GL::StorageBuffer> _instanceGroupBuffer;
+	std::unique_ptr<GL::StorageBuffer> _groupBuffer;
+	std::unique_ptr<GL::StorageBuffer> _commandRefBuffer;
+
+	static std::unique_ptr<GL::ShaderProgram> CullShader;
+	static bool CullShaderLoaded;
+	static bool GpuCulling;
+};
+
+} // namespace Donut
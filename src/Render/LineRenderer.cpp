@@ -6,15 +6,19 @@
 #include "Core/Math/Quaternion.h"
 #include "Core/Math/Vector3.h"
 #include "Core/Math/Vector4.h"
+#include "Render/OpenGL/StateCache.h"
 #include "Skeleton.h"
 
+#include <algorithm>
+#include <vector>
+
 namespace Donut
 {
 std::string VertSrc = R"glsl(
-	#version 150 core
+	#version 330 core
 
-	in vec3 position;
-	in vec4 color;
+	layout(location = 0) in vec3 position;
+	layout(location = 1) in vec4 color;
 
 	out vec4 vertColor;
 
@@ -27,8 +31,26 @@ std::string VertSrc = R"glsl(
 	}
 )glsl";
 
+std::string ShapeVertSrc = R"glsl(
+	#version 330 core
+
+	layout(location = 0) in vec3 position;
+	layout(location = 1) in vec4 instanceColor;
+	layout(location = 2) in mat4 instanceTransform;
+
+	out vec4 vertColor;
+
+	uniform mat4 viewProj;
+
+	void main()
+	{
+		vertColor = instanceColor;
+		gl_Position = viewProj * instanceTransform * vec4(position, 1.0);
+	}
+)glsl";
+
 std::string FragSrc = R"glsl(
-	#version 150 core
+	#version 330 core
 
 	in vec4 vertColor;
 
@@ -40,59 +62,179 @@ std::string FragSrc = R"glsl(
 	}
 )glsl";
 
-LineRenderer::LineRenderer(size_t maxVertexCount): _maxVertexCount(maxVertexCount), _vertexCount(0)
+// segments in the unit meshes, enough to read as round at debug sizes
+static const int kShapeSegments = 16;
+
+static uint32_t packColour(const Vector4& colour)
+{
+	auto channel = [](float c) { return static_cast<uint32_t>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f); };
+	return channel(colour.X) | (channel(colour.Y) << 8) | (channel(colour.Z) << 16) | (channel(colour.W) << 24);
+}
+
+// scale then translate, the unit meshes are all centred on their origin
+static Matrix4x4 makeTransform(const Vector3& position, const Vector3& scale)
 {
-	_buffer.resize(kVertexSize * _maxVertexCount, 0);
+	return Matrix4x4(scale.X, 0.0f, 0.0f, 0.0f, 0.0f, scale.Y, 0.0f, 0.0f, 0.0f, 0.0f, scale.Z, 0.0f, position.X, position.Y,
+	                 position.Z, 1.0f);
+}
 
-	_vertexBuffer = std::make_unique<GL::VertexBuffer>(nullptr, _maxVertexCount, kVertexSize, GL_DYNAMIC_DRAW);
+LineRenderer::LineRenderer(size_t maxVertexCount, size_t maxShapeCount)
+    : _maxVertexCount(maxVertexCount), _vertexCount(0), _firstVertex(0), _vertices(nullptr), _maxShapeCount(maxShapeCount),
+      _firstInstance(0), _shapeCounts {}, _instances(nullptr)
+{
+	_vertexBuffer = std::make_unique<GL::StreamBuffer>(kVertexSize * _maxVertexCount);
 
 	GL::ArrayElement vertexLayout[] = {
 	    GL::ArrayElement(_vertexBuffer.get(), 0, 3, GL::AE_FLOAT, kVertexSize, 0),
-	    GL::ArrayElement(_vertexBuffer.get(), 1, 4, GL::AE_FLOAT, kVertexSize, 3 * sizeof(float))};
+	    GL::ArrayElement(_vertexBuffer.get(), 1, 4, GL::AE_UBYTE_NORM, kVertexSize, sizeof(Vector3))};
 
 	_vertexBinding = std::make_unique<GL::VertexBinding>();
-	_vertexBinding->Create(vertexLayout, 2, *_vertexBuffer);
+	_vertexBinding->Create(vertexLayout, 2);
 
 	_shader = std::make_unique<GL::ShaderProgram>(VertSrc, FragSrc);
+
+	createShapeMeshes();
+
+	const std::size_t instanceStride = sizeof(ShapeInstance);
+	_instanceBuffer = std::make_unique<GL::StreamBuffer>(instanceStride * _maxShapeCount * ShapeCount);
+
+	// a mat4 attribute is four vec4 columns in consecutive locations
+	GL::ArrayElement shapeLayout[] = {
+	    GL::ArrayElement(_shapeVertexBuffer.get(), 0, 3, GL::AE_FLOAT, sizeof(Vector3), 0),
+	    GL::ArrayElement(_instanceBuffer.get(), 1, 4, GL::AE_UBYTE_NORM, instanceStride, offsetof(ShapeInstance, colour), 1),
+	    GL::ArrayElement(_instanceBuffer.get(), 2, 4, GL::AE_FLOAT, instanceStride, 0, 1),
+	    GL::ArrayElement(_instanceBuffer.get(), 3, 4, GL::AE_FLOAT, instanceStride, 4 * sizeof(float), 1),
+	    GL::ArrayElement(_instanceBuffer.get(), 4, 4, GL::AE_FLOAT, instanceStride, 8 * sizeof(float), 1),
+	    GL::ArrayElement(_instanceBuffer.get(), 5, 4, GL::AE_FLOAT, instanceStride, 12 * sizeof(float), 1)};
+
+	_shapeBinding = std::make_unique<GL::VertexBinding>();
+	_shapeBinding->Create(shapeLayout, 6);
+
+	_shapeShader = std::make_unique<GL::ShaderProgram>(ShapeVertSrc, FragSrc);
+}
+
+void LineRenderer::createShapeMeshes()
+{
+	std::vector<Vector3> vertices;
+
+	auto line = [&vertices](const Vector3& p1, const Vector3& p2) {
+		vertices.push_back(p1);
+		vertices.push_back(p2);
+	};
+
+	auto spherePoint = [](float theta, float phi) {
+		return Vector3(Math::Sin(theta) * Math::Cos(phi), Math::Cos(theta), Math::Sin(theta) * Math::Sin(phi));
+	};
+
+	// radius 1: meridians pole to pole and three parallels
+	_shapeMeshes[ShapeSphere].firstVertex = vertices.size();
+	for (int m = 0; m < kShapeSegments / 2; ++m)
+	{
+		const float phi = Math::Pi2 * m / (kShapeSegments / 2);
+		for (int s = 0; s < kShapeSegments / 2; ++s)
+		{
+			line(spherePoint(Math::Pi * s / (kShapeSegments / 2), phi),
+			     spherePoint(Math::Pi * (s + 1) / (kShapeSegments / 2), phi));
+		}
+	}
+
+	for (int p = 1; p <= 3; ++p)
+	{
+		const float theta = Math::Pi * p / 4;
+		for (int s = 0; s < kShapeSegments; ++s)
+			line(spherePoint(theta, Math::Pi2 * s / kShapeSegments), spherePoint(theta, Math::Pi2 * (s + 1) / kShapeSegments));
+	}
+	_shapeMeshes[ShapeSphere].vertexCount = vertices.size() - _shapeMeshes[ShapeSphere].firstVertex;
+
+	// [-1, 1] on every axis
+	_shapeMeshes[ShapeBox].firstVertex = vertices.size();
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		for (int corner = 0; corner < 4; ++corner)
+		{
+			float a = (corner & 1) ? 1.0f : -1.0f;
+			float b = (corner & 2) ? 1.0f : -1.0f;
+
+			switch (axis)
+			{
+			case 0: line(Vector3(-1.0f, a, b), Vector3(1.0f, a, b)); break;
+			case 1: line(Vector3(a, -1.0f, b), Vector3(a, 1.0f, b)); break;
+			case 2: line(Vector3(a, b, -1.0f), Vector3(a, b, 1.0f)); break;
+			}
+		}
+	}
+	_shapeMeshes[ShapeBox].vertexCount = vertices.size() - _shapeMeshes[ShapeBox].firstVertex;
+
+	// radius 1 base on y = 0, apex at y = 1
+	_shapeMeshes[ShapeCone].firstVertex = vertices.size();
+	const Vector3 apex(0.0f, 1.0f, 0.0f);
+	for (int s = 0; s < kShapeSegments; ++s)
+	{
+		const float r1 = Math::Pi2 * s / kShapeSegments;
+		const float r2 = Math::Pi2 * (s + 1) / kShapeSegments;
+		const Vector3 base(Math::Cos(r1), 0.0f, Math::Sin(r1));
+
+		line(base, Vector3(Math::Cos(r2), 0.0f, Math::Sin(r2)));
+		if (s % 2 == 0)
+			line(base, apex);
+	}
+	_shapeMeshes[ShapeCone].vertexCount = vertices.size() - _shapeMeshes[ShapeCone].firstVertex;
+
+	_shapeVertexBuffer = std::make_unique<GL::VertexBuffer>(vertices.data(), vertices.size(), sizeof(Vector3));
 }
 
 void LineRenderer::Flush(Matrix4x4& viewProj)
 {
-	if (_vertexCount < 2)
-		return;
+	if (_vertexCount >= 2)
+	{
+		_vertexBuffer->Unmap();
+		_vertices = nullptr;
 
-	_vertexBuffer->UpdateBuffer(_buffer.data(), 0, _vertexCount * kVertexSize);
+		_shader->Bind();
+		_shader->SetUniformValue("viewProj", viewProj);
 
-	_shader->Bind();
-	_shader->SetUniformValue("viewProj", viewProj);
+		_vertexBinding->Bind();
+		GL::StateCache::CountDraw();
+		glDrawArrays(GL_LINES, static_cast<GLint>(_firstVertex), static_cast<GLsizei>(_vertexCount));
 
-	_vertexBinding->Bind();
-	glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(_vertexCount));
-	_vertexBinding->Unbind();
+		_vertexCount = 0;
+	}
+
+	if (_instances != nullptr)
+	{
+		_instanceBuffer->Unmap();
+		_instances = nullptr;
+
+		_shapeShader->Bind();
+		_shapeShader->SetUniformValue("viewProj", viewProj);
+
+		_shapeBinding->Bind();
+		for (std::size_t shape = 0; shape < ShapeCount; ++shape)
+		{
+			if (_shapeCounts[shape] == 0)
+				continue;
+
+			const ShapeMesh& mesh = _shapeMeshes[shape];
+			GL::StateCache::CountDraw();
+			glDrawArraysInstancedBaseInstance(GL_LINES, static_cast<GLint>(mesh.firstVertex),
+			                                  static_cast<GLsizei>(mesh.vertexCount), static_cast<GLsizei>(_shapeCounts[shape]),
+			                                  static_cast<GLuint>(_firstInstance + shape * _maxShapeCount));
+		}
 
-	_vertexCount = 0;
+		_shapeCounts.fill(0);
+	}
 }
 
 void LineRenderer::DrawLine(const Vector3& p1, const Vector3& p2, const Vector4& colour)
 {
-	BufferVertex(p1, colour);
-	BufferVertex(p2, colour);
+	const uint32_t packed = packColour(colour);
+	BufferVertex(p1, packed);
+	BufferVertex(p2, packed);
 }
 
-void LineRenderer::DrawBox(const Matrix4x4 transform, const Vector3& mins, const Vector3& maxs, const Vector4& colour)
+void LineRenderer::DrawBox(const Matrix4x4& transform, const Vector3& mins, const Vector3& maxs, const Vector4& colour)
 {
-	// DrawLine(transform * Vector4(mins.X, mins.Y, mins.Z, 1), transform * Vector4(maxs.X, mins.Y, mins.Z, 1), colour);
-	// DrawLine(transform * Vector4(maxs.X, mins.Y, mins.Z, 1), transform * Vector4(maxs.X, maxs.Y, mins.Z, 1), colour);
-	// DrawLine(transform * Vector4(maxs.X, maxs.Y, mins.Z, 1), transform * Vector4(mins.X, maxs.Y, mins.Z, 1), colour);
-	// DrawLine(transform * Vector4(mins.X, maxs.Y, mins.Z, 1), transform * Vector4(mins.X, mins.Y, mins.Z, 1), colour);
-	// DrawLine(transform * Vector4(mins.X, mins.Y, mins.Z, 1), transform * Vector4(mins.X, mins.Y, maxs.Z, 1), colour);
-	// DrawLine(transform * Vector4(maxs.X, mins.Y, mins.Z, 1), transform * Vector4(maxs.X, mins.Y, maxs.Z, 1), colour);
-	// DrawLine(transform * Vector4(maxs.X, maxs.Y, mins.Z, 1), transform * Vector4(maxs.X, maxs.Y, maxs.Z, 1), colour);
-	// DrawLine(transform * Vector4(mins.X, maxs.Y, mins.Z, 1), transform * Vector4(mins.X, maxs.Y, maxs.Z, 1), colour);
-	// DrawLine(transform * Vector4(mins.X, mins.Y, maxs.Z, 1), transform * Vector4(maxs.X, mins.Y, maxs.Z, 1), colour);
-	// DrawLine(transform * Vector4(maxs.X, mins.Y, maxs.Z, 1), transform * Vector4(maxs.X, maxs.Y, maxs.Z, 1), colour);
-	// DrawLine(transform * Vector4(maxs.X, maxs.Y, maxs.Z, 1), transform * Vector4(mins.X, maxs.Y, maxs.Z, 1), colour);
-	// DrawLine(transform * Vector4(mins.X, maxs.Y, maxs.Z, 1), transform * Vector4(mins.X, mins.Y, maxs.Z, 1), colour);
+	BufferShape(ShapeBox, transform * makeTransform((mins + maxs) * 0.5f, (maxs - mins) * 0.5f), colour);
 }
 
 void LineRenderer::DrawAABBox(const Vector3& position, const Vector3& mins, const Vector3& maxs, const Vector4& colour)
@@ -102,147 +244,106 @@ void LineRenderer::DrawAABBox(const Vector3& position, const Vector3& mins, cons
 
 void LineRenderer::DrawAABBox(const Vector3& mins, const Vector3& maxs, const Vector4& colour)
 {
-	DrawLine(Vector3(mins.X, mins.Y, mins.Z), Vector3(maxs.X, mins.Y, mins.Z), colour);
-	DrawLine(Vector3(maxs.X, mins.Y, mins.Z), Vector3(maxs.X, maxs.Y, mins.Z), colour);
-	DrawLine(Vector3(maxs.X, maxs.Y, mins.Z), Vector3(mins.X, maxs.Y, mins.Z), colour);
-	DrawLine(Vector3(mins.X, maxs.Y, mins.Z), Vector3(mins.X, mins.Y, mins.Z), colour);
-	DrawLine(Vector3(mins.X, mins.Y, mins.Z), Vector3(mins.X, mins.Y, maxs.Z), colour);
-	DrawLine(Vector3(maxs.X, mins.Y, mins.Z), Vector3(maxs.X, mins.Y, maxs.Z), colour);
-	DrawLine(Vector3(maxs.X, maxs.Y, mins.Z), Vector3(maxs.X, maxs.Y, maxs.Z), colour);
-	DrawLine(Vector3(mins.X, maxs.Y, mins.Z), Vector3(mins.X, maxs.Y, maxs.Z), colour);
-	DrawLine(Vector3(mins.X, mins.Y, maxs.Z), Vector3(maxs.X, mins.Y, maxs.Z), colour);
-	DrawLine(Vector3(maxs.X, mins.Y, maxs.Z), Vector3(maxs.X, maxs.Y, maxs.Z), colour);
-	DrawLine(Vector3(maxs.X, maxs.Y, maxs.Z), Vector3(mins.X, maxs.Y, maxs.Z), colour);
-	DrawLine(Vector3(mins.X, maxs.Y, maxs.Z), Vector3(mins.X, mins.Y, maxs.Z), colour);
+	BufferShape(ShapeBox, makeTransform((mins + maxs) * 0.5f, (maxs - mins) * 0.5f), colour);
 }
 
 void LineRenderer::DrawBox(const Vector3& position, const Vector3& angles, const Vector3& mins, const Vector3& maxs,
                            const Vector4& colour)
 {
-	// DrawBox(position, Quaternion(Math::DegreesToRadians(angles)), mins, maxs, colour);
+	// pitch, yaw and roll in degrees, applied roll first, then pitch, then yaw
+	const Quaternion rotation = Quaternion(Vector3(0.0f, 1.0f, 0.0f), Math::DegreesToRadians(angles.Y)) *
+	                            Quaternion(Vector3(1.0f, 0.0f, 0.0f), Math::DegreesToRadians(angles.X)) *
+	                            Quaternion(Vector3(0.0f, 0.0f, 1.0f), Math::DegreesToRadians(angles.Z));
+	DrawBox(position, rotation, mins, maxs, colour);
 }
 
 void LineRenderer::DrawBox(const Vector3& position, const Quaternion& angles, const Vector3& mins, const Vector3& maxs,
                            const Vector4& colour)
 {
-	// Matrix4x4 transform = Matrix4x4::MakeTranslate(position) * angles;
-
-	DrawBox(Matrix4x4::Identity, mins, maxs, colour);
+	DrawBox(Matrix4x4::MakeTranslate(position) * Matrix4x4(angles), mins, maxs, colour);
 }
 
-void LineRenderer::DrawSphere(const Vector3& position, float radius, int thetaSegments, int phiSegments, const Vector4& colour)
+void LineRenderer::DrawSphere(const Vector3& position, float radius, const Vector4& colour)
 {
-	int theta = thetaSegments + 1;
-	int phi = phiSegments;
-
-	std::vector<Vector3> vertices;
-	vertices.reserve(phi * theta);
-
-	for (int i = 0; i < phi; ++i)
-	{
-		for (int j = 0; j < theta; ++j)
-		{
-			float u = j / (float)(theta - 1);
-			float v = i / (float)(phi - 1);
-			float t = Math::Pi2 * u;
-			float p = Math::Pi * v;
-
-			Vector3 vertex(radius * sin(p) * cos(t), radius * cos(p), radius * sin(p) * sin(t));
-
-			vertex += position;
-
-			vertices.push_back(vertex);
-		}
-	}
-
-	for (int i = 0; i < phi - 1; ++i)
-	{
-		for (int j = 0; j < theta - 1; ++j)
-		{
-			int index = theta * i + j;
-
-			DrawLine(vertices[index], vertices[index + theta], colour);
-			DrawLine(vertices[index], vertices[index + 1], colour);
-		}
-	}
+	BufferShape(ShapeSphere, makeTransform(position, Vector3(radius)), colour);
 }
 
-void LineRenderer::DrawCone(const Vector3& position, float radius, float height, std::size_t sides, const Vector4& colour)
+void LineRenderer::DrawSphere(const Matrix4x4& transform, float radius, const Vector4& colour)
 {
-	if (sides < 3)
-		return;
-
-	std::vector<Vector3> vertices;
-	vertices.reserve(sides + 1);
-
-	Vector3 topVertex = position + (Vector3(0, 1, 0) * height);
-
-	for (std::size_t i = 0; i <= sides; ++i)
-	{
-		float r = Math::Pi2 * (i / (float)sides);
-		Vector3 vertex(radius * cos(r), 0.0f, radius * sin(r));
-		vertices.push_back(position + vertex);
-	}
+	BufferShape(ShapeSphere, transform * makeTransform(Vector3(0.0f), Vector3(radius)), colour);
+}
 
-	for (std::size_t i = 0; i < sides; ++i)
-	{
-		DrawLine(vertices[i], vertices[i + 1], colour);
-		DrawLine(vertices[i], topVertex, colour);
-	}
+void LineRenderer::DrawCone(const Vector3& position, float radius, float height, const Vector4& colour)
+{
+	BufferShape(ShapeCone, makeTransform(position, Vector3(radius, height, radius)), colour);
 }
 
-void LineRenderer::DrawCone(const Vector3& position, const Quaternion& rotation, float radius, float height, std::size_t sides,
+void LineRenderer::DrawCone(const Vector3& position, const Quaternion& rotation, float radius, float height,
                             const Vector4& colour)
 {
-	if (sides < 3)
-		return;
-
-	std::vector<Vector3> vertices;
-	vertices.reserve(sides + 1);
-
-	Vector3 topVertex = position + (rotation * Vector3(0, height, 0));
-
-	for (std::size_t i = 0; i <= sides; ++i)
-	{
-		float r = Math::Pi2 * (i / (float)sides);
-		Vector3 vertex(radius * cos(r), 0.0f, radius * sin(r));
-		vertices.push_back(position + (rotation * vertex));
-	}
+	DrawCone(Matrix4x4::MakeTranslate(position) * Matrix4x4(rotation), radius, height, colour);
+}
 
-	for (std::size_t i = 0; i < sides; ++i)
-	{
-		DrawLine(vertices[i], vertices[i + 1], colour);
-		DrawLine(vertices[i], topVertex, colour);
-	}
+void LineRenderer::DrawCone(const Matrix4x4& transform, float radius, float height, const Vector4& colour)
+{
+	BufferShape(ShapeCone, transform * makeTransform(Vector3(0.0f), Vector3(radius, height, radius)), colour);
 }
 
-void LineRenderer::DrawSkeleton(const Vector3& position, const Skeleton& skeleton)
+void LineRenderer::DrawSkeleton(const Vector3& position, const Skeleton& skeleton, const std::vector<Matrix4x4>& pose)
 {
 	auto const& joints = skeleton.GetJoints();
-	for (auto const& joint : joints)
-	{
-		auto const& parent = joints[joint.parent];
+	if (pose.size() != joints.size())
+		return;
 
-		Matrix4x4 mParent = Matrix4x4::MakeTranslate(position) * parent.pose;
-		Matrix4x4 mJoint = Matrix4x4::MakeTranslate(position) * joint.pose;
+	for (std::size_t i = 0; i < joints.size(); i++)
+	{
+		Matrix4x4 mParent = Matrix4x4::MakeTranslate(position) * pose[joints[i].parent];
+		Matrix4x4 mJoint = Matrix4x4::MakeTranslate(position) * pose[i];
 
 		const Vector4 lineColor(1.0f, 1.0f, 1.0f, 1.0f);
 		const Vector4 sphereColor(0.0f, 1.0f, 0.0f, 1.0f);
 
-		DrawSphere(mJoint.Translation(), 0.025f, 4, 4, sphereColor);
+		DrawSphere(mJoint.Translation(), 0.025f, sphereColor);
 		DrawLine(mParent.Translation(), mJoint.Translation(), lineColor);
 	}
 }
 
-void LineRenderer::BufferVertex(const Vector3& position, const Vector4& colour)
+void LineRenderer::BufferVertex(const Vector3& position, uint32_t colour)
 {
 	if (_vertexCount >= _maxVertexCount)
 		return;
 
-	uint8_t* vertexData = &_buffer[_vertexCount * kVertexSize];
+	if (_vertices == nullptr)
+	{
+		std::size_t offset;
+		_vertices = static_cast<uint8_t*>(_vertexBuffer->Map(kVertexSize * _maxVertexCount, kVertexSize, offset));
+		_firstVertex = offset / kVertexSize;
+	}
+
+	uint8_t* vertexData = _vertices + _vertexCount * kVertexSize;
 	*(Vector3*)(vertexData) = position;
-	*(Vector4*)(vertexData + sizeof(Vector3)) = colour;
+	*(uint32_t*)(vertexData + sizeof(Vector3)) = colour;
 
 	_vertexCount++;
 }
+
+void LineRenderer::BufferShape(Shape shape, const Matrix4x4& transform, const Vector4& colour)
+{
+	if (_shapeCounts[shape] >= _maxShapeCount)
+		return;
+
+	if (_instances == nullptr)
+	{
+		const std::size_t stride = sizeof(ShapeInstance);
+		std::size_t offset;
+		_instances = static_cast<ShapeInstance*>(_instanceBuffer->Map(stride * _maxShapeCount * ShapeCount, stride, offset));
+		_firstInstance = offset / stride;
+	}
+
+	ShapeInstance& instance = _instances[shape * _maxShapeCount + _shapeCounts[shape]];
+	instance.transform = transform;
+	instance.colour = packColour(colour);
+
+	_shapeCounts[shape]++;
+}
 } // namespace Donut
@@ -3,34 +3,43 @@
 #pragma once
 
 #include "Core/Math/Fwd.h"
+#include "Core/Math/Matrix4x4.h"
 #include "Render/OpenGL/ShaderProgram.h"
+#include "Render/OpenGL/StreamBuffer.h"
 #include "Render/OpenGL/VertexBinding.h"
 #include "Render/OpenGL/VertexBuffer.h"
 
+#include <array>
+#include <memory>
 #include <vector>
 
 namespace Donut
 {
 class Skeleton;
 
+// Debug lines, plus wire spheres, boxes and cones drawn as instances of unit meshes so a shape costs one
+// transform and colour on the CPU instead of dozens of line vertices.
 class LineRenderer
 {
 public:
-	LineRenderer(std::size_t maxVertexCount);
+	LineRenderer(std::size_t maxVertexCount, std::size_t maxShapeCount = 16384);
 
 	void DrawLine(const Vector3& p1, const Vector3& p2, const Vector4& colour);
-	void DrawBox(const Matrix4x4 transform, const Vector3& mins, const Vector3& maxs, const Vector4& colour);
+	void DrawBox(const Matrix4x4& transform, const Vector3& mins, const Vector3& maxs, const Vector4& colour);
 	void DrawBox(const Vector3& position, const Vector3& angles, const Vector3& mins, const Vector3& maxs,
 	             const Vector4& colour);
 	void DrawBox(const Vector3& position, const Quaternion& angles, const Vector3& mins, const Vector3& maxs,
 	             const Vector4& colour);
 	void DrawAABBox(const Vector3& mins, const Vector3& maxs, const Vector4& colour);
 	void DrawAABBox(const Vector3& position, const Vector3& mins, const Vector3& maxs, const Vector4& colour);
-	void DrawSphere(const Vector3& position, float radius, int thetaSegments, int phiSegments, const Vector4& colour);
-	void DrawCone(const Vector3& position, float radius, float height, std::size_t sides, const Vector4& colour);
-	void DrawCone(const Vector3& position, const Quaternion& rotation, float radius, float height, std::size_t sides,
-	              const Vector4& colour);
-	void DrawSkeleton(const Vector3& position, const Skeleton& skeleton);
+	void DrawSphere(const Vector3& position, float radius, const Vector4& colour);
+	void DrawSphere(const Matrix4x4& transform, float radius, const Vector4& colour);
+	// base centred on position, apex at +Y
+	void DrawCone(const Vector3& position, float radius, float height, const Vector4& colour);
+	void DrawCone(const Vector3& position, const Quaternion& rotation, float radius, float height, const Vector4& colour);
+	void DrawCone(const Matrix4x4& transform, float radius, float height, const Vector4& colour);
+	// pose holds each joint's transform, the skeleton only supplies the hierarchy
+	void DrawSkeleton(const Vector3& position, const Skeleton& skeleton, const std::vector<Matrix4x4>& pose);
 
 	void Flush(Matrix4x4& viewProj);
 
@@ -38,15 +47,52 @@ public:
 	std::size_t GetMaxVertexCount() const { return _maxVertexCount; }
 
 private:
-	void BufferVertex(const Vector3& position, const Vector4& colour);
+	enum Shape
+	{
+		ShapeSphere,
+		ShapeBox,
+		ShapeCone,
+		ShapeCount
+	};
+
+	// per-instance attributes, the transform takes the unit mesh to world space
+	struct ShapeInstance
+	{
+		Matrix4x4 transform;
+		uint32_t colour; // RGBA8
+	};
+
+	struct ShapeMesh
+	{
+		std::size_t firstVertex;
+		std::size_t vertexCount;
+	};
+
+	void BufferVertex(const Vector3& position, uint32_t colour);
+	void BufferShape(Shape shape, const Matrix4x4& transform, const Vector4& colour);
+	void createShapeMeshes();
+
+	static inline const std::size_t kVertexSize = 16; // position + RGBA8 colour
 
-	static inline const std::size_t kVertexSize = 28;
 	std::size_t _vertexCount;
 	std::size_t _maxVertexCount;
+	std::size_t _firstVertex;
 
-	std::unique_ptr<GL::VertexBuffer> _vertexBuffer;
+	// vertices go straight into the mapped stream buffer, a whole region per flush
+	std::unique_ptr<GL::StreamBuffer> _vertexBuffer;
 	std::unique_ptr<GL::VertexBinding> _vertexBinding;
-	std::vector<uint8_t> _buffer;
+	uint8_t* _vertices;
 	std::unique_ptr<GL::ShaderProgram> _shader;
+
+	// one range of the instance region per shape, maxShapeCount long
+	std::size_t _maxShapeCount;
+	std::size_t _firstInstance;
+	std::array<std::size_t, ShapeCount> _shapeCounts;
+	std::array<ShapeMesh, ShapeCount> _shapeMeshes;
+	std::unique_ptr<GL::VertexBuffer> _shapeVertexBuffer;
+	std::unique_ptr<GL::StreamBuffer> _instanceBuffer;
+	std::unique_ptr<GL::VertexBinding> _shapeBinding;
+	ShapeInstance* _instances;
+	std::unique_ptr<GL::ShaderProgram> _shapeShader;
 };
 } // namespace Donut
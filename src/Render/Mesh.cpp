@@ -2,8 +2,17 @@
 
 #include <Game.h>
 #include <Render/Mesh.h>
+#include <Render/InstancedBatch.h>
+#include <Render/MeshOptimizer.h>
+#include <Render/OpenGL/StateCache.h>
 #include <Render/Shader.h>
+#include <Render/ShaderVariants.h>
 #include <Render/SkinModel.h>
+#include <Render/TextureStreamer.h>
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
 #include <vector>
 
 namespace Donut
@@ -24,61 +33,70 @@ void Mesh::CreateVertexBinding()
 	static const size_t vertStride = sizeof(Vertex);
 
 	GL::ArrayElement vertexLayout[] = {
-	    GL::ArrayElement(_vertexBuffer.get(), 0, 3, GL::AE_FLOAT, vertStride, 0),
-	    GL::ArrayElement(_vertexBuffer.get(), 1, 2, GL::AE_FLOAT, vertStride, 3 * sizeof(float)),
-	    GL::ArrayElement(_vertexBuffer.get(), 2, 4, GL::AE_FLOAT, vertStride, 5 * sizeof(float)),
+	    GL::ArrayElement(_vertexBuffer.get(), 0, 3, GL::AE_FLOAT, vertStride, offsetof(Vertex, pos)),
+	    GL::ArrayElement(_vertexBuffer.get(), 1, 2, GL::AE_HALF_FLOAT, vertStride, offsetof(Vertex, uv)),
+	    GL::ArrayElement(_vertexBuffer.get(), 2, 4, GL::AE_UBYTE_NORM, vertStride, offsetof(Vertex, color)),
 	};
 
 	_vertexBinding = std::make_shared<GL::VertexBinding>();
-	_vertexBinding->Create(vertexLayout, 3, *_indexBuffer, GL::ElementType::AE_UINT);
+	_vertexBinding->Create(vertexLayout, 3, *_indexBuffer, (GL::ElementType)_indexBuffer->GetType());
 }
 
-void Mesh::CreateMeshBuffers(const P3D::Geometry& geometry)
+std::unique_ptr<GL::VertexBuffer> Mesh::CreateInstanceRefs()
 {
-	std::vector<Vertex> allVerts;
-	std::vector<uint32_t> allIndices;
+	std::vector<InstancedBatch::InstanceRef> refs(CommandList::kMaxInstances);
+	for (uint32_t i = 0; i < refs.size(); i++) refs[i] = InstancedBatch::InstanceRef {i, 0};
 
-	size_t vertOffset = 0;
-	size_t idxOffset = 0;
-	for (auto const& prim : geometry.GetPrimitiveGroups())
-	{
-		auto verts = prim->GetVertices();
-		auto uvs = prim->GetUvs(0);
-		auto colors = prim->GetColors();
-		auto indices = prim->GetIndices();
-		bool hasColors = !colors.empty();
+	return std::make_unique<GL::VertexBuffer>(refs.data(), refs.size(), sizeof(InstancedBatch::InstanceRef));
+}
 
-		for (uint32_t i = 0; i < verts.size(); i++)
-		{
-			allVerts.push_back(Vertex {
-			    verts[i],
-			    Vector2(uvs[i].X, 1.0f - uvs[i].Y),
-			    hasColors ? P3D::P3DUtil::ConvertColor(colors[i]) : Vector4(1.0f, 1.0f, 1.0f, 1.0f),
-			});
-		}
+void Mesh::CommitInstanced()
+{
+	static const size_t vertStride = sizeof(Vertex);
 
-		for (auto const& idx : prim->GetIndices()) { allIndices.push_back(idx + static_cast<uint32_t>(vertOffset)); }
+	GL::ArrayElement vertexLayout[] = {
+	    GL::ArrayElement(_vertexBuffer.get(), 0, 3, GL::AE_FLOAT, vertStride, offsetof(Vertex, pos)),
+	    GL::ArrayElement(_vertexBuffer.get(), 1, 2, GL::AE_HALF_FLOAT, vertStride, offsetof(Vertex, uv)),
+	    GL::ArrayElement(_vertexBuffer.get(), 2, 4, GL::AE_UBYTE_NORM, vertStride, offsetof(Vertex, color)),
+	    GL::ArrayElement(&Game::GetInstance().GetInstanceRefs(), 3, 2, GL::AE_UINT, sizeof(InstancedBatch::InstanceRef), 0, 1),
+	};
 
-		vertOffset += verts.size();
+	_instancedBinding = std::make_shared<GL::VertexBinding>();
+	_instancedBinding->Create(vertexLayout, 4, *_indexBuffer, (GL::ElementType)_indexBuffer->GetType());
+}
 
-		GLenum mode = GL_TRIANGLE_STRIP;
-		switch ((P3D::PrimitiveType)prim->GetPrimType())
-		{
-		case P3D::PrimitiveType::TriangleStrip: mode = GL_TRIANGLE_STRIP; break;
-		case P3D::PrimitiveType::TriangleList: mode = GL_TRIANGLES; break;
-		case P3D::PrimitiveType::LineStrip: mode = GL_LINE_STRIP; break;
-		case P3D::PrimitiveType::LineList: mode = GL_LINES; break;
-		}
+void Mesh::CreateMeshBuffers(const P3D::Geometry& geometry)
+{
+	std::vector<Vertex> allVerts;
+	std::vector<MeshOptimizer::PrimGroup> groups;
+
+	for (auto const& prim : geometry.GetPrimitiveGroups()) groups.push_back(PackPrimitiveGroup(*prim, allVerts));
 
-		_primGroups.emplace_back(PrimGroup {prim->GetShaderName(), mode, idxOffset, indices.size()});
-		idxOffset += indices.size();
+	_boundingBoxMin = Vector3(std::numeric_limits<float>::max());
+	_boundingBoxMax = Vector3(std::numeric_limits<float>::lowest());
+	for (auto const& vertex : allVerts)
+	{
+		_boundingBoxMin = Vector3(std::min(_boundingBoxMin.X, vertex.pos.X), std::min(_boundingBoxMin.Y, vertex.pos.Y),
+		                          std::min(_boundingBoxMin.Z, vertex.pos.Z));
+		_boundingBoxMax = Vector3(std::max(_boundingBoxMax.X, vertex.pos.X), std::max(_boundingBoxMax.Y, vertex.pos.Y),
+		                          std::max(_boundingBoxMax.Z, vertex.pos.Z));
+	}
+
+	const auto remap = MeshOptimizer::Optimize(groups, allVerts.size());
+	allVerts = MeshOptimizer::RemapVertices(allVerts, remap);
+
+	std::vector<uint32_t> allIndices;
+	for (auto& group : groups)
+	{
+		_primGroups.emplace_back(PrimGroup {group.shaderName, group.mode, allIndices.size(), group.indices.size()});
+		allIndices.insert(allIndices.end(), group.indices.begin(), group.indices.end());
 	}
 
 	_vertexBuffer = std::make_shared<GL::VertexBuffer>(allVerts.data(), allVerts.size(), sizeof(Vertex));
-	_indexBuffer = std::make_shared<GL::IndexBuffer>(allIndices.data(), allIndices.size(), GL_UNSIGNED_INT);
+	_indexBuffer = std::make_shared<GL::IndexBuffer>(allIndices, allVerts.size());
 }
 
-void Mesh::Draw(GL::ShaderProgram& shader, bool opaque)
+void Mesh::Draw(ShaderVariants& shaders, bool opaque)
 {
 	_vertexBinding->Bind();
 
@@ -105,60 +123,158 @@ void Mesh::Draw(GL::ShaderProgram& shader, bool opaque)
 
 			if (blendMode == BlendMode::Alpha)
 			{
-				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				GL::StateCache::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 			}
 			else if (blendMode == BlendMode::Additive)
 			{
-				glBlendFunc(GL_ONE, GL_ONE);
+				GL::StateCache::BlendFunc(GL_ONE, GL_ONE);
 			}
 		}
 
-		shader.SetUniformValue("alphaMask", (prim.cacheShader->IsAlphaTested()) ? 0.5f : 0.0f);
+		shaders.Get(VertexColorFeature | prim.cacheShader->GetShaderFeatures()).Bind();
 		prim.cacheShader->Bind(0);
 
 		DrawPrimGroup(prim);
 	}
+}
 
-	_vertexBinding->Unbind();
+void Mesh::ResolveShaders()
+{
+	for (auto& prim : _primGroups)
+	{
+		if (prim.cacheShader == nullptr)
+			prim.cacheShader = Game::GetInstance().GetResourceManager().GetShader(prim.shaderName);
+	}
 }
 
-void Mesh::DrawPrimGroup(const PrimGroup& primGroup)
+void Mesh::RequestTextures(const TextureStreamer& streamer, float screenSize) const
 {
-	glDrawElements(primGroup.type, static_cast<GLsizei>(primGroup.indicesCount), _indexBuffer->GetType(),
-	               reinterpret_cast<void*>(primGroup.indicesOffset * 4));
+	for (const auto& prim : _primGroups)
+	{
+		if (prim.cacheShader != nullptr)
+			streamer.Request(prim.cacheShader->GetDiffuseTexture(), screenSize);
+	}
 }
 
-MeshInstanced::MeshInstanced(const P3D::Geometry& geometry, const std::vector<Matrix4x4>& transforms)
-    : Mesh(geometry), _transforms(std::move(transforms))
+DrawItem Mesh::makeDrawItem(const PrimGroup& prim, uint32_t features, GL::VertexBinding* geometry) const
 {
+	const std::size_t indexSize = GL::IndexBuffer::GetTypeSize(_indexBuffer->GetType());
+	const bool trans = (!prim.cacheShader->IsAlphaTested() && prim.cacheShader->IsTranslucent());
+
+	DrawItem item;
+	item.state.blend = trans;
+	item.state.blendMode = trans ? prim.cacheShader->GetBlendMode() : BlendMode::None;
+	item.features = features;
+	item.material = prim.cacheShader;
+	item.geometry = geometry;
+	item.primitive = prim.type;
+	item.indexType = _indexBuffer->GetType();
+	item.indexCount = prim.indicesCount;
+	item.indexOffset = prim.indicesOffset * indexSize;
+	return item;
 }
 
-void MeshInstanced::CreateVertexBinding()
+void Mesh::Record(CommandList& opaque, CommandList& translucent, const Matrix4x4& model, float depth) const
 {
-	static const size_t vertStride = sizeof(Mesh::Vertex);
-	static const size_t instanceStride = sizeof(Matrix4x4);
+	// each list carries its own copy of the object block, pushed on its first draw
+	CommandList::ObjectHandle opaqueObject = CommandList::kIdentity;
 
-	_instanceBuffer = std::make_shared<GL::VertexBuffer>(_transforms.data(), _transforms.size(), instanceStride);
+	for (auto const& prim : _primGroups)
+	{
+		// not loaded (yet), Draw would have crashed on these
+		if (prim.cacheShader == nullptr)
+			continue;
 
-	GL::ArrayElement vertexLayout[] = {
-	    GL::ArrayElement(_vertexBuffer.get(), 0, 3, GL::AE_FLOAT, vertStride, 0),
-	    GL::ArrayElement(_vertexBuffer.get(), 1, 2, GL::AE_FLOAT, vertStride, 3 * sizeof(float)),
-	    GL::ArrayElement(_vertexBuffer.get(), 2, 4, GL::AE_FLOAT, vertStride, 5 * sizeof(float)),
-
-	    GL::ArrayElement(_instanceBuffer.get(), 3, 4, GL::AE_FLOAT, instanceStride, 0, 1),
-	    GL::ArrayElement(_instanceBuffer.get(), 4, 4, GL::AE_FLOAT, instanceStride, 4 * sizeof(float), 1),
-	    GL::ArrayElement(_instanceBuffer.get(), 5, 4, GL::AE_FLOAT, instanceStride, 8 * sizeof(float), 1),
-	    GL::ArrayElement(_instanceBuffer.get(), 6, 4, GL::AE_FLOAT, instanceStride, 12 * sizeof(float), 1),
-	};
+		const uint32_t features = VertexColorFeature | prim.cacheShader->GetShaderFeatures();
+		DrawItem item = makeDrawItem(prim, features, _vertexBinding.get());
+		if (item.state.blend)
+			continue;
 
-	_vertexBinding = std::make_shared<GL::VertexBinding>();
-	_vertexBinding->Create(vertexLayout, 7, *_indexBuffer, GL::ElementType::AE_UINT);
+		if (opaqueObject == CommandList::kIdentity)
+			opaqueObject = opaque.PushObject(model);
+
+		item.sortKey = CommandList::MakeOpaqueKey(features, prim.cacheShader, item.geometry, depth);
+		item.object = opaqueObject;
+		opaque.Draw(item);
+	}
+
+	recordTranslucent(translucent, model, depth);
+}
+
+void Mesh::recordTranslucent(CommandList& translucent, const Matrix4x4& model, float depth) const
+{
+	CommandList::ObjectHandle object = CommandList::kIdentity;
+
+	for (auto const& prim : _primGroups)
+	{
+		if (prim.cacheShader == nullptr)
+			continue;
+
+		const uint32_t features = VertexColorFeature | prim.cacheShader->GetShaderFeatures();
+		DrawItem item = makeDrawItem(prim, features, _vertexBinding.get());
+		if (!item.state.blend)
+			continue;
+
+		if (object == CommandList::kIdentity)
+			object = translucent.PushObject(model);
+
+		item.sortKey =
+		    CommandList::MakeTranslucentKey(item.state.blendMode, features, prim.cacheShader, item.geometry, depth);
+		item.object = object;
+		translucent.Draw(item);
+	}
+}
+
+void Mesh::RecordInstanced(CommandList& opaque, CommandList& translucent, const Matrix4x4* transforms,
+                           const float* depths, std::size_t count, float depth) const
+{
+	assert(_instancedBinding != nullptr);
+
+	// pushed on the first draw, like Record's object block
+	static constexpr uint32_t kNotPushed = ~0u;
+	uint32_t opaqueFirst = kNotPushed;
+	bool hasTranslucent = false;
+
+	for (auto const& prim : _primGroups)
+	{
+		if (prim.cacheShader == nullptr)
+			continue;
+
+		const uint32_t features = InstancedFeature | VertexColorFeature | prim.cacheShader->GetShaderFeatures();
+		DrawItem item = makeDrawItem(prim, features, _instancedBinding.get());
+		if (item.state.blend)
+		{
+			hasTranslucent = true;
+			continue;
+		}
+
+		if (opaqueFirst == kNotPushed)
+			opaqueFirst = opaque.PushInstances(transforms, count);
+
+		item.object = CommandList::kIdentity;
+		item.instanceCount = static_cast<uint32_t>(count);
+		item.firstInstance = opaqueFirst;
+		item.sortKey = CommandList::MakeOpaqueKey(features, prim.cacheShader, item.geometry, depth);
+		opaque.Draw(item);
+	}
+
+	if (hasTranslucent)
+	{
+		for (std::size_t i = 0; i < count; ++i) recordTranslucent(translucent, transforms[i], depths[i]);
+	}
 }
 
-void MeshInstanced::DrawPrimGroup(const PrimGroup& primGroup)
+BoundingSphere Mesh::GetBoundingSphere() const
 {
-	glDrawElementsInstanced(primGroup.type, static_cast<GLsizei>(primGroup.indicesCount), _indexBuffer->GetType(),
-	                        reinterpret_cast<void*>(primGroup.indicesOffset * 4), (GLsizei)_transforms.size());
+	return BoundingSphere((_boundingBoxMin + _boundingBoxMax) * 0.5f, (_boundingBoxMax - _boundingBoxMin).Length() * 0.5f);
+}
+
+void Mesh::DrawPrimGroup(const PrimGroup& primGroup)
+{
+	const std::size_t indexSize = GL::IndexBuffer::GetTypeSize(_indexBuffer->GetType());
+	GL::StateCache::CountDraw();
+	glDrawElements(primGroup.type, static_cast<GLsizei>(primGroup.indicesCount), _indexBuffer->GetType(),
+	               reinterpret_cast<void*>(primGroup.indicesOffset * indexSize));
 }
 
 } // namespace Donut
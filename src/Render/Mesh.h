@@ -2,13 +2,16 @@
 
 #pragma once
 
+#include "Core/Math/BoundingSphere.h"
 #include "Core/Math/Fwd.h"
 #include "P3D/P3D.generated.h"
+#include "Render/CommandList.h"
 #include "Render/OpenGL/IndexBuffer.h"
 #include "Render/OpenGL/ShaderProgram.h"
 #include "Render/OpenGL/VertexBinding.h"
 #include "Render/OpenGL/VertexBuffer.h"
 #include "Render/SkinAnimation.h"
+#include "Render/VertexPacking.h"
 
 #include <string>
 
@@ -16,6 +19,8 @@ namespace Donut
 {
 
 class Shader;
+class ShaderVariants;
+class TextureStreamer;
 
 class Mesh
 {
@@ -23,7 +28,33 @@ public:
 	Mesh(const P3D::Geometry& geometry);
 
 	void Commit();
-	void Draw(GL::ShaderProgram&, bool opaque);
+	void Draw(ShaderVariants&, bool opaque);
+
+	// a second binding for RecordInstanced, with the per-instance reference the INSTANCED variants read
+	void CommitInstanced();
+
+	// {i, 0} for every instance index a command list can hand out: bound with a divisor of 1, an instanced draw with a
+	// base instance of firstInstance reads the transform at firstInstance + gl_InstanceID. One shared by every
+	// CommitInstanced binding, the game owns it.
+	static std::unique_ptr<GL::VertexBuffer> CreateInstanceRefs();
+
+	// looks up the prim group materials, on the GL thread before anything calls Record
+	void ResolveShaders();
+
+	// adds a draw per prim group to the opaque or translucent list, safe from any thread once resolved
+	void Record(CommandList& opaque, CommandList& translucent, const Matrix4x4& model, float depth) const;
+
+	// the same for count world transforms, needs CommitInstanced: one instanced draw per opaque prim group, keyed by
+	// depth (the nearest); blended ones have to sort back to front per instance, so each instance gets its own draw of
+	// those keyed by its entry in depths
+	void RecordInstanced(CommandList& opaque, CommandList& translucent, const Matrix4x4* transforms, const float* depths,
+	                     std::size_t count, float depth) const;
+
+	// asks for prim group textures to suit screenSize pixels, safe from any thread once resolved
+	void RequestTextures(const TextureStreamer& streamer, float screenSize) const;
+
+	// in model space, around the vertex bounds
+	BoundingSphere GetBoundingSphere() const;
 
 protected:
 	struct PrimGroup
@@ -38,11 +69,13 @@ protected:
 	struct Vertex
 	{
 		Vector3 pos;
-		Vector2 uv;
-		Vector4 co0lor;
+		Half2 uv;
+		UByte4 color;
 	};
 
 	void CreateMeshBuffers(const P3D::Geometry& geometry);
+	DrawItem makeDrawItem(const PrimGroup& prim, uint32_t features, GL::VertexBinding* geometry) const;
+	void recordTranslucent(CommandList& translucent, const Matrix4x4& model, float depth) const;
 	virtual void CreateVertexBinding();
 
 	virtual void DrawPrimGroup(const PrimGroup& primGroup);
@@ -53,23 +86,10 @@ protected:
 	std::shared_ptr<GL::VertexBuffer> _vertexBuffer;
 	std::shared_ptr<GL::IndexBuffer> _indexBuffer;
 	std::shared_ptr<GL::VertexBinding> _vertexBinding;
+	std::shared_ptr<GL::VertexBinding> _instancedBinding;
 
 	Vector3 _boundingBoxMin;
 	Vector3 _boundingBoxMax;
 };
 
-class MeshInstanced: public Mesh
-{
-public:
-	MeshInstanced(const P3D::Geometry& geometry, const std::vector<Matrix4x4>& transforms);
-
-protected:
-	virtual void CreateVertexBinding() override;
-
-	virtual void DrawPrimGroup(const PrimGroup& primGroup) override;
-
-	std::vector<Matrix4x4> _transforms;
-	std::shared_ptr<GL::VertexBuffer> _instanceBuffer;
-};
-
 } // namespace Donut
@@ -0,0 +1,259 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace Donut
+{
+
+MeshOptimizer::Stats MeshOptimizer::_stats;
+
+// Forsyth's scoring, see "Linear-Speed Vertex Cache Optimisation"
+static const float kCacheDecayPower = 1.5f;
+static const float kLastTriScore = 0.75f;
+static const float kValenceBoostScale = 2.0f;
+static const float kValenceBoostPower = 0.5f;
+
+static float vertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+	if (remainingTriangles == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		// the last triangle's vertices score the same whichever order they go in
+		if (cachePosition < 3)
+		{
+			score = kLastTriScore;
+		}
+		else
+		{
+			const float scaler = 1.0f / (MeshOptimizer::kCacheSize - 3);
+			score = std::pow(1.0f - (cachePosition - 3) * scaler, kCacheDecayPower);
+		}
+	}
+
+	// favour vertices with few triangles left so we don't strand lone triangles
+	score += kValenceBoostScale * std::pow(static_cast<float>(remainingTriangles), -kValenceBoostPower);
+	return score;
+}
+
+std::vector<uint32_t> MeshOptimizer::Optimize(std::vector<PrimGroup>& groups, std::size_t vertexCount)
+{
+	_stats.meshes++;
+	_stats.groupsIn += groups.size();
+
+	for (auto& group : groups)
+	{
+		if (group.mode != GL_TRIANGLE_STRIP)
+			continue;
+
+		group.indices = StripToList(group.indices);
+		group.mode = GL_TRIANGLES;
+	}
+
+	// lists can be appended to each other, strips and line strips have to stay separate draws
+	std::vector<PrimGroup> merged;
+	for (auto& group : groups)
+	{
+		if (group.indices.empty())
+			continue;
+
+		const bool list = group.mode == GL_TRIANGLES || group.mode == GL_LINES;
+		if (list && !merged.empty() && merged.back().mode == group.mode && merged.back().shaderName == group.shaderName)
+		{
+			merged.back().indices.insert(merged.back().indices.end(), group.indices.begin(), group.indices.end());
+			continue;
+		}
+
+		merged.push_back(std::move(group));
+	}
+
+	groups = std::move(merged);
+	_stats.groupsOut += groups.size();
+
+	for (auto& group : groups)
+	{
+		if (group.mode != GL_TRIANGLES)
+			continue;
+
+		_stats.triangles += group.indices.size() / 3;
+		_stats.missesIn += CountCacheMisses(group.indices, vertexCount);
+
+		OptimizeVertexCache(group.indices, vertexCount);
+
+		_stats.missesOut += CountCacheMisses(group.indices, vertexCount);
+	}
+
+	return OptimizeVertexFetch(groups, vertexCount);
+}
+
+std::vector<uint32_t> MeshOptimizer::StripToList(const std::vector<uint32_t>& strip)
+{
+	std::vector<uint32_t> list;
+	if (strip.size() < 3)
+		return list;
+
+	list.reserve((strip.size() - 2) * 3);
+	for (std::size_t i = 0; i + 2 < strip.size(); ++i)
+	{
+		const uint32_t a = strip[i], b = strip[i + 1], c = strip[i + 2];
+		if (a == b || b == c || a == c)
+			continue;
+
+		// every odd triangle of a strip is wound the other way
+		if (i & 1)
+			list.insert(list.end(), {b, a, c});
+		else
+			list.insert(list.end(), {a, b, c});
+	}
+
+	return list;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, std::size_t vertexCount)
+{
+	const std::size_t triangleCount = indices.size() / 3;
+	if (triangleCount < 2)
+		return;
+
+	// vertex -> triangle adjacency, each vertex's live triangles sit at the front of its slice
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (std::size_t i = 0; i < triangleCount * 3; ++i) remaining[indices[i]]++;
+
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (std::size_t v = 0; v < vertexCount; ++v) offsets[v + 1] = offsets[v] + remaining[v];
+
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (std::size_t i = 0; i < triangleCount * 3; ++i) adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> score(vertexCount);
+	for (std::size_t v = 0; v < vertexCount; ++v) score[v] = vertexScore(-1, remaining[v]);
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+
+	uint32_t best = 0;
+	for (std::size_t t = 0; t < triangleCount; ++t)
+	{
+		triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+		if (triangleScore[t] > triangleScore[best])
+			best = static_cast<uint32_t>(t);
+	}
+
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+
+	uint32_t cache[kCacheSize + 3];
+	std::size_t cacheCount = 0;
+	std::size_t scan = 0;
+
+	while (output.size() < triangleCount * 3)
+	{
+		const uint32_t* tri = &indices[best * 3];
+		output.insert(output.end(), tri, tri + 3);
+		emitted[best] = true;
+
+		for (int k = 0; k < 3; ++k)
+		{
+			const uint32_t v = tri[k];
+			uint32_t* first = &adjacency[offsets[v]];
+			uint32_t* last = first + remaining[v];
+			std::swap(*std::find(first, last, best), *(last - 1));
+			remaining[v]--;
+		}
+
+		// the new triangle goes to the front, anything pushed past the end falls out
+		uint32_t newCache[kCacheSize + 3];
+		std::size_t newCount = 0;
+		for (int k = 0; k < 3; ++k) newCache[newCount++] = tri[k];
+		for (std::size_t i = 0; i < cacheCount; ++i)
+		{
+			if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2])
+				newCache[newCount++] = cache[i];
+		}
+
+		for (std::size_t i = 0; i < newCount; ++i)
+		{
+			const uint32_t v = newCache[i];
+			cachePosition[v] = i < kCacheSize ? static_cast<int>(i) : -1;
+			score[v] = vertexScore(cachePosition[v], remaining[v]);
+		}
+
+		cacheCount = std::min(newCount, kCacheSize);
+		std::copy(newCache, newCache + cacheCount, cache);
+
+		// only triangles touching the cache changed score, so the best one is among them
+		float bestScore = -1.0f;
+		for (std::size_t i = 0; i < newCount; ++i)
+		{
+			const uint32_t v = newCache[i];
+			for (uint32_t a = offsets[v]; a < offsets[v] + remaining[v]; ++a)
+			{
+				const uint32_t t = adjacency[a];
+				triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+				if (triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					best = t;
+				}
+			}
+		}
+
+		if (bestScore < 0.0f)
+		{
+			// nothing left near the cache, start on the next untouched island
+			while (scan < triangleCount && emitted[scan]) scan++;
+			best = static_cast<uint32_t>(scan);
+		}
+	}
+
+	indices = std::move(output);
+}
+
+std::vector<uint32_t> MeshOptimizer::OptimizeVertexFetch(std::vector<PrimGroup>& groups, std::size_t vertexCount)
+{
+	std::vector<uint32_t> remap(vertexCount, kUnused);
+	uint32_t next = 0;
+
+	for (auto& group : groups)
+	{
+		for (auto& idx : group.indices)
+		{
+			assert(idx < vertexCount);
+			if (remap[idx] == kUnused)
+				remap[idx] = next++;
+
+			idx = remap[idx];
+		}
+	}
+
+	return remap;
+}
+
+std::size_t MeshOptimizer::CountCacheMisses(const std::vector<uint32_t>& indices, std::size_t vertexCount,
+                                            std::size_t cacheSize)
+{
+	// FIFO like the hardware: a hit doesn't refresh the entry
+	std::vector<std::size_t> insertedAt(vertexCount, 0);
+	std::size_t misses = 0;
+
+	for (auto idx : indices)
+	{
+		if (insertedAt[idx] == 0 || misses - insertedAt[idx] + 1 > cacheSize)
+		{
+			misses++;
+			insertedAt[idx] = misses;
+		}
+	}
+
+	return misses;
+}
+
+} // namespace Donut
@@ -0,0 +1,89 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include "Render/OpenGL/glad/glad.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Donut
+{
+
+// Load time clean up of P3D primitive groups: strips become indexed lists, triangles are reordered for the
+// post-transform cache (Forsyth), vertices for fetch order, and neighbouring groups sharing a shader are merged.
+class MeshOptimizer
+{
+public:
+	// FIFO size used for the ACMR figures
+	static constexpr std::size_t kCacheSize = 32;
+
+	struct PrimGroup
+	{
+		std::string shaderName;
+		GLenum mode;
+		std::vector<uint32_t> indices; // into the mesh's whole vertex array
+	};
+
+	struct Stats
+	{
+		std::size_t meshes = 0;
+		std::size_t groupsIn = 0;
+		std::size_t groupsOut = 0;
+		std::size_t triangles = 0;
+		std::size_t missesIn = 0;
+		std::size_t missesOut = 0;
+
+		float GetACMRIn() const { return triangles > 0 ? (float)missesIn / triangles : 0.0f; }
+		float GetACMROut() const { return triangles > 0 ? (float)missesOut / triangles : 0.0f; }
+	};
+
+	// Runs every stage over the groups in place and returns the vertex remap (old -> new, ~0u when a vertex is
+	// no longer referenced); apply it to the vertex array with RemapVertices.
+	static std::vector<uint32_t> Optimize(std::vector<PrimGroup>& groups, std::size_t vertexCount);
+
+	template <typename T>
+	static std::vector<T> RemapVertices(const std::vector<T>& vertices, const std::vector<uint32_t>& remap)
+	{
+		std::vector<uint32_t> order;
+		order.reserve(vertices.size());
+		for (uint32_t i = 0; i < remap.size(); ++i)
+		{
+			if (remap[i] == kUnused)
+				continue;
+			if (remap[i] >= order.size())
+				order.resize(remap[i] + 1);
+			order[remap[i]] = i;
+		}
+
+		std::vector<T> result;
+		result.reserve(order.size());
+		for (auto i : order) result.push_back(vertices[i]);
+
+		return result;
+	}
+
+	// keeps the strip's winding and drops its degenerate (restart) triangles
+	static std::vector<uint32_t> StripToList(const std::vector<uint32_t>& strip);
+
+	static void OptimizeVertexCache(std::vector<uint32_t>& indices, std::size_t vertexCount);
+
+	// renumbers vertices in first use order, returns the old -> new remap
+	static std::vector<uint32_t> OptimizeVertexFetch(std::vector<PrimGroup>& groups, std::size_t vertexCount);
+
+	static std::size_t CountCacheMisses(const std::vector<uint32_t>& indices, std::size_t vertexCount,
+	                                    std::size_t cacheSize = kCacheSize);
+
+	// running totals of every mesh optimized so far
+	static const Stats& GetStats() { return _stats; }
+	static void ResetStats() { _stats = Stats(); }
+
+	static constexpr uint32_t kUnused = ~0u;
+
+private:
+	static Stats _stats;
+};
+
+} // namespace Donut
@@ -0,0 +1,162 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include "MipChain.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DONUT_MIPS_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace Donut
+{
+
+// four of these summed still fit a signed 16 bit lane
+static const uint32_t kLinearMax = 4095;
+
+static const std::array<uint16_t, 256>& srgbToLinear()
+{
+	static const std::array<uint16_t, 256> table = [] {
+		std::array<uint16_t, 256> result;
+		for (std::size_t i = 0; i < result.size(); ++i)
+		{
+			const float c = i / 255.0f;
+			const float linear = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			result[i] = static_cast<uint16_t>(linear * kLinearMax + 0.5f);
+		}
+		return result;
+	}();
+	return table;
+}
+
+static const std::array<uint8_t, kLinearMax + 1>& linearToSrgb()
+{
+	static const std::array<uint8_t, kLinearMax + 1> table = [] {
+		std::array<uint8_t, kLinearMax + 1> result;
+		for (std::size_t i = 0; i < result.size(); ++i)
+		{
+			const float linear = static_cast<float>(i) / kLinearMax;
+			const float c = linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+			result[i] = static_cast<uint8_t>(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+		return result;
+	}();
+	return table;
+}
+
+uint32_t MipChain::CountLevels(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size >>= 1) levels++;
+	return levels;
+}
+
+void MipChain::Build(std::vector<Level>& levels)
+{
+	assert(!levels.empty());
+
+	const uint32_t count = CountLevels(levels[0].width, levels[0].height);
+	if (levels.size() >= count)
+		return;
+
+	std::vector<uint16_t> linear, next;
+	ToLinear(levels.back(), linear);
+
+	while (levels.size() < count)
+	{
+		const uint32_t width = levels.back().width;
+		const uint32_t height = levels.back().height;
+		Downsample(linear, width, height, next);
+
+		Level level {std::max(width / 2, 1u), std::max(height / 2, 1u), {}};
+		FromLinear(next, level);
+		levels.push_back(std::move(level));
+
+		std::swap(linear, next);
+	}
+}
+
+void MipChain::ToLinear(const Level& level, std::vector<uint16_t>& linear)
+{
+	const auto& toLinear = srgbToLinear();
+
+	linear.resize(level.rgba.size());
+	for (std::size_t i = 0; i < level.rgba.size(); i += 4)
+	{
+		linear[i + 0] = toLinear[level.rgba[i + 0]];
+		linear[i + 1] = toLinear[level.rgba[i + 1]];
+		linear[i + 2] = toLinear[level.rgba[i + 2]];
+		linear[i + 3] = static_cast<uint16_t>((level.rgba[i + 3] * kLinearMax + 127) / 255);
+	}
+}
+
+void MipChain::FromLinear(const std::vector<uint16_t>& linear, Level& level)
+{
+	const auto& toSrgb = linearToSrgb();
+
+	level.rgba.resize(linear.size());
+	for (std::size_t i = 0; i < linear.size(); i += 4)
+	{
+		level.rgba[i + 0] = toSrgb[linear[i + 0]];
+		level.rgba[i + 1] = toSrgb[linear[i + 1]];
+		level.rgba[i + 2] = toSrgb[linear[i + 2]];
+		level.rgba[i + 3] = static_cast<uint8_t>((linear[i + 3] * 255 + kLinearMax / 2) / kLinearMax);
+	}
+}
+
+void MipChain::Downsample(const std::vector<uint16_t>& source, uint32_t width, uint32_t height,
+                          std::vector<uint16_t>& dest)
+{
+	assert(source.size() == std::size_t(width) * height * 4);
+
+	const uint32_t destWidth = std::max(width / 2, 1u);
+	const uint32_t destHeight = std::max(height / 2, 1u);
+	dest.resize(std::size_t(destWidth) * destHeight * 4);
+
+	for (uint32_t y = 0; y < destHeight; ++y)
+	{
+		const uint16_t* row0 = &source[std::size_t(std::min(y * 2, height - 1)) * width * 4];
+		const uint16_t* row1 = &source[std::size_t(std::min(y * 2 + 1, height - 1)) * width * 4];
+		uint16_t* out = &dest[std::size_t(y) * destWidth * 4];
+
+		uint32_t x = 0;
+
+#ifdef DONUT_MIPS_SSE
+		// two output pixels from four source pixels of both rows, only where no column needs clamping
+		if (width % 2 == 0)
+		{
+			const __m128i round = _mm_set1_epi16(2);
+			for (; x + 2 <= destWidth; x += 2)
+			{
+				const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+				const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8 + 8));
+				const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+				const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8 + 8));
+
+				// columns summed down both rows, then the left and right column of each 2x2 lined up and added
+				const __m128i first = _mm_add_epi16(a, c);
+				const __m128i second = _mm_add_epi16(b, d);
+				const __m128i left = _mm_unpacklo_epi64(first, second);
+				const __m128i right = _mm_unpackhi_epi64(first, second);
+
+				const __m128i sum = _mm_add_epi16(left, right);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm_srli_epi16(_mm_add_epi16(sum, round), 2));
+			}
+		}
+#endif
+
+		for (; x < destWidth; ++x)
+		{
+			const uint32_t x0 = std::min(x * 2, width - 1) * 4;
+			const uint32_t x1 = std::min(x * 2 + 1, width - 1) * 4;
+			for (uint32_t c = 0; c < 4; ++c)
+				out[x * 4 + c] = static_cast<uint16_t>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+		}
+	}
+}
+
+} // namespace Donut
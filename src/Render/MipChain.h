@@ -0,0 +1,42 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Donut
+{
+
+// Builds RGBA8 mip chains on the CPU, so loads don't lean on glGenerateMipmap and every driver gets the same result.
+// Each level is a 2x2 box filter of the one above it, done in linear light: colour goes through the sRGB curve into
+// 12 bit linear values before it's averaged and back out after, alpha is averaged as stored. Levels are filtered
+// from the previous level's linear values rather than its 8 bit result, so rounding doesn't pile up down the chain.
+// No GL, safe on any thread.
+class MipChain
+{
+public:
+	struct Level
+	{
+		uint32_t width;
+		uint32_t height;
+		std::vector<uint8_t> rgba;
+	};
+
+	// levels in a full chain down to 1x1
+	static uint32_t CountLevels(uint32_t width, uint32_t height);
+
+	// completes the chain after whatever levels are already there (level 0 at least, authored mips after it)
+	static void Build(std::vector<Level>& levels);
+
+	// 16 bit RGBA holding 12 bit linear values, what the filter works on
+	static void ToLinear(const Level& level, std::vector<uint16_t>& linear);
+	static void FromLinear(const std::vector<uint16_t>& linear, Level& level);
+
+	// one level down from width x height linear values, odd sizes clamp at the edge
+	static void Downsample(const std::vector<uint16_t>& source, uint32_t width, uint32_t height,
+	                       std::vector<uint16_t>& dest);
+};
+
+} // namespace Donut
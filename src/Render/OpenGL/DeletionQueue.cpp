@@ -0,0 +1,125 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include "DeletionQueue.h"
+
+#include "Render/OpenGL/StateCache.h"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace Donut::GL
+{
+
+struct Retired
+{
+	uint64_t frame;
+	DeletionQueue::Type type;
+	GLuint handle;
+	GLsync sync; // Type::Sync only, fences aren't named by a GLuint
+};
+
+static std::mutex s_mutex;
+static std::vector<Retired> s_retired; // in retire order, so also in frame order
+static std::atomic<uint64_t> s_frame(DeletionQueue::kLatency);
+
+std::size_t DeletionQueue::_deletedLastFrame = 0;
+
+void DeletionQueue::Retire(Type type, GLuint handle)
+{
+	if (handle == 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_retired.push_back(Retired {s_frame.load(), type, handle, nullptr});
+}
+
+void DeletionQueue::Retire(GLsync sync)
+{
+	if (sync == nullptr)
+		return;
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_retired.push_back(Retired {s_frame.load(), Type::Sync, 0, sync});
+}
+
+void DeletionQueue::Collect()
+{
+	deleteUpTo(s_frame.fetch_add(1) - kLatency);
+}
+
+void DeletionQueue::Flush()
+{
+	deleteUpTo(UINT64_MAX);
+}
+
+std::size_t DeletionQueue::GetPendingCount()
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	return s_retired.size();
+}
+
+void DeletionQueue::deleteUpTo(uint64_t frame)
+{
+	// take the old enough ones out under the lock, the GL calls happen without it
+	std::vector<Retired> expired;
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+
+		std::size_t count = 0;
+		while (count < s_retired.size() && s_retired[count].frame <= frame) count++;
+
+		if (count == 0)
+		{
+			_deletedLastFrame = 0;
+			return;
+		}
+
+		expired.assign(s_retired.begin(), s_retired.begin() + count);
+		s_retired.erase(s_retired.begin(), s_retired.begin() + count);
+	}
+
+	std::array<std::vector<GLuint>, static_cast<std::size_t>(Type::Count)> handles;
+	for (const auto& retired : expired)
+	{
+		if (retired.type == Type::Sync)
+			glDeleteSync(retired.sync);
+		else
+			handles[static_cast<std::size_t>(retired.type)].push_back(retired.handle);
+	}
+
+	const auto& buffers = handles[static_cast<std::size_t>(Type::Buffer)];
+	if (!buffers.empty())
+		glDeleteBuffers(static_cast<GLsizei>(buffers.size()), buffers.data());
+
+	const auto& textures = handles[static_cast<std::size_t>(Type::Texture)];
+	for (GLuint texture : textures) StateCache::OnDeleteTexture(texture);
+	if (!textures.empty())
+		glDeleteTextures(static_cast<GLsizei>(textures.size()), textures.data());
+
+	const auto& vertexArrays = handles[static_cast<std::size_t>(Type::VertexArray)];
+	for (GLuint vao : vertexArrays) StateCache::OnDeleteVertexArray(vao);
+	if (!vertexArrays.empty())
+		glDeleteVertexArrays(static_cast<GLsizei>(vertexArrays.size()), vertexArrays.data());
+
+	const auto& samplers = handles[static_cast<std::size_t>(Type::Sampler)];
+	for (GLuint sampler : samplers) StateCache::OnDeleteSampler(sampler);
+	if (!samplers.empty())
+		glDeleteSamplers(static_cast<GLsizei>(samplers.size()), samplers.data());
+
+	const auto& queries = handles[static_cast<std::size_t>(Type::Query)];
+	if (!queries.empty())
+		glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+
+	// programs have no batched delete
+	for (GLuint program : handles[static_cast<std::size_t>(Type::Program)])
+	{
+		StateCache::OnDeleteProgram(program);
+		glDeleteProgram(program);
+	}
+
+	_deletedLastFrame = expired.size();
+}
+
+} // namespace Donut::GL
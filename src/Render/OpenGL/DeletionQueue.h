@@ -0,0 +1,52 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include "Render/OpenGL/glad/glad.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Donut::GL
+{
+
+// GL objects are retired here instead of deleted on the spot, so releasing a resource is safe from any thread and
+// never costs the driver work mid-frame. Collect() runs once a frame on the GL thread and deletes, in one batch per
+// object kind, everything retired at least kLatency frames earlier.
+class DeletionQueue
+{
+public:
+	static constexpr uint64_t kLatency = 3; // frames a retired object is held, the most the GPU runs behind
+
+	enum class Type
+	{
+		Buffer,
+		Texture,
+		VertexArray,
+		Program,
+		Sampler,
+		Query,
+		Sync,
+		Count
+	};
+
+	// any thread, a zero handle is ignored
+	static void Retire(Type type, GLuint handle);
+	static void Retire(GLsync sync);
+
+	// GL thread, once per frame: deletes what's old enough and starts the next frame
+	static void Collect();
+
+	// GL thread, deletes everything regardless of age (shutdown, context loss)
+	static void Flush();
+
+	static std::size_t GetPendingCount();
+	static std::size_t GetDeletedLastFrame() { return _deletedLastFrame; }
+
+private:
+	static void deleteUpTo(uint64_t frame);
+
+	static std::size_t _deletedLastFrame;
+};
+
+} // namespace Donut::GL
@@ -1,6 +1,7 @@
 // Copyright 2019-2020 the donut authors. See AUTHORS.md
 
 #include "FrameBuffer.h"
+#include "StateCache.h"
 
 #include <iostream>
 
@@ -21,8 +22,8 @@ FrameBuffer::Format::Format()
 }
 
 FrameBuffer::FrameBuffer(int width, int height, const Format& format)
-    : _handle(0), _resolveHandle(0), _width(width), _height(height), _format(format), _depthRenderBuffer(NULL),
-      _multisampleDepthRenderBuffer(NULL)
+    : _handle(0), _resolveHandle(0), _width(width), _height(height), _format(format), _depthTextureHandle(0),
+      _depthRenderBuffer(NULL), _multisampleDepthRenderBuffer(NULL)
 {
 	Load();
 }
@@ -45,14 +46,14 @@ void FrameBuffer::Load()
 	{
 		GLuint textureHandle;
 		glGenTextures(1, &textureHandle);
-		glBindTexture(_format._target, textureHandle);
+		StateCache::BindTexture(_format._target, textureHandle);
 		glTexImage2D(_format._target, 0, _format._colourInternalFormat, _width, _height, 0, _format._colourFormat,
 		             _format._colourType, NULL);
 		glTexParameteri(_format._target, GL_TEXTURE_WRAP_S, _format._wrapS);
 		glTexParameteri(_format._target, GL_TEXTURE_WRAP_T, _format._wrapT);
 		glTexParameteri(_format._target, GL_TEXTURE_MIN_FILTER, _format._filterMin);
 		glTexParameteri(_format._target, GL_TEXTURE_MAG_FILTER, _format._filterMag);
-		glBindTexture(_format._target, 0);
+		StateCache::BindTexture(_format._target, 0);
 		_colourTextureHandles.push_back(textureHandle);
 	}
 
@@ -83,7 +84,7 @@ void FrameBuffer::Load()
 			if (_format._depthBufferAsTexture)
 			{
 				glGenTextures(1, &_depthTextureHandle);
-				glBindTexture(_format._target, _depthTextureHandle);
+				StateCache::BindTexture(_format._target, _depthTextureHandle);
 				glTexImage2D(_format._target, 0, _format._depthInternalFormat, _width, _height, 0, GL_DEPTH_COMPONENT, GL_FLOAT,
 				             NULL);
 
@@ -93,7 +94,7 @@ void FrameBuffer::Load()
 				glTexParameteri(_format._target, GL_TEXTURE_MAG_FILTER, _format._filterMag);
 
 				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, _format._target, _depthTextureHandle, 0);
-				glBindTexture(_format._target, 0);
+				StateCache::BindTexture(_format._target, 0);
 			}
 			else
 			{
@@ -126,12 +127,14 @@ void FrameBuffer::Unload()
 
 	if (!_colourTextureHandles.empty())
 	{
+		for (GLuint handle : _colourTextureHandles) StateCache::OnDeleteTexture(handle);
 		glDeleteTextures((GLsizei)_colourTextureHandles.size(), &_colourTextureHandles[0]);
 		_colourTextureHandles.clear();
 	}
 
 	if (_depthTextureHandle)
 	{
+		StateCache::OnDeleteTexture(_depthTextureHandle);
 		glDeleteTextures(1, &_depthTextureHandle);
 		_depthTextureHandle = 0;
 	}
@@ -170,14 +173,14 @@ bool FrameBuffer::LoadMultisample()
 	if (_format._depthBufferAsTexture)
 	{
 		glGenTextures(1, &_depthTextureHandle);
-		glBindTexture(_format._target, _depthTextureHandle);
+		StateCache::BindTexture(_format._target, _depthTextureHandle);
 		glTexImage2D(_format._target, 0, _format._depthInternalFormat, _width, _height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
 		glTexParameteri(_format._target, GL_TEXTURE_WRAP_S, _format._wrapS);
 		glTexParameteri(_format._target, GL_TEXTURE_WRAP_T, _format._wrapT);
 		glTexParameteri(_format._target, GL_TEXTURE_MIN_FILTER, _format._filterMin);
 		glTexParameteri(_format._target, GL_TEXTURE_MAG_FILTER, _format._filterMag);
 		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, _format._target, _depthTextureHandle, 0);
-		glBindTexture(_format._target, 0);
+		StateCache::BindTexture(_format._target, 0);
 	}
 
 	if (!drawBuffers.empty())
@@ -227,6 +230,11 @@ void FrameBuffer::ResolveTextures()
 		return;
 	}
 
+	Resolve(_width, _height);
+}
+
+void FrameBuffer::Resolve(int width, int height)
+{
 	if (_resolveHandle)
 	{
 		BindingState bindingState;
@@ -243,18 +251,12 @@ void FrameBuffer::ResolveTextures()
 			glDrawBuffer(colourAttachment);
 			glReadBuffer(colourAttachment);
 
-			GLbitfield bitfield = GL_COLOR_BUFFER_BIT;
-
-			if (_depthTextureHandle)
-			{
-				bitfield |= GL_DEPTH_BUFFER_BIT;
-			}
-
-			glBlitFramebuffer(0, 0, _width, _height, 0, 0, _width, _height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+			glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
 
+			// depth can only be blitted with nearest filtering
 			if (_depthTextureHandle)
 			{
-				glBlitFramebuffer(0, 0, _width, _height, 0, 0, _width, _height, GL_DEPTH_BUFFER_BIT, GL_LINEAR);
+				glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
 			}
 
 			drawBuffers.push_back(colourAttachment);
@@ -276,7 +278,7 @@ void FrameBuffer::UpdateMipmaps(bool bindFirst, int attachment) const
 
 	if (bindFirst)
 	{
-		glBindTexture(_format._target, _colourTextureHandles[attachment]);
+		StateCache::BindTexture(_format._target, _colourTextureHandles[attachment]);
 	}
 
 	glGenerateMipmap(_format._target);
@@ -383,14 +385,14 @@ void FrameBuffer::BindColorTexture(int attachment)
 
 	ResolveTextures();
 
-	glBindTexture(_format._target, _colourTextureHandles[attachment]);
+	StateCache::BindTexture(_format._target, _colourTextureHandles[attachment]);
 
 	UpdateMipmaps(false, attachment);
 }
 
 void FrameBuffer::BindDepthTexture()
 {
-	glBindTexture(_format._target, _depthTextureHandle);
+	StateCache::BindTexture(_format._target, _depthTextureHandle);
 }
 
 void FrameBuffer::Unbind()
@@ -85,6 +85,9 @@ public:
 
 	void SetSize(int width, int height);
 
+	// resolves only the bottom-left width x height of a multisampled buffer, for when just that much was drawn to
+	void Resolve(int width, int height);
+
 	inline GLuint GetHandle() const { return _handle; }
 	inline GLuint GetResolveHandle() const { return _resolveHandle; }
 	inline GLint GetWidth() const { return _width; }
@@ -1,5 +1,6 @@
 // Copyright 2019-2020 the donut authors. See AUTHORS.md
 
+#include <Render/OpenGL/DeletionQueue.h>
 #include <Render/OpenGL/GLTexture2D.h>
 
 namespace Donut::GL
@@ -11,15 +12,14 @@ GLTexture2D::GLTexture2D(GLsizei width, GLsizei height, GLenum internalFormat, G
 {
 	glGenTextures(1, &_textureID);
 
-	glBindTexture(GL_TEXTURE_2D, _textureID);
+	StateCache::BindTexture(GL_TEXTURE_2D, _textureID);
 	glTexImage2D(GL_TEXTURE_2D, 0, _internalFormat, _width, _height, 0, _format, _type, textureData);
 	glGenerateMipmap(GL_TEXTURE_2D);
 }
 
 GLTexture2D::~GLTexture2D()
 {
-	if (_textureID != 0)
-		glDeleteTextures(1, &_textureID);
+	DeletionQueue::Retire(DeletionQueue::Type::Texture, _textureID);
 }
 
 } // namespace Donut::GL
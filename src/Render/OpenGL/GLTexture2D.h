@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include "Render/OpenGL/StateCache.h"
 #include "Render/OpenGL/glad/glad.h"
 
 namespace Donut::GL
@@ -14,13 +15,9 @@ public:
 	GLTexture2D(GLsizei width, GLsizei height, GLenum internalFormat, GLenum format, GLenum type, const void* textureData);
 	~GLTexture2D();
 
-	inline void Bind() const { glBindTexture(GL_TEXTURE_2D, _textureID); }
+	inline void Bind() const { StateCache::BindTexture(GL_TEXTURE_2D, _textureID); }
 
-	inline void Bind(unsigned char slot) const
-	{
-		glActiveTexture(GL_TEXTURE0 + slot);
-		glBindTexture(GL_TEXTURE_2D, _textureID);
-	}
+	inline void Bind(unsigned char slot) const { StateCache::BindTexture(slot, GL_TEXTURE_2D, _textureID); }
 
 	const GLuint GetHandle() const { return _textureID; }
 	const GLsizei GetWidth() const { return _width; }
@@ -0,0 +1,189 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include "HeadlessContext.h"
+
+#include "Render/OpenGL/glad/glad.h"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#ifdef DONUT_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace Donut::GL
+{
+
+#ifdef DONUT_HAS_EGL
+
+static bool hasExtension(const char* extensions, const char* name)
+{
+	if (extensions == nullptr)
+		return false;
+
+	const std::size_t length = std::strlen(name);
+	for (const char* found = std::strstr(extensions, name); found != nullptr; found = std::strstr(found + length, name))
+	{
+		const bool startsWord = found == extensions || found[-1] == ' ';
+		const bool endsWord = found[length] == ' ' || found[length] == '\0';
+		if (startsWord && endsWord)
+			return true;
+	}
+
+	return false;
+}
+
+HeadlessContext::HeadlessContext(int width, int height)
+    : _display(EGL_NO_DISPLAY), _surface(EGL_NO_SURFACE), _context(EGL_NO_CONTEXT)
+{
+	std::clog << "Initializing headless EGL context..." << std::endl;
+
+	// a throwing constructor never reaches the destructor, this lets go of what's been created by then instead
+	struct Cleanup
+	{
+		HeadlessContext* context;
+		~Cleanup()
+		{
+			if (context != nullptr)
+				context->destroy();
+		}
+	} cleanup {this};
+
+	EGLDisplay display = EGL_NO_DISPLAY;
+
+	// surfaceless needs neither a window system nor a GPU
+	const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+	{
+		auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (getPlatformDisplay != nullptr)
+			display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	}
+
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major = 0, minor = 0;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+		throw std::runtime_error("Could not initialize an EGL display.");
+
+	_display = display;
+
+	std::clog << "EGL Version " << major << "." << minor << std::endl;
+
+	if (!eglBindAPI(EGL_OPENGL_API))
+		throw std::runtime_error("EGL display doesn't support desktop OpenGL.");
+
+	const bool surfaceless = hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+
+	// a zero surface type mask matches every config, surfaceless doesn't need any
+	const EGLint configAttribs[] = {
+	    EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+	    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+	    EGL_RED_SIZE, 8,
+	    EGL_GREEN_SIZE, 8,
+	    EGL_BLUE_SIZE, 8,
+	    EGL_DEPTH_SIZE, 24,
+	    EGL_NONE,
+	};
+
+	EGLConfig config = nullptr;
+	EGLint configCount = 0;
+	if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0)
+		throw std::runtime_error("No suitable EGL config found.");
+
+	// same as the window: 4.3 core with debug output
+	const EGLint contextAttribs[] = {
+	    EGL_CONTEXT_MAJOR_VERSION_KHR, 4,
+	    EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+	    EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+	    EGL_CONTEXT_FLAGS_KHR, EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR,
+	    EGL_NONE,
+	};
+
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+	if (context == EGL_NO_CONTEXT)
+		throw std::runtime_error("Failed to create an OpenGL 4.3 core EGL context.");
+
+	_context = context;
+
+	EGLSurface surface = EGL_NO_SURFACE;
+	if (!surfaceless)
+	{
+		const EGLint surfaceAttribs[] = {EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE};
+		surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+		if (surface == EGL_NO_SURFACE)
+			throw std::runtime_error("Failed to create an EGL pbuffer surface.");
+
+		_surface = surface;
+	}
+
+	if (!eglMakeCurrent(display, surface, surface, context))
+		throw std::runtime_error("Failed to make the EGL context current.");
+
+	// Load GL extensions using glad
+	if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+		throw std::runtime_error("Failed to initialize the OpenGL context.");
+
+	std::cout << "OpenGL version loaded: " << GLVersion.major << "." << GLVersion.minor << "\n"
+	          << "Vendor: " << glGetString(GL_VENDOR) << "\n"
+	          << "Renderer: " << glGetString(GL_RENDERER) << "\n"
+	          << "Version: " << glGetString(GL_VERSION) << "\n"
+	          << std::endl;
+
+	if (!GLAD_GL_VERSION_4_3)
+		throw std::runtime_error("Your OpenGL version is too low, expected 4.3 or higher.");
+
+	cleanup.context = nullptr;
+}
+
+HeadlessContext::~HeadlessContext()
+{
+	destroy();
+}
+
+void HeadlessContext::destroy()
+{
+	if (_display == EGL_NO_DISPLAY)
+		return;
+
+	eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+	if (_surface != EGL_NO_SURFACE)
+		eglDestroySurface(_display, _surface);
+
+	if (_context != EGL_NO_CONTEXT)
+		eglDestroyContext(_display, _context);
+
+	eglTerminate(_display);
+
+	_display = EGL_NO_DISPLAY;
+	_surface = EGL_NO_SURFACE;
+	_context = EGL_NO_CONTEXT;
+}
+
+bool HeadlessContext::IsSupported()
+{
+	return true;
+}
+
+#else
+
+HeadlessContext::HeadlessContext(int width, int height): _display(nullptr), _surface(nullptr), _context(nullptr)
+{
+	throw std::runtime_error("Headless rendering needs EGL, which this build doesn't have.");
+}
+
+HeadlessContext::~HeadlessContext() {}
+
+bool HeadlessContext::IsSupported()
+{
+	return false;
+}
+
+#endif
+
+} // namespace Donut::GL
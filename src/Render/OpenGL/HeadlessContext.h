@@ -0,0 +1,33 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+namespace Donut::GL
+{
+
+// A GL 4.3 core context with no window, for benchmarking on machines without a display. Uses EGL's surfaceless
+// platform where it exists (Mesa, including llvmpipe) and falls back to a pbuffer on the default display. There's
+// no default framebuffer worth drawing to, render into a GL::FrameBuffer.
+class HeadlessContext
+{
+public:
+	HeadlessContext(int width, int height);
+	~HeadlessContext();
+
+	HeadlessContext(const HeadlessContext&) = delete;
+	HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+	// false when the build has no EGL
+	static bool IsSupported();
+
+private:
+	// releases whatever of the context has been created so far
+	void destroy();
+
+	// EGL handles, kept opaque so including this doesn't pull in the EGL headers
+	void* _display;
+	void* _surface;
+	void* _context;
+};
+
+} // namespace Donut::GL
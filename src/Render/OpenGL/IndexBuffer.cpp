@@ -1,6 +1,8 @@
 // Copyright 2019-2020 the donut authors. See AUTHORS.md
 
+#include <Render/OpenGL/DeletionQueue.h>
 #include <Render/OpenGL/IndexBuffer.h>
+#include <Render/OpenGL/StateCache.h>
 #include <cassert>
 
 namespace Donut::GL
@@ -9,21 +11,26 @@ namespace Donut::GL
 IndexBuffer::IndexBuffer(const void* indices, std::size_t indicesCount, GLenum type)
     : _count(indicesCount), _type(type), _ibo(0), _hint(GL_STATIC_DRAW)
 {
-	assert(indices != nullptr);
-	assert(indicesCount > 0);
-
-	glGenBuffers(1, &_ibo);
-	if (glGetError() != GL_NO_ERROR)
-		return;
+	create(indices);
+}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, _count * GetTypeSize(_type), indices, _hint);
+IndexBuffer::IndexBuffer(const std::vector<uint32_t>& indices, std::size_t vertexCount)
+    : _count(indices.size()), _type(GetIndexType(vertexCount)), _ibo(0), _hint(GL_STATIC_DRAW)
+{
+	if (_type == GL_UNSIGNED_SHORT)
+	{
+		const std::vector<uint16_t> narrow(indices.begin(), indices.end());
+		create(narrow.data());
+	}
+	else
+	{
+		create(indices.data());
+	}
 }
 
 IndexBuffer::~IndexBuffer()
 {
-	if (_ibo != 0)
-		glDeleteBuffers(1, &_ibo);
+	DeletionQueue::Retire(DeletionQueue::Type::Buffer, _ibo);
 }
 
 std::size_t IndexBuffer::GetCount() const
@@ -46,6 +53,27 @@ GLuint IndexBuffer::GetIBO() const
 	return _ibo;
 }
 
+void IndexBuffer::create(const void* indices)
+{
+	assert(indices != nullptr);
+	assert(_count > 0);
+
+	glGenBuffers(1, &_ibo);
+	if (glGetError() != GL_NO_ERROR)
+		return;
+
+	// the element binding is VAO state, don't clobber whichever one the draw paths left bound
+	StateCache::BindVertexArray(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, _count * GetTypeSize(_type), indices, _hint);
+}
+
+GLenum IndexBuffer::GetIndexType(std::size_t vertexCount)
+{
+	// 0xFFFF stays free for a primitive restart index
+	return vertexCount < 0xFFFF ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
 std::size_t IndexBuffer::GetTypeSize(GLenum type)
 {
 	switch (type)
@@ -7,6 +7,7 @@
 #include <cstdio>
 #include <memory>
 #include <stdint.h>
+#include <vector>
 
 namespace Donut::GL
 {
@@ -19,6 +20,9 @@ public:
 	IndexBuffer(IndexBuffer&&) = default;
 
 	IndexBuffer(const void* indices, std::size_t indicesCount, GLenum type);
+
+	// narrows to 16-bit indices when the vertices they address fit
+	IndexBuffer(const std::vector<uint32_t>& indices, std::size_t vertexCount);
 	~IndexBuffer();
 
 	std::size_t GetCount() const;
@@ -26,14 +30,17 @@ public:
 	GLenum GetType() const;
 	GLuint GetIBO() const;
 
+	static GLenum GetIndexType(std::size_t vertexCount);
+	static std::size_t GetTypeSize(GLenum type);
+
 private:
+	void create(const void* indices);
+
 	std::size_t _count;
 	GLenum _type;
 
 	GLuint _ibo;
 	GLuint _hint;
-
-	static std::size_t GetTypeSize(GLenum type);
 };
 
 } // namespace Donut::GL
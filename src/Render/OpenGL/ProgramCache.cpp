@@ -0,0 +1,156 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include "ProgramCache.h"
+
+#include "Core/FileSystem.h"
+
+#include <fmt/format.h>
+
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+namespace Donut::GL
+{
+
+std::string ProgramCache::_directory = "shadercache";
+ProgramCache::Stats ProgramCache::_stats;
+int ProgramCache::_available = -1;
+
+static constexpr uint32_t kMagic = 0x42475044; // "DPGB"
+static constexpr uint32_t kVersion = 1;
+
+struct CacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint32_t format;
+	uint32_t length;
+};
+
+// FNV-1a, with a separator after each part so moving text between shaders changes the key
+static void hash(uint64_t& h, const void* data, std::size_t length)
+{
+	const auto* bytes = static_cast<const uint8_t*>(data);
+	for (std::size_t i = 0; i < length; ++i) h = (h ^ bytes[i]) * 1099511628211ull;
+}
+
+static void hashPart(uint64_t& h, std::string_view part)
+{
+	hash(h, part.data(), part.size());
+	hash(h, "\0", 1);
+}
+
+bool ProgramCache::IsAvailable()
+{
+	if (_directory.empty())
+		return false;
+
+	if (_available < 0)
+	{
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		_available = formats > 0 ? 1 : 0;
+	}
+
+	return _available != 0;
+}
+
+uint64_t ProgramCache::MakeKey(std::initializer_list<std::pair<GLenum, std::string_view>> shaders)
+{
+	uint64_t h = 14695981039346656037ull;
+
+	for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+	{
+		const auto* str = reinterpret_cast<const char*>(glGetString(name));
+		hashPart(h, str != nullptr ? str : "");
+	}
+
+	for (auto const& shader : shaders)
+	{
+		hash(h, &shader.first, sizeof(shader.first));
+		hashPart(h, shader.second);
+	}
+
+	return h;
+}
+
+std::string ProgramCache::pathFor(uint64_t key)
+{
+	return fmt::format("{0}/{1:016x}.bin", _directory, key);
+}
+
+GLuint ProgramCache::Load(uint64_t key)
+{
+	if (!IsAvailable())
+		return 0;
+
+	std::ifstream file(pathFor(key), std::ios::binary);
+	CacheHeader header {};
+	if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != kMagic ||
+	    header.version != kVersion || header.key != key)
+	{
+		_stats.misses++;
+		return 0;
+	}
+
+	std::vector<char> binary(header.length);
+	if (!file.read(binary.data(), binary.size()))
+	{
+		_stats.misses++;
+		return 0;
+	}
+
+	const GLuint program = glCreateProgram();
+	glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+
+	GLint linkStatus = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+	if (linkStatus == GL_FALSE)
+	{
+		glDeleteProgram(program);
+		_stats.rejected++;
+		return 0;
+	}
+
+	_stats.hits++;
+	return program;
+}
+
+void ProgramCache::Store(uint64_t key, GLuint program)
+{
+	if (!IsAvailable())
+		return;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+
+	std::error_code error;
+	FileSystem::create_directories(_directory, error);
+
+	// write then rename, so a crash or a second instance never leaves half a binary behind
+	const std::string path = pathFor(key);
+	const std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		const CacheHeader header {kMagic, kVersion, key, format, static_cast<uint32_t>(length)};
+		if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header)) || !file.write(binary.data(), length))
+		{
+			std::fprintf(stderr, "Could not write program binary to %s\n", tempPath.c_str());
+			return;
+		}
+	}
+
+	FileSystem::rename(tempPath, path, error);
+	if (error)
+		std::fprintf(stderr, "Could not write program binary to %s: %s\n", path.c_str(), error.message().c_str());
+}
+
+} // namespace Donut::GL
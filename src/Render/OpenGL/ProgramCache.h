@@ -0,0 +1,56 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include "Render/OpenGL/glad/glad.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace Donut::GL
+{
+
+// On-disk cache of linked program binaries (glGetProgramBinary/glProgramBinary), used by ShaderProgram.
+// Entries are keyed by a hash of every shader source and the GL vendor, renderer and version strings, so a
+// driver update or a shader edit simply misses. The driver can still reject a binary it wrote itself, in which
+// case the caller compiles from source as if nothing was cached.
+class ProgramCache
+{
+public:
+	struct Stats
+	{
+		std::size_t hits = 0;
+		std::size_t misses = 0;
+		std::size_t rejected = 0; // found on disk but the driver refused it
+	};
+
+	// empty disables the cache
+	static void SetDirectory(const std::string& directory) { _directory = directory; }
+
+	// false when the cache is disabled or the driver has no binary formats
+	static bool IsAvailable();
+
+	// stage type and source of each shader, in attach order
+	static uint64_t MakeKey(std::initializer_list<std::pair<GLenum, std::string_view>> shaders);
+
+	// a new linked program, 0 on a miss or if the driver rejected the binary
+	static GLuint Load(uint64_t key);
+
+	// call after a successful link; the program must have been linked with the retrievable hint set
+	static void Store(uint64_t key, GLuint program);
+
+	static const Stats& GetStats() { return _stats; }
+
+private:
+	static std::string pathFor(uint64_t key);
+
+	static std::string _directory;
+	static Stats _stats;
+	static int _available; // -1 until first asked
+};
+
+} // namespace Donut::GL
@@ -1,6 +1,9 @@
 // Copyright 2019-2020 the donut authors. See AUTHORS.md
 
 #include "ShaderProgram.h"
+#include "DeletionQueue.h"
+#include "ProgramCache.h"
+#include "StateCache.h"
 
 #include "Core/Math/Matrix3x3.h"
 #include "Core/Math/Matrix4x4.h"
@@ -13,119 +16,238 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <string_view>
 
 namespace Donut::GL
 {
 
-ShaderProgram::ShaderProgram(const std::string& vertexSource, const std::string& fragmentSource)
+ShaderProgram::ShaderProgram(const std::string& vertexSource, const std::string& fragmentSource): _program(0)
 {
-	_program = glCreateProgram();
+	const uint64_t cacheKey = ProgramCache::MakeKey({{GL_VERTEX_SHADER, vertexSource}, {GL_FRAGMENT_SHADER, fragmentSource}});
+	if (loadCached(cacheKey))
+		return;
 
-	// lazy assert, todo: better error handling
-	assert(_program != 0);
+	const GLuint shaders[] = {
+	    createSubShader(GL_VERTEX_SHADER, vertexSource.c_str()),
+	    createSubShader(GL_FRAGMENT_SHADER, fragmentSource.c_str()),
+	};
 
-	GLuint vertexShader = createSubShader(GL_VERTEX_SHADER, vertexSource.c_str());
-	GLuint fragmentShader = createSubShader(GL_FRAGMENT_SHADER, fragmentSource.c_str());
+	link(shaders, 2, cacheKey);
+}
 
-	// lazy assert, todo: better error handling
-	assert(vertexShader != 0 && fragmentShader != 0);
+ShaderProgram::ShaderProgram(const std::string& computeSource): _program(0)
+{
+	const uint64_t cacheKey = ProgramCache::MakeKey({{GL_COMPUTE_SHADER, computeSource}});
+	if (loadCached(cacheKey))
+		return;
 
-	glAttachShader(_program, vertexShader);
-	glAttachShader(_program, fragmentShader);
-	glLinkProgram(_program);
+	const GLuint shaders[] = {createSubShader(GL_COMPUTE_SHADER, computeSource.c_str())};
 
-	GLint linkStatus = GL_FALSE;
-	glGetProgramiv(_program, GL_LINK_STATUS, &linkStatus);
+	link(shaders, 1, cacheKey);
+}
 
-	if (linkStatus == GL_FALSE)
-	{
-		GLint infoLogLen = 0;
-		glGetShaderiv(_program, GL_INFO_LOG_LENGTH, &infoLogLen);
+ShaderProgram::~ShaderProgram()
+{
+	DeletionQueue::Retire(DeletionQueue::Type::Program, _program);
+}
 
-		char* infoLog = new char[infoLogLen];
-		glGetProgramInfoLog(_program, infoLogLen, &infoLogLen, infoLog);
-		std::fprintf(stderr, "ShaderProgram linking errors:\n%s\n", infoLog); // throw an exception?
-		delete[] infoLog;
+void ShaderProgram::Bind()
+{
+	StateCache::UseProgram(_program);
+}
 
-		glDeleteProgram(_program);
-		glDeleteShader(vertexShader);
-		glDeleteShader(fragmentShader);
+void ShaderProgram::Unbind()
+{
+	StateCache::UseProgram(0);
+}
 
-		return;
-	}
+GLint ShaderProgram::GetUniformLocation(const char* uniformName) const
+{
+	// std::less<> lets us search without building a std::string
+	const auto it = _uniforms.find(std::string_view(uniformName));
+	return it != _uniforms.end() ? it->second : -1;
+}
 
-	// we can delete these now they exist in the program
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+bool ShaderProgram::BindUniformBlock(const char* blockName, GLuint binding)
+{
+	const GLuint index = glGetUniformBlockIndex(_program, blockName);
+	if (index == GL_INVALID_INDEX)
+		return false;
 
-	int uniformCount = -1;
-	glGetProgramiv(_program, GL_ACTIVE_UNIFORMS, &uniformCount);
-	for (int i = 0; i < uniformCount; i++)
-	{
-		int name_len = -1, num = -1;
-		GLenum type = GL_ZERO;
-		char name[64];
-		glGetActiveUniform(_program, GLuint(i), sizeof(name) - 1, &name_len, &num, &type, name);
-		name[name_len] = 0;
+	glUniformBlockBinding(_program, index, binding);
+	return true;
+}
 
-		_uniforms[std::string(name)] = glGetUniformLocation(_program, name);
-	}
+void ShaderProgram::SetUniformValue(GLint location, int value)
+{
+	glUniform1i(location, value);
 }
 
-ShaderProgram::~ShaderProgram()
+void ShaderProgram::SetUniformValue(GLint location, float value)
 {
-	if (_program != 0)
-		glDeleteProgram(_program);
+	glUniform1f(location, value);
 }
 
-void ShaderProgram::Bind()
+void ShaderProgram::SetUniformValue(GLint location, const Vector2& v)
 {
-	glUseProgram(_program);
+	glUniform2fv(location, 1, &v.X);
 }
 
-void ShaderProgram::Unbind()
+void ShaderProgram::SetUniformValue(GLint location, const Vector3& v)
+{
+	glUniform3fv(location, 1, v.Data());
+}
+
+void ShaderProgram::SetUniformValue(GLint location, const Vector4& v)
 {
-	glUseProgram(0);
+	glUniform4fv(location, 1, &v.X);
+}
+
+void ShaderProgram::SetUniformValue(GLint location, const Matrix3x3& m)
+{
+	glUniformMatrix3fv(location, 1, GL_FALSE, &m.M[0][0]);
+}
+
+void ShaderProgram::SetUniformValue(GLint location, const Matrix4x4& m)
+{
+	glUniformMatrix4fv(location, 1, GL_FALSE, m.M16);
+}
+
+void ShaderProgram::SetUniformValue(GLint location, std::size_t count, const Matrix4x4* m)
+{
+	glUniformMatrix4fv(location, (GLsizei)count, GL_FALSE, &m[0].M[0][0]);
+}
+
+void ShaderProgram::SetUniformValue(GLint location, std::size_t count, const Vector4* v)
+{
+	glUniform4fv(location, (GLsizei)count, &v[0].X);
 }
 
 void ShaderProgram::SetUniformValue(const char* uniformName, int value)
 {
-	glUniform1i(_uniforms[uniformName], value);
+	SetUniformValue(GetUniformLocation(uniformName), value);
 }
 
 void ShaderProgram::SetUniformValue(const char* uniformName, float value)
 {
-	glUniform1f(_uniforms[uniformName], value);
+	SetUniformValue(GetUniformLocation(uniformName), value);
 }
 
 void ShaderProgram::SetUniformValue(const char* uniformName, const Vector2& v)
 {
-	glUniform2fv(_uniforms[uniformName], 1, &v.X);
+	SetUniformValue(GetUniformLocation(uniformName), v);
 }
 
 void ShaderProgram::SetUniformValue(const char* uniformName, const Vector3& v)
 {
-	glUniform3fv(_uniforms[uniformName], 1, v.Data());
+	SetUniformValue(GetUniformLocation(uniformName), v);
 }
 
 void ShaderProgram::SetUniformValue(const char* uniformName, const Vector4& v)
 {
-	glUniform4fv(_uniforms[uniformName], 1, &v.X);
+	SetUniformValue(GetUniformLocation(uniformName), v);
 }
 
 void ShaderProgram::SetUniformValue(const char* uniformName, const Matrix3x3& m)
 {
-	glUniformMatrix3fv(_uniforms[uniformName], 1, GL_FALSE, &m.M[0][0]);
+	SetUniformValue(GetUniformLocation(uniformName), m);
 }
 
 void ShaderProgram::SetUniformValue(const char* uniformName, const Matrix4x4& m)
 {
-	glUniformMatrix4fv(_uniforms[uniformName], 1, GL_FALSE, m.M16);
+	SetUniformValue(GetUniformLocation(uniformName), m);
 }
 
 void ShaderProgram::SetUniformValue(const char* uniformName, std::size_t count, const Matrix4x4* m)
 {
-	glUniformMatrix4fv(_uniforms[uniformName], (GLsizei)count, GL_FALSE, &m[0].M[0][0]);
+	SetUniformValue(GetUniformLocation(uniformName), count, m);
+}
+
+bool ShaderProgram::loadCached(uint64_t cacheKey)
+{
+	_program = ProgramCache::Load(cacheKey);
+	if (_program == 0)
+		return false;
+
+	queryUniforms();
+	return true;
+}
+
+void ShaderProgram::link(const GLuint* shaders, std::size_t shaderCount, uint64_t cacheKey)
+{
+	_program = glCreateProgram();
+
+	// lazy assert, todo: better error handling
+	assert(_program != 0);
+
+	const bool cacheable = ProgramCache::IsAvailable();
+	if (cacheable)
+		glProgramParameteri(_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+	bool compiled = true;
+	for (std::size_t i = 0; i < shaderCount; ++i)
+	{
+		if (shaders[i] == 0)
+			compiled = false;
+		else
+			glAttachShader(_program, shaders[i]);
+	}
+
+	GLint linkStatus = GL_FALSE;
+	if (compiled)
+	{
+		glLinkProgram(_program);
+		glGetProgramiv(_program, GL_LINK_STATUS, &linkStatus);
+	}
+
+	if (linkStatus == GL_FALSE)
+	{
+		if (compiled)
+		{
+			GLint infoLogLen = 0;
+			glGetProgramiv(_program, GL_INFO_LOG_LENGTH, &infoLogLen);
+
+			char* infoLog = new char[infoLogLen];
+			glGetProgramInfoLog(_program, infoLogLen, &infoLogLen, infoLog);
+			std::fprintf(stderr, "ShaderProgram linking errors:\n%s\n", infoLog); // throw an exception?
+			delete[] infoLog;
+		}
+
+		glDeleteProgram(_program);
+		_program = 0;
+
+		for (std::size_t i = 0; i < shaderCount; ++i)
+		{
+			if (shaders[i] != 0)
+				glDeleteShader(shaders[i]);
+		}
+
+		return;
+	}
+
+	// we can delete these now they exist in the program
+	for (std::size_t i = 0; i < shaderCount; ++i) glDeleteShader(shaders[i]);
+
+	if (cacheable)
+		ProgramCache::Store(cacheKey, _program);
+
+	queryUniforms();
+}
+
+void ShaderProgram::queryUniforms()
+{
+	int uniformCount = -1;
+	glGetProgramiv(_program, GL_ACTIVE_UNIFORMS, &uniformCount);
+	for (int i = 0; i < uniformCount; i++)
+	{
+		int name_len = -1, num = -1;
+		GLenum type = GL_ZERO;
+		char name[64];
+		glGetActiveUniform(_program, GLuint(i), sizeof(name) - 1, &name_len, &num, &type, name);
+		name[name_len] = 0;
+
+		_uniforms[std::string(name)] = glGetUniformLocation(_program, name);
+	}
 }
 
 GLuint ShaderProgram::createSubShader(GLenum type, const std::string& source)
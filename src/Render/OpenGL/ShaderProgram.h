@@ -5,6 +5,9 @@
 #include "Core/Math/Fwd.h"
 #include "Render/OpenGL/glad/glad.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <map>
 #include <string>
 
@@ -16,11 +19,29 @@ class ShaderProgram
 public:
 	ShaderProgram() = delete;
 	ShaderProgram(const std::string& vertexSource, const std::string& fragmentSource);
+	explicit ShaderProgram(const std::string& computeSource);
 	~ShaderProgram();
 
 	void Bind();
 	void Unbind();
 
+	// -1 when the program has no such active uniform, which glUniform* silently ignores.
+	// Look these up once and keep them; the name overloads below do a map walk per call.
+	GLint GetUniformLocation(const char* uniformName) const;
+
+	// returns false if the program doesn't declare the block
+	bool BindUniformBlock(const char* blockName, GLuint binding);
+
+	void SetUniformValue(GLint location, int value);
+	void SetUniformValue(GLint location, float value);
+	void SetUniformValue(GLint location, const Vector2& v);
+	void SetUniformValue(GLint location, const Vector3& v);
+	void SetUniformValue(GLint location, const Vector4& v);
+	void SetUniformValue(GLint location, const Matrix3x3& m);
+	void SetUniformValue(GLint location, const Matrix4x4& m);
+	void SetUniformValue(GLint location, std::size_t count, const Matrix4x4* m);
+	void SetUniformValue(GLint location, std::size_t count, const Vector4* v);
+
 	void SetUniformValue(const char* uniformName, int value);
 	void SetUniformValue(const char* uniformName, float value);
 	void SetUniformValue(const char* uniformName, const Vector2& v);
@@ -32,10 +53,16 @@ public:
 
 	GLuint GetRawHandle() const { return _program; }
 
+	// false if compiling or linking failed, the errors went to stderr
+	bool IsValid() const { return _program != 0; }
+
 private:
 	GLuint _program;
-	std::map<std::string, GLint> _uniforms;
+	std::map<std::string, GLint, std::less<>> _uniforms;
 
+	bool loadCached(uint64_t cacheKey);
+	void link(const GLuint* shaders, std::size_t shaderCount, uint64_t cacheKey);
+	void queryUniforms();
 	GLuint createSubShader(GLenum type, const std::string& source);
 };
 
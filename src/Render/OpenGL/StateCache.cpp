@@ -0,0 +1,226 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include "StateCache.h"
+
+#include <cassert>
+
+namespace Donut::GL
+{
+
+GLuint StateCache::_program = StateCache::kUnknown;
+GLuint StateCache::_vao = StateCache::kUnknown;
+GLuint StateCache::_activeUnit = StateCache::kUnknown;
+GLuint StateCache::_textures[kMaxTextureUnits][TargetCount];
+GLuint StateCache::_samplers[kMaxTextureUnits];
+GLenum StateCache::_blendSrc = StateCache::kUnknown;
+GLenum StateCache::_blendDst = StateCache::kUnknown;
+GLenum StateCache::_cullMode = StateCache::kUnknown;
+StateCache::Toggle StateCache::_blend = Toggle::Unknown;
+StateCache::Toggle StateCache::_depthTest = Toggle::Unknown;
+StateCache::Toggle StateCache::_depthMask = Toggle::Unknown;
+StateCache::Toggle StateCache::_cullFace = Toggle::Unknown;
+StateCache::Stats StateCache::_stats;
+
+// static arrays can't take a braced initialiser of kUnknown, so fill them up front
+static const bool s_initialised = (StateCache::Invalidate(), true);
+
+void StateCache::UseProgram(GLuint program)
+{
+	if (filter(_program == program))
+		return;
+
+	_program = program;
+	glUseProgram(program);
+}
+
+void StateCache::BindVertexArray(GLuint vao)
+{
+	if (filter(_vao == vao))
+		return;
+
+	_vao = vao;
+	glBindVertexArray(vao);
+}
+
+void StateCache::ActiveTexture(GLuint unit)
+{
+	if (filter(_activeUnit == unit))
+		return;
+
+	_activeUnit = unit;
+	glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void StateCache::BindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	const int index = targetIndex(target);
+	if (index < 0 || unit >= kMaxTextureUnits)
+	{
+		// not something we shadow, pass it straight through
+		ActiveTexture(unit);
+		_stats.issued++;
+		glBindTexture(target, texture);
+		return;
+	}
+
+	if (filter(_textures[unit][index] == texture))
+		return;
+
+	ActiveTexture(unit);
+	_textures[unit][index] = texture;
+	glBindTexture(target, texture);
+}
+
+void StateCache::BindTexture(GLenum target, GLuint texture)
+{
+	if (_activeUnit == kUnknown)
+		ActiveTexture(0);
+
+	BindTexture(_activeUnit, target, texture);
+}
+
+void StateCache::BindSampler(GLuint unit, GLuint sampler)
+{
+	assert(unit < kMaxTextureUnits);
+
+	if (filter(_samplers[unit] == sampler))
+		return;
+
+	_samplers[unit] = sampler;
+	glBindSampler(unit, sampler);
+}
+
+void StateCache::SetBlend(bool enabled)
+{
+	setToggle(_blend, GL_BLEND, enabled);
+}
+
+void StateCache::BlendFunc(GLenum src, GLenum dst)
+{
+	if (filter(_blendSrc == src && _blendDst == dst))
+		return;
+
+	_blendSrc = src;
+	_blendDst = dst;
+	glBlendFunc(src, dst);
+}
+
+void StateCache::SetDepthTest(bool enabled)
+{
+	setToggle(_depthTest, GL_DEPTH_TEST, enabled);
+}
+
+void StateCache::DepthMask(bool write)
+{
+	const Toggle value = write ? Toggle::On : Toggle::Off;
+	if (filter(_depthMask == value))
+		return;
+
+	_depthMask = value;
+	glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+void StateCache::SetCullFace(bool enabled)
+{
+	setToggle(_cullFace, GL_CULL_FACE, enabled);
+}
+
+void StateCache::CullFace(GLenum mode)
+{
+	if (filter(_cullMode == mode))
+		return;
+
+	_cullMode = mode;
+	glCullFace(mode);
+}
+
+void StateCache::OnDeleteProgram(GLuint program)
+{
+	// GL falls back to program 0 when the bound one is deleted
+	if (_program == program)
+		_program = kUnknown;
+}
+
+void StateCache::OnDeleteVertexArray(GLuint vao)
+{
+	if (_vao == vao)
+		_vao = 0;
+}
+
+void StateCache::OnDeleteTexture(GLuint texture)
+{
+	for (auto& unit : _textures)
+	{
+		for (auto& bound : unit)
+		{
+			if (bound == texture)
+				bound = 0;
+		}
+	}
+}
+
+void StateCache::OnDeleteSampler(GLuint sampler)
+{
+	for (auto& bound : _samplers)
+	{
+		if (bound == sampler)
+			bound = 0;
+	}
+}
+
+void StateCache::Invalidate()
+{
+	_program = kUnknown;
+	_vao = kUnknown;
+	_activeUnit = kUnknown;
+
+	for (auto& unit : _textures)
+	{
+		for (auto& bound : unit) bound = kUnknown;
+	}
+
+	for (auto& bound : _samplers) bound = kUnknown;
+
+	_blendSrc = kUnknown;
+	_blendDst = kUnknown;
+	_cullMode = kUnknown;
+	_blend = Toggle::Unknown;
+	_depthTest = Toggle::Unknown;
+	_depthMask = Toggle::Unknown;
+	_cullFace = Toggle::Unknown;
+}
+
+int StateCache::targetIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D: return Target2D;
+	case GL_TEXTURE_BUFFER: return TargetBuffer;
+	default: return -1;
+	}
+}
+
+bool StateCache::filter(bool redundant)
+{
+	if (redundant)
+		_stats.filtered++;
+	else
+		_stats.issued++;
+
+	return redundant;
+}
+
+void StateCache::setToggle(Toggle& cached, GLenum cap, bool enabled)
+{
+	const Toggle value = enabled ? Toggle::On : Toggle::Off;
+	if (filter(cached == value))
+		return;
+
+	cached = value;
+	if (enabled)
+		glEnable(cap);
+	else
+		glDisable(cap);
+}
+
+} // namespace Donut::GL
@@ -0,0 +1,95 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include "Render/OpenGL/glad/glad.h"
+#include <cstddef>
+
+namespace Donut::GL
+{
+
+// Shadow copy of the GL state we touch so redundant binds never reach the driver.
+// Everything that changes these bindings must go through here, otherwise the shadow goes stale;
+// call Invalidate() after handing the context to code we don't own (e.g. ImGui).
+class StateCache
+{
+public:
+	static constexpr std::size_t kMaxTextureUnits = 16;
+
+	struct Stats
+	{
+		std::size_t issued = 0;
+		std::size_t filtered = 0;
+		std::size_t draws = 0;
+	};
+
+	static void UseProgram(GLuint program);
+	static void BindVertexArray(GLuint vao);
+	static void ActiveTexture(GLuint unit);
+	static void BindTexture(GLuint unit, GLenum target, GLuint texture);
+	static void BindTexture(GLenum target, GLuint texture); // binds to the active unit
+	static void BindSampler(GLuint unit, GLuint sampler);
+
+	static void SetBlend(bool enabled);
+	static void BlendFunc(GLenum src, GLenum dst);
+	static void SetDepthTest(bool enabled);
+	static void DepthMask(bool write);
+	static void SetCullFace(bool enabled);
+	static void CullFace(GLenum mode);
+
+	// keep the shadow from aliasing a recycled handle
+	static void OnDeleteProgram(GLuint program);
+	static void OnDeleteVertexArray(GLuint vao);
+	static void OnDeleteTexture(GLuint texture);
+	static void OnDeleteSampler(GLuint sampler);
+
+	static GLuint GetActiveTexture() { return _activeUnit; }
+
+	// forget everything, the next call of each kind is always issued
+	static void Invalidate();
+
+	// draw calls aren't state, but they're counted alongside it so one reset covers the frame
+	static void CountDraw() { _stats.draws++; }
+
+	static const Stats& GetStats() { return _stats; }
+	static void ResetStats() { _stats = Stats(); }
+
+private:
+	enum TextureTarget
+	{
+		Target2D,
+		TargetBuffer,
+		TargetCount,
+	};
+
+	// tristate so an unknown enable flag never compares equal
+	enum class Toggle : char
+	{
+		Unknown,
+		Off,
+		On,
+	};
+
+	static int targetIndex(GLenum target);
+	static bool filter(bool redundant);
+	static void setToggle(Toggle& cached, GLenum cap, bool enabled);
+
+	static constexpr GLuint kUnknown = ~0u;
+
+	static GLuint _program;
+	static GLuint _vao;
+	static GLuint _activeUnit;
+	static GLuint _textures[kMaxTextureUnits][TargetCount];
+	static GLuint _samplers[kMaxTextureUnits];
+	static GLenum _blendSrc;
+	static GLenum _blendDst;
+	static GLenum _cullMode;
+	static Toggle _blend;
+	static Toggle _depthTest;
+	static Toggle _depthMask;
+	static Toggle _cullFace;
+
+	static Stats _stats;
+};
+
+} // namespace Donut::GL
@@ -0,0 +1,42 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include <Render/OpenGL/DeletionQueue.h>
+#include <Render/OpenGL/StorageBuffer.h>
+#include <cassert>
+
+namespace Donut::GL
+{
+
+StorageBuffer::StorageBuffer(const void* data, std::size_t sizeBytes, GLenum hint): _handle(0), _size(sizeBytes), _hint(hint)
+{
+	assert(sizeBytes > 0);
+
+	// the copy target leaves every binding that means something to a draw alone
+	glGenBuffers(1, &_handle);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, _handle);
+	glBufferData(GL_COPY_WRITE_BUFFER, _size, data, _hint);
+}
+
+StorageBuffer::~StorageBuffer()
+{
+	DeletionQueue::Retire(DeletionQueue::Type::Buffer, _handle);
+}
+
+void StorageBuffer::UpdateBuffer(const void* data, std::size_t offset, std::size_t size)
+{
+	assert(offset + size <= _size);
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, _handle);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+}
+
+std::size_t StorageBuffer::GetOffsetAlignment()
+{
+	static GLint alignment = 0;
+	if (alignment == 0)
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+	return static_cast<std::size_t>(alignment);
+}
+
+} // namespace Donut::GL
@@ -0,0 +1,40 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include "Render/OpenGL/glad/glad.h"
+#include <cstddef>
+
+namespace Donut::GL
+{
+
+// Plain buffer object for data shaders read or write directly: SSBOs, indirect draw/dispatch commands.
+class StorageBuffer
+{
+public:
+	StorageBuffer() = delete;
+	StorageBuffer(const StorageBuffer&) = delete;
+
+	StorageBuffer(const void* data, std::size_t sizeBytes, GLenum hint = GL_STATIC_DRAW);
+	~StorageBuffer();
+
+	StorageBuffer& operator=(const StorageBuffer&) = delete;
+
+	void UpdateBuffer(const void* data, std::size_t offset, std::size_t size);
+
+	void Bind(GLenum target) const { glBindBuffer(target, _handle); }
+	void BindBase(GLenum target, GLuint binding) const { glBindBufferBase(target, binding, _handle); }
+
+	std::size_t GetSize() const { return _size; }
+	GLuint GetHandle() const { return _handle; }
+
+	// what glBindBufferRange offsets on GL_SHADER_STORAGE_BUFFER have to be a multiple of
+	static std::size_t GetOffsetAlignment();
+
+private:
+	GLuint _handle;
+	std::size_t _size;
+	GLenum _hint;
+};
+
+} // namespace Donut::GL
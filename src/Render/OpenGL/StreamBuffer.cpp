@@ -0,0 +1,125 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include <Render/OpenGL/DeletionQueue.h>
+#include <Render/OpenGL/StreamBuffer.h>
+#include <cassert>
+
+namespace Donut::GL
+{
+
+std::size_t StreamBuffer::_stalls = 0;
+
+static std::size_t alignUp(std::size_t value, std::size_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+StreamBuffer::StreamBuffer(std::size_t regionSize, std::size_t regionCount)
+    : _handle(0), _regionSize(regionSize), _region(0), _head(0), _persistent(nullptr), _mapped(false),
+      _fences(regionCount, nullptr)
+{
+	assert(regionSize > 0 && regionCount > 1);
+
+	const std::size_t size = _regionSize * regionCount;
+
+	// the copy target leaves every binding that means something to a draw alone
+	glGenBuffers(1, &_handle);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, _handle);
+
+	if (GLAD_GL_ARB_buffer_storage)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+		_persistent = static_cast<uint8_t*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+	}
+	else
+	{
+		glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	}
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	for (GLsync fence : _fences) DeletionQueue::Retire(fence);
+
+	// deleting the buffer unmaps it, by then the GPU is done with every region
+	DeletionQueue::Retire(DeletionQueue::Type::Buffer, _handle);
+}
+
+void* StreamBuffer::Map(std::size_t size, std::size_t alignment, std::size_t& offset)
+{
+	assert(!_mapped && size > 0 && alignment > 0 && size <= _regionSize);
+
+	std::size_t regionStart = _region * _regionSize;
+	offset = alignUp(regionStart + _head, alignment);
+	if (offset + size > regionStart + _regionSize)
+	{
+		NextRegion();
+		regionStart = _region * _regionSize;
+		offset = alignUp(regionStart, alignment);
+
+		// a region size that's a multiple of the alignment always fits a whole region
+		assert(offset + size <= regionStart + _regionSize);
+	}
+
+	_head = offset + size - regionStart;
+	_mapped = true;
+
+	if (_persistent != nullptr)
+		return _persistent + offset;
+
+	// the fences already keep us off anything in flight
+	glBindBuffer(GL_COPY_WRITE_BUFFER, _handle);
+	return glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size,
+	                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+void StreamBuffer::Unmap()
+{
+	assert(_mapped);
+	_mapped = false;
+
+	// coherent writes are visible to any command issued after them
+	if (_persistent != nullptr)
+		return;
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, _handle);
+	glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+}
+
+void StreamBuffer::NextRegion()
+{
+	if (_head == 0)
+		return;
+
+	// every draw reading this region has been issued by now
+	_fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	_region = (_region + 1) % _fences.size();
+	_head = 0;
+	waitForRegion(_region);
+}
+
+void StreamBuffer::waitForRegion(std::size_t region)
+{
+	GLsync& fence = _fences[region];
+	if (fence == nullptr)
+		return;
+
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+	{
+		_stalls++;
+
+		// flush so the fence itself is guaranteed to reach the GPU
+		do
+		{
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		} while (status == GL_TIMEOUT_EXPIRED);
+	}
+
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+} // namespace Donut::GL
@@ -0,0 +1,67 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include "Render/OpenGL/glad/glad.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Donut::GL
+{
+
+// Buffer for data the CPU rewrites every frame, split into a ring of regions the GPU reads while the CPU fills the
+// next. With GL_ARB_buffer_storage the whole buffer is mapped once, persistent and coherent, so producers write their
+// vertices/blocks straight into it: no staging copy, no orphaning, no implicit sync in the driver. Allocations fill the
+// current region front to back; leaving a region drops a fence behind it and coming back around waits on that fence,
+// which only blocks if the GPU has fallen a whole ring behind. Drivers without buffer storage get each allocation
+// mapped unsynchronized instead, guarded by the same fences.
+class StreamBuffer
+{
+public:
+	static constexpr std::size_t kDefaultRegionCount = 3;
+
+	StreamBuffer() = delete;
+	StreamBuffer(const StreamBuffer&) = delete;
+
+	StreamBuffer(std::size_t regionSize, std::size_t regionCount = kDefaultRegionCount);
+	~StreamBuffer();
+
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	// room for size bytes at a buffer offset that's a multiple of alignment (any value, vertex strides are fine);
+	// write through the pointer and Unmap before anything draws from it, one mapping at a time
+	void* Map(std::size_t size, std::size_t alignment, std::size_t& offset);
+	void Unmap();
+
+	// skip the rest of the current region, e.g. to start each frame on a fresh one
+	void NextRegion();
+
+	void Bind(GLenum target) const { glBindBuffer(target, _handle); }
+	void BindRange(GLenum target, GLuint binding, std::size_t offset, std::size_t size) const
+	{
+		glBindBufferRange(target, binding, _handle, offset, size);
+	}
+
+	GLuint GetHandle() const { return _handle; }
+	std::size_t GetRegionSize() const { return _regionSize; }
+	bool IsPersistent() const { return _persistent != nullptr; }
+
+	// times any stream buffer had to wait for the GPU to finish with a region
+	static std::size_t GetStallCount() { return _stalls; }
+
+private:
+	void waitForRegion(std::size_t region);
+
+	GLuint _handle;
+	std::size_t _regionSize;
+	std::size_t _region;
+	std::size_t _head; // bytes used in the current region
+	uint8_t* _persistent;
+	bool _mapped;
+	std::vector<GLsync> _fences; // per region, set when we move off it
+
+	static std::size_t _stalls;
+};
+
+} // namespace Donut::GL
@@ -1,55 +1,74 @@
 // Copyright 2019-2020 the donut authors. See AUTHORS.md
 
 #include "Render/OpenGL/glad/glad.h"
+#include <Render/OpenGL/DeletionQueue.h>
+#include <Render/OpenGL/StateCache.h>
+#include <Render/OpenGL/StreamBuffer.h>
 #include <Render/OpenGL/TextureBuffer.h>
 
+#include <cstring>
+
 namespace Donut::GL
 {
 
-TextureBuffer::TextureBuffer(): m_handle(0), m_bufferHandle(0)
+static size_t offsetAlignment()
 {
-	glGenTextures(1, &m_handle);
-	glGenBuffers(1, &m_bufferHandle);
+	static GLint alignment = 0;
+	if (alignment == 0)
+		glGetIntegerv(GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &alignment);
 
-	glBindBuffer(GL_TEXTURE_BUFFER, m_bufferHandle);
-	glBufferData(GL_TEXTURE_BUFFER, 0, 0, GL_DYNAMIC_READ);
-	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	return alignment > 0 ? static_cast<size_t>(alignment) : 256;
+}
 
-	glBindTexture(GL_TEXTURE_BUFFER, m_handle);
-	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_bufferHandle);
-	glBindTexture(GL_TEXTURE_BUFFER, 0);
+TextureBuffer::TextureBuffer(): m_handle(0), m_offset(0), m_length(0)
+{
+	glGenTextures(1, &m_handle);
 }
 
 TextureBuffer::~TextureBuffer()
 {
-	if (m_bufferHandle != 0)
-	{
-		glDeleteBuffers(1, &m_bufferHandle);
-		m_bufferHandle = 0;
-	}
+	DeletionQueue::Retire(DeletionQueue::Type::Texture, m_handle);
+	m_handle = 0;
+}
+
+void* TextureBuffer::Map(size_t length)
+{
+	// sized on first use, regrown if the texel count goes up
+	const size_t alignment = offsetAlignment();
+	if (m_buffer == nullptr || length > m_buffer->GetRegionSize())
+		m_buffer = std::make_unique<StreamBuffer>((length + alignment - 1) / alignment * alignment);
 
-	if (m_handle != 0)
-	{
-		glDeleteTextures(1, &m_handle);
-		m_handle = 0;
-	}
+	m_length = length;
+	return m_buffer->Map(length, alignment, m_offset);
 }
 
-void TextureBuffer::SetBuffer(void* buffer, size_t length)
+void TextureBuffer::Unmap()
 {
-	glBindBuffer(GL_TEXTURE_BUFFER, m_bufferHandle);
-	glBufferData(GL_TEXTURE_BUFFER, length, buffer, GL_DYNAMIC_READ);
-	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	m_buffer->Unmap();
+
+	StateCache::BindTexture(GL_TEXTURE_BUFFER, m_handle);
+	glTexBufferRange(GL_TEXTURE_BUFFER, GL_RGBA32F, m_buffer->GetHandle(), m_offset, m_length);
+}
+
+void TextureBuffer::SetBuffer(const void* buffer, size_t length)
+{
+	std::memcpy(Map(length), buffer, length);
+	Unmap();
 }
 
 void TextureBuffer::Bind()
 {
-	glBindTexture(GL_TEXTURE_BUFFER, m_handle);
+	StateCache::BindTexture(GL_TEXTURE_BUFFER, m_handle);
+}
+
+void TextureBuffer::Bind(GLuint unit)
+{
+	StateCache::BindTexture(unit, GL_TEXTURE_BUFFER, m_handle);
 }
 
 void TextureBuffer::Unbind()
 {
-	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	StateCache::BindTexture(GL_TEXTURE_BUFFER, 0);
 }
 
 } // namespace Donut::GL
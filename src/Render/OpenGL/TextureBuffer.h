@@ -3,11 +3,15 @@
 #pragma once
 
 #include "Render/OpenGL/glad/glad.h"
-#include <vector>
+#include <cstddef>
+#include <memory>
 
 namespace Donut::GL
 {
+class StreamBuffer;
 
+// RGBA32F texels backed by a stream buffer; each update gets a fresh range and the texture is pointed at it, so
+// a draw still reading last frame's texels never blocks the write.
 class TextureBuffer
 {
 
@@ -16,11 +20,19 @@ public:
 	~TextureBuffer();
 
 	void Bind();
+	void Bind(GLuint unit);
 	void Unbind();
-	void SetBuffer(void* buffer, size_t length);
+
+	// write length bytes of texels in place, the texture sees them after Unmap
+	void* Map(size_t length);
+	void Unmap();
+
+	void SetBuffer(const void* buffer, size_t length);
 
 protected:
 	GLuint m_handle;
-	GLuint m_bufferHandle;
+	std::unique_ptr<StreamBuffer> m_buffer;
+	size_t m_offset;
+	size_t m_length;
 };
 } // namespace Donut::GL
@@ -0,0 +1,58 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include <Render/OpenGL/DeletionQueue.h>
+#include <Render/OpenGL/UniformBuffer.h>
+#include <cassert>
+
+namespace Donut::GL
+{
+
+UniformBuffer::UniformBuffer(std::size_t sizeBytes, GLenum hint): _ubo(0), _size(sizeBytes), _hint(hint)
+{
+	assert(sizeBytes > 0);
+
+	glGenBuffers(1, &_ubo);
+	glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+	glBufferData(GL_UNIFORM_BUFFER, _size, nullptr, _hint);
+}
+
+UniformBuffer::~UniformBuffer()
+{
+	DeletionQueue::Retire(DeletionQueue::Type::Buffer, _ubo);
+}
+
+void UniformBuffer::UpdateBuffer(const void* data, std::size_t offset, std::size_t size)
+{
+	assert(offset + size <= _size);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+}
+
+void UniformBuffer::Orphan()
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+	glBufferData(GL_UNIFORM_BUFFER, _size, nullptr, _hint);
+}
+
+void UniformBuffer::BindBase(GLuint binding) const
+{
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, _ubo);
+}
+
+void UniformBuffer::BindRange(GLuint binding, std::size_t offset, std::size_t size) const
+{
+	assert(offset % GetOffsetAlignment() == 0);
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding, _ubo, offset, size);
+}
+
+std::size_t UniformBuffer::GetOffsetAlignment()
+{
+	static GLint alignment = 0;
+	if (alignment == 0)
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+	return static_cast<std::size_t>(alignment);
+}
+
+} // namespace Donut::GL
@@ -0,0 +1,42 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include "Render/OpenGL/glad/glad.h"
+#include <cstddef>
+
+namespace Donut::GL
+{
+
+class UniformBuffer
+{
+public:
+	UniformBuffer() = delete;
+	UniformBuffer(const UniformBuffer&) = delete;
+
+	UniformBuffer(std::size_t sizeBytes, GLenum hint = GL_DYNAMIC_DRAW);
+	~UniformBuffer();
+
+	UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+	void UpdateBuffer(const void* data, std::size_t offset, std::size_t size);
+
+	// throw away the current storage so the driver doesn't stall on draws still reading it
+	void Orphan();
+
+	void BindBase(GLuint binding) const;
+	void BindRange(GLuint binding, std::size_t offset, std::size_t size) const;
+
+	std::size_t GetSize() const { return _size; }
+	GLuint GetUBO() const { return _ubo; }
+
+	// every BindRange offset has to be a multiple of this
+	static std::size_t GetOffsetAlignment();
+
+private:
+	GLuint _ubo;
+	std::size_t _size;
+	GLenum _hint;
+};
+
+} // namespace Donut::GL
@@ -2,14 +2,24 @@
 
 #include "VertexBinding.h"
 
+#include "DeletionQueue.h"
 #include "IndexBuffer.h"
+#include "StateCache.h"
+#include "StreamBuffer.h"
 #include "VertexBuffer.h"
 
 namespace Donut::GL
 {
 ArrayElement::ArrayElement(const VertexBuffer* buffer, std::size_t attributeIndex, std::size_t componentCount, ElementType type,
                            std::size_t stride, std::size_t offset, std::size_t instanceStep)
-    : buffer(buffer), attributeIndex(attributeIndex), componentCount(componentCount), type(type), stride(stride),
+    : vbo(buffer->GetVBO()), attributeIndex(attributeIndex), componentCount(componentCount), type(type), stride(stride),
+      offset(offset), instanceStep(instanceStep)
+{
+}
+
+ArrayElement::ArrayElement(const StreamBuffer* buffer, std::size_t attributeIndex, std::size_t componentCount, ElementType type,
+                           std::size_t stride, std::size_t offset, std::size_t instanceStep)
+    : vbo(buffer->GetHandle()), attributeIndex(attributeIndex), componentCount(componentCount), type(type), stride(stride),
       offset(offset), instanceStep(instanceStep)
 {
 }
@@ -22,6 +32,11 @@ VertexBinding::~VertexBinding()
 }
 
 void VertexBinding::Create(const ArrayElement* elements, std::size_t elementCount, const VertexBuffer& vertices)
+{
+	Create(elements, elementCount);
+}
+
+void VertexBinding::Create(const ArrayElement* elements, std::size_t elementCount)
 {
 	if (_handle != 0)
 	{
@@ -53,12 +68,8 @@ void VertexBinding::Create(const ArrayElement* elements, std::size_t elementCoun
 
 void VertexBinding::Dispose()
 {
-	if (_handle != 0)
-	{
-		glDeleteVertexArrays(1, &_handle);
-
-		_handle = 0;
-	}
+	DeletionQueue::Retire(DeletionQueue::Type::VertexArray, _handle);
+	_handle = 0;
 
 	_hasIndices = false;
 	_indicesType = AE_UBYTE;
@@ -66,12 +77,12 @@ void VertexBinding::Dispose()
 
 void VertexBinding::Bind()
 {
-	glBindVertexArray(_handle);
+	StateCache::BindVertexArray(_handle);
 }
 
 void VertexBinding::Unbind()
 {
-	glBindVertexArray(0);
+	StateCache::BindVertexArray(0);
 }
 
 void VertexBinding::CreateVAO()
@@ -98,30 +109,23 @@ void VertexBinding::SetupVertices(const ArrayElement* elements, std::size_t elem
 	{
 		const ArrayElement& element = elements[i];
 
-		glBindBuffer(GL_ARRAY_BUFFER, element.buffer->GetVBO());
-
-		GLenum type = GL_FLOAT;
+		glBindBuffer(GL_ARRAY_BUFFER, element.vbo);
 
-		if (element.type == AE_FLOAT)
-		{
-			type = GL_FLOAT;
-		}
-		else if (element.type == AE_INT)
-		{
-			type = GL_INT;
-		}
+		const GLenum type = static_cast<GLenum>(element.type & ~AE_NORMALIZED);
+		const bool normalized = (element.type & AE_NORMALIZED) != 0;
+		const bool integer = !normalized && type != GL_FLOAT && type != GL_HALF_FLOAT;
 
 		glEnableVertexAttribArray((GLuint)element.attributeIndex);
 
-		if (type == GL_INT || type == GL_UNSIGNED_INT)
+		if (integer)
 		{
 			glVertexAttribIPointer((GLuint)element.attributeIndex, (GLint)element.componentCount, type, (GLsizei)element.stride,
 			                       (void*)element.offset);
 		}
 		else
 		{
-			glVertexAttribPointer((GLuint)element.attributeIndex, (GLint)element.componentCount, type, GL_FALSE,
-			                      (GLsizei)element.stride, (void*)element.offset);
+			glVertexAttribPointer((GLuint)element.attributeIndex, (GLint)element.componentCount, type,
+			                      normalized ? GL_TRUE : GL_FALSE, (GLsizei)element.stride, (void*)element.offset);
 		}
 
 		if (element.instanceStep > 0)
@@ -9,14 +9,25 @@ namespace Donut::GL
 {
 class VertexBuffer;
 class IndexBuffer;
+class StreamBuffer;
+
+// normalized types are fed to float inputs scaled to [0, 1] / [-1, 1], the plain integer types to int/uint inputs
+static const int AE_NORMALIZED = 0x10000;
 
 enum ElementType
 {
 	AE_FLOAT = GL_FLOAT,
+	AE_HALF_FLOAT = GL_HALF_FLOAT,
 	AE_INT = GL_INT,
-	AE_UBYTE = GL_UNSIGNED_BYTE,
 	AE_UINT = GL_UNSIGNED_INT,
+	AE_BYTE = GL_BYTE,
+	AE_UBYTE = GL_UNSIGNED_BYTE,
+	AE_SHORT = GL_SHORT,
 	AE_USHORT = GL_UNSIGNED_SHORT,
+	AE_BYTE_NORM = AE_NORMALIZED | GL_BYTE,
+	AE_UBYTE_NORM = AE_NORMALIZED | GL_UNSIGNED_BYTE,
+	AE_SHORT_NORM = AE_NORMALIZED | GL_SHORT,
+	AE_USHORT_NORM = AE_NORMALIZED | GL_UNSIGNED_SHORT,
 };
 
 struct ArrayElement
@@ -24,7 +35,11 @@ struct ArrayElement
 	ArrayElement(const VertexBuffer* buffer, std::size_t attributeIndex, std::size_t componentCount, ElementType type,
 	             std::size_t stride, std::size_t offset, std::size_t instanceStep = 0);
 
-	const VertexBuffer* buffer;
+	// offset is from the start of the whole buffer, draws pick the region with their first vertex
+	ArrayElement(const StreamBuffer* buffer, std::size_t attributeIndex, std::size_t componentCount, ElementType type,
+	             std::size_t stride, std::size_t offset, std::size_t instanceStep = 0);
+
+	GLuint vbo;
 	std::size_t attributeIndex;
 	std::size_t componentCount;
 	ElementType type;
@@ -40,6 +55,7 @@ public:
 	explicit VertexBinding();
 	~VertexBinding();
 
+	void Create(const ArrayElement* elements, std::size_t elementCount);
 	void Create(const ArrayElement* elements, std::size_t elementCount, const VertexBuffer& vertices);
 	void Create(const ArrayElement* elements, std::size_t elementCount, const IndexBuffer& indices, ElementType indicesType);
 	void Dispose();
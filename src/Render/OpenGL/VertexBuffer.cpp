@@ -1,5 +1,6 @@
 // Copyright 2019-2020 the donut authors. See AUTHORS.md
 
+#include <Render/OpenGL/DeletionQueue.h>
 #include <Render/OpenGL/VertexBuffer.h>
 #include <cassert>
 
@@ -23,8 +24,7 @@ VertexBuffer::VertexBuffer(const void* vertices, std::size_t vertexCount, size_t
 
 VertexBuffer::~VertexBuffer()
 {
-	if (_vbo != 0)
-		glDeleteBuffers(1, &_vbo);
+	DeletionQueue::Retire(DeletionQueue::Type::Buffer, _vbo);
 }
 
 void VertexBuffer::UpdateBuffer(const void* data, size_t offset, size_t size)
@@ -1,6 +1,8 @@
 // Copyright 2019-2020 the donut authors. See AUTHORS.md
 
 #include <P3D/P3D.generated.h>
+#include <Render/OpenGL/DeletionQueue.h>
+#include <Render/OpenGL/StateCache.h>
 #include <Render/Shader.h>
 #include <fmt/format.h>
 #include <iostream>
@@ -90,8 +92,7 @@ Shader::Shader(const P3D::Shader& shader): _name(shader.GetName())
 
 Shader::~Shader()
 {
-	if (_glSampler != 0)
-		glDeleteSamplers(1, &_glSampler);
+	GL::DeletionQueue::Retire(GL::DeletionQueue::Type::Sampler, _glSampler);
 }
 
 void Shader::SetDiffuseTexture(Texture* diffuseTexture)
@@ -102,7 +103,7 @@ void Shader::SetDiffuseTexture(Texture* diffuseTexture)
 void Shader::Bind(GLuint unit) const
 {
 	_diffuseTexture->Bind(unit);
-	glBindSampler(unit, _glSampler);
+	GL::StateCache::BindSampler(unit, _glSampler);
 }
 
 } // namespace Donut
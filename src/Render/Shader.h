@@ -1,6 +1,7 @@
 #pragma once
 #include "OpenGL/glad/glad.h"
 
+#include <Render/ShaderVariants.h>
 #include <Render/Texture.h>
 #include <memory>
 #include <string>
@@ -49,6 +50,9 @@ public:
 
 	bool IsTranslucent() const { return _isTranslucent; }
 
+	// the ShaderFeature bits this material needs on top of whatever the geometry asks for
+	uint32_t GetShaderFeatures() const { return _alphaTested ? AlphaTestFeature : 0; }
+
 	BlendMode GetBlendMode() const { return _blendMode; }
 
 protected:
@@ -0,0 +1,81 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include "ShaderVariants.h"
+
+#include "Render/OpenGL/ShaderProgram.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace Donut
+{
+
+static const char* kFeatureDefines[ShaderFeatureCount] = {
+    "INSTANCED", "BILLBOARD", "SKINNED", "ALPHA_TEST", "VERTEX_COLOR", "LIGHTING",
+};
+
+ShaderVariants::ShaderVariants(std::string vertexSource, std::string fragmentSource, SetupFunc setup)
+    : _vertexSource(std::move(vertexSource)), _fragmentSource(std::move(fragmentSource)), _setup(std::move(setup)),
+      _lastFeatures(0), _lastProgram(nullptr)
+{
+}
+
+ShaderVariants::~ShaderVariants() = default;
+
+GL::ShaderProgram& ShaderVariants::Get(uint32_t features)
+{
+	if (_lastProgram != nullptr && features == _lastFeatures)
+		return *_lastProgram;
+
+	auto& program = _programs[features];
+	if (program == nullptr)
+	{
+		program = std::make_unique<GL::ShaderProgram>(Specialize(_vertexSource, features),
+		                                              Specialize(_fragmentSource, features));
+
+		// kept even when broken so we don't recompile it every draw, it just draws nothing
+		if (!program->IsValid())
+			std::fprintf(stderr, "Shader variant 0x%x failed to build\n", features);
+		else if (_setup)
+			_setup(*program);
+	}
+
+	_lastFeatures = features;
+	_lastProgram = program.get();
+	return *program;
+}
+
+void ShaderVariants::Precompile(std::initializer_list<uint32_t> variants)
+{
+	for (uint32_t features : variants) Get(features);
+}
+
+std::string ShaderVariants::Specialize(const std::string& source, uint32_t features)
+{
+	std::string defines;
+	for (uint32_t i = 0; i < ShaderFeatureCount; ++i)
+	{
+		if (features & (1u << i))
+			defines += std::string("#define ") + kFeatureDefines[i] + " 1\n";
+	}
+
+	// #version has to stay first
+	std::size_t insertAt = 0;
+	if (source.compare(0, 8, "#version") == 0)
+	{
+		const std::size_t lineEnd = source.find('\n');
+		insertAt = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
+	}
+
+	// keep compiler errors pointing at the lines in the file
+	const std::size_t line = std::count(source.begin(), source.begin() + insertAt, '\n') + 1;
+	defines += "#line " + std::to_string(line) + "\n";
+
+	std::string head = source.substr(0, insertAt);
+	if (!head.empty() && head.back() != '\n')
+		head += '\n';
+
+	return head + defines + source.substr(insertAt);
+}
+
+} // namespace Donut
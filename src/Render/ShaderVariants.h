@@ -0,0 +1,66 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace Donut
+{
+
+namespace GL
+{
+class ShaderProgram;
+}
+
+// compile-time features of the world shaders, each is a #define of the name in the comment
+enum ShaderFeature : uint32_t
+{
+	InstancedFeature = 1 << 0,   // INSTANCED, transforms from the instance SSBO
+	BillboardFeature = 1 << 1,   // BILLBOARD, camera facing quads
+	SkinnedFeature = 1 << 2,     // SKINNED, bone palette from a buffer texture
+	AlphaTestFeature = 1 << 3,   // ALPHA_TEST
+	VertexColorFeature = 1 << 4, // VERTEX_COLOR
+	LightingFeature = 1 << 5,    // LIGHTING, skinned only
+	ShaderFeatureCount = 6,
+};
+
+// Every combination of ShaderFeature bits used from one vertex/fragment source pair. A variant is compiled the
+// first time it's asked for (or up front with Precompile) and kept; ShaderProgram's binary cache makes the next
+// launch cheap either way.
+class ShaderVariants
+{
+public:
+	// runs once on each new program, for uniform blocks and sampler units
+	using SetupFunc = std::function<void(GL::ShaderProgram&)>;
+
+	ShaderVariants(std::string vertexSource, std::string fragmentSource, SetupFunc setup = nullptr);
+	~ShaderVariants();
+
+	GL::ShaderProgram& Get(uint32_t features);
+
+	void Precompile(std::initializer_list<uint32_t> variants);
+
+	std::size_t GetVariantCount() const { return _programs.size(); }
+
+	// the source with a #define for each feature after its #version line
+	static std::string Specialize(const std::string& source, uint32_t features);
+
+private:
+	std::string _vertexSource;
+	std::string _fragmentSource;
+	SetupFunc _setup;
+
+	std::unordered_map<uint32_t, std::unique_ptr<GL::ShaderProgram>> _programs;
+
+	// draws mostly ask for the same variant back to back
+	uint32_t _lastFeatures;
+	GL::ShaderProgram* _lastProgram;
+};
+
+} // namespace Donut
@@ -2,8 +2,11 @@
 
 #include <Game.h>
 #include <P3D/P3D.generated.h>
+#include <Render/MeshOptimizer.h>
+#include <Render/OpenGL/StateCache.h>
 #include <Render/Shader.h>
 #include <Render/SkinModel.h>
+#include <cassert>
 
 namespace Donut
 {
@@ -13,13 +16,13 @@ void SkinModel::LoadPolySkin(const P3D::PolySkin& polySkin)
 	// todo: reset the _vertexBuffer & _indexBuffer
 
 	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
-	std::size_t vertOffset = 0, idxOffset = 0;
+	std::vector<MeshOptimizer::PrimGroup> groups;
+	std::size_t vertOffset = 0;
 
 	for (auto const& prim : polySkin.GetPrimitiveGroups())
 	{
 		const auto primVerts = prim->GetVertices();
-		const auto primUV = prim->GetUvs(0);
+		const auto primUV = PackUVs(prim->GetUvs(0)); // turn that frown upside down :)
 		const auto primNormals = prim->GetNormals();
 		const auto primIndices = prim->GetIndices();
 		const auto primWeights = prim->GetWeightList();
@@ -32,7 +35,7 @@ void SkinModel::LoadPolySkin(const P3D::PolySkin& polySkin)
 
 		for (uint32_t i = 0; i < primVerts.size(); i++)
 		{
-			auto boneIndices = Vector3Int::Zero;
+			UByte4 boneIndices {0, 0, 0, 0};
 
 			if (primHasBoneIndices)
 			{
@@ -42,18 +45,16 @@ void SkinModel::LoadPolySkin(const P3D::PolySkin& polySkin)
 				auto i2 = (m >> 8) & 0xFF;
 				auto i3 = m & 0xFF;
 
-				boneIndices = Vector3Int(primMatrixPalette[i0], primMatrixPalette[i1], primMatrixPalette[i2]);
+				// 8 bits is plenty, skeletons top out well under 256 joints
+				assert(primMatrixPalette[i0] < 256 && primMatrixPalette[i1] < 256 && primMatrixPalette[i2] < 256);
+				boneIndices = UByte4 {static_cast<uint8_t>(primMatrixPalette[i0]), static_cast<uint8_t>(primMatrixPalette[i1]),
+				                      static_cast<uint8_t>(primMatrixPalette[i2]), 0};
 			}
 
 			const auto weight = primHasWeights ? primWeights[i] : Vector3(1, 0, 0);
-			const auto uv = Vector2(primUV[i].X, 1.0f - primUV[i].Y); // turn that frown upside down :)
-
-			vertices.emplace_back(primVerts[i], primNormals[i], uv, weight, boneIndices);
+			vertices.emplace_back(primVerts[i], OctEncode(primNormals[i]), primUV[i], PackWeights(weight), boneIndices);
 		}
 
-		// copy over indices and offset by the prim groups vertices
-		for (auto idx : primIndices) indices.emplace_back(idx + static_cast<uint32_t>(vertOffset));
-
 		GLenum mode = GL_TRIANGLE_STRIP;
 		switch ((P3D::PrimitiveType)prim->GetPrimType())
 		{
@@ -62,42 +63,54 @@ void SkinModel::LoadPolySkin(const P3D::PolySkin& polySkin)
 		case P3D::PrimitiveType::LineStrip: mode = GL_LINE_STRIP; break;
 		case P3D::PrimitiveType::LineList: mode = GL_LINES; break;
 		}
-		_primGroups.emplace_back(mode, prim->GetShaderName(), idxOffset, primIndices.size());
+
+		// copy over indices and offset by the prim groups vertices
+		MeshOptimizer::PrimGroup group {prim->GetShaderName(), mode, {}};
+		for (auto idx : primIndices) group.indices.emplace_back(idx + static_cast<uint32_t>(vertOffset));
+		groups.push_back(std::move(group));
 
 		vertOffset += primVerts.size();
-		idxOffset += primIndices.size();
+	}
+
+	const auto remap = MeshOptimizer::Optimize(groups, vertices.size());
+	vertices = MeshOptimizer::RemapVertices(vertices, remap);
+
+	std::vector<uint32_t> indices;
+	for (auto& group : groups)
+	{
+		_primGroups.emplace_back(group.mode, group.shaderName, indices.size(), group.indices.size());
+		indices.insert(indices.end(), group.indices.begin(), group.indices.end());
 	}
 
 	_vertexBuffer = std::make_unique<GL::VertexBuffer>(vertices.data(), vertices.size(), sizeof(Vertex));
-	_indexBuffer = std::make_unique<GL::IndexBuffer>(indices.data(), indices.size(), GL_UNSIGNED_INT);
+	_indexBuffer = std::make_unique<GL::IndexBuffer>(indices, vertices.size());
 
 	GL::ArrayElement vertexLayout[] = {
 	    GL::ArrayElement(_vertexBuffer.get(), 0, 3, GL::AE_FLOAT, sizeof(Vertex), offsetof(Vertex, pos)),
-	    GL::ArrayElement(_vertexBuffer.get(), 1, 3, GL::AE_FLOAT, sizeof(Vertex), offsetof(Vertex, normal)),
-	    GL::ArrayElement(_vertexBuffer.get(), 2, 2, GL::AE_FLOAT, sizeof(Vertex), offsetof(Vertex, uv)),
-	    GL::ArrayElement(_vertexBuffer.get(), 3, 3, GL::AE_FLOAT, sizeof(Vertex), offsetof(Vertex, boneWeights)),
-	    GL::ArrayElement(_vertexBuffer.get(), 4, 3, GL::AE_INT, sizeof(Vertex), offsetof(Vertex, boneIndices)),
+	    GL::ArrayElement(_vertexBuffer.get(), 1, 2, GL::AE_SHORT_NORM, sizeof(Vertex), offsetof(Vertex, normal)),
+	    GL::ArrayElement(_vertexBuffer.get(), 2, 2, GL::AE_HALF_FLOAT, sizeof(Vertex), offsetof(Vertex, uv)),
+	    GL::ArrayElement(_vertexBuffer.get(), 3, 4, GL::AE_UBYTE_NORM, sizeof(Vertex), offsetof(Vertex, boneWeights)),
+	    GL::ArrayElement(_vertexBuffer.get(), 4, 4, GL::AE_UBYTE, sizeof(Vertex), offsetof(Vertex, boneIndices)),
 	};
 
 	_vertexBinding = std::make_unique<GL::VertexBinding>();
-	_vertexBinding->Create(vertexLayout, 5, *_indexBuffer, GL::AE_UINT);
+	_vertexBinding->Create(vertexLayout, 5, *_indexBuffer, (GL::ElementType)_indexBuffer->GetType());
 }
 
 void SkinModel::Draw()
 {
 	_vertexBinding->Bind();
 
-	glActiveTexture(GL_TEXTURE0);
+	const std::size_t indexSize = GL::IndexBuffer::GetTypeSize(_indexBuffer->GetType());
 	for (auto const& primGroup : _primGroups)
 	{
 		auto const& shader = Game::GetInstance().GetResourceManager().GetShader(primGroup.shaderName);
 		shader->Bind(0);
 
+		GL::StateCache::CountDraw();
 		glDrawElements(primGroup.mode, primGroup.indicesCount, _indexBuffer->GetType(),
-		               reinterpret_cast<const void*>(primGroup.indicesOffset * 4));
+		               reinterpret_cast<const void*>(primGroup.indicesOffset * indexSize));
 	}
-
-	_vertexBinding->Unbind();
 }
 
 } // namespace Donut
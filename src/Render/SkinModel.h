@@ -2,12 +2,12 @@
 
 #pragma once
 
-#include "Core/Math/Vector3Int.h"
 #include "Render/OpenGL/IndexBuffer.h"
 #include "Render/OpenGL/TextureBuffer.h"
 #include "Render/OpenGL/VertexBinding.h"
 #include "Render/OpenGL/VertexBuffer.h"
 #include "Render/SkinAnimation.h"
+#include "Render/VertexPacking.h"
 #include "ResourceManager.h"
 
 #include <string>
@@ -32,12 +32,12 @@ class SkinModel
 	struct Vertex
 	{
 		Vector3 pos;
-		Vector3 normal;
-		Vector2 uv;
-		Vector3 boneWeights;
-		Vector3Int boneIndices;
+		Snorm16x2 normal; // octahedral
+		Half2 uv;
+		UByte4 boneWeights;
+		UByte4 boneIndices;
 
-		Vertex(Vector3 pos, Vector3 normal, Vector2 uv, Vector3 boneWeights, Vector3Int boneIndices)
+		Vertex(Vector3 pos, Snorm16x2 normal, Half2 uv, UByte4 boneWeights, UByte4 boneIndices)
 		    : pos(pos), normal(normal), uv(uv), boneWeights(boneWeights), boneIndices(boneIndices)
 		{
 		}
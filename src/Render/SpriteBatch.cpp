@@ -5,36 +5,50 @@
 #include "Core/Math/Math.h"
 #include "Render/Font.h"
 #include "Render/OpenGL/ShaderProgram.h"
+#include "Render/OpenGL/StateCache.h"
+#include "Render/OpenGL/StreamBuffer.h"
 #include "Render/OpenGL/VertexBinding.h"
-#include "Render/OpenGL/VertexBuffer.h"
 #include "Render/Texture.h"
 
+#include <algorithm>
+#include <cstddef>
+
 namespace Donut
 {
 std::string SpriteBatchVertSrc = R"glsl(
-		#version 150 core
+		#version 330 core
 
-		in vec2 vert_position;
-		in vec2 vert_texcoord;
-		in vec4 vert_color;
+		layout(location = 0) in vec4 instance_rect; // position, size
+		layout(location = 1) in vec4 instance_uv;   // uv1, uv2
+		layout(location = 2) in vec4 instance_color;
+		layout(location = 3) in vec2 instance_rotation; // cos, sin
 
 		out vec2 frag_texcoord;
 		out vec4 frag_color;
 
 		uniform mat4 projMatrix;
+		uniform float scale;
 
 		void main()
 		{
-			frag_texcoord = vert_texcoord;
-			frag_color = vert_color;
-			gl_Position = projMatrix * vec4(vert_position.xy, 1.0, 1.0);
+			// triangle strip over the corners (0, 0) (0, 1) (1, 0) (1, 1)
+			vec2 corner = vec2(gl_VertexID >> 1, gl_VertexID & 1);
+
+			vec2 local = (corner - 0.5) * instance_rect.zw;
+			vec2 rotated = vec2(local.x * instance_rotation.x - local.y * instance_rotation.y,
+			                    local.y * instance_rotation.x + local.x * instance_rotation.y);
+			vec2 position = (rotated + instance_rect.xy + instance_rect.zw * 0.5) * scale;
+
+			frag_texcoord = mix(instance_uv.xy, instance_uv.zw, corner);
+			frag_color = instance_color;
+			gl_Position = projMatrix * vec4(position, 1.0, 1.0);
 		}
 	)glsl";
 
 std::string SpriteBatchFragSrc = R"glsl(
-		#version 150 core
+		#version 330 core
 
-		uniform sampler2D texture;
+		uniform sampler2D spriteTexture;
 
 		in vec2 frag_texcoord;
 		in vec4 frag_color;
@@ -43,10 +57,36 @@ std::string SpriteBatchFragSrc = R"glsl(
 
 		void main()
 		{
-			outColor = texture2D(texture, frag_texcoord) * frag_color;
+			outColor = texture(spriteTexture, frag_texcoord) * frag_color;
 		}
 	)glsl";
 
+// how many batches back a sprite may move to join one with its texture
+static const size_t kBatchLookback = 16;
+
+// cached text layouts not drawn for this many frames are dropped
+static const uint64_t kTextLayoutLifetime = 120;
+
+static uint64_t textLayoutKey(const Font* font, const std::string& text, const Vector2& position)
+{
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](const void* data, size_t size) {
+		const auto* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i) hash = (hash ^ bytes[i]) * 1099511628211ull;
+	};
+
+	mix(&font, sizeof(font));
+	mix(&position.X, sizeof(float));
+	mix(&position.Y, sizeof(float));
+	mix(text.data(), text.size());
+	return hash;
+}
+
+static bool overlaps(const Vector4& a, const Vector4& b)
+{
+	return a.X < b.Z && b.X < a.Z && a.Y < b.W && b.Y < a.W;
+}
+
 std::unique_ptr<GL::ShaderProgram> SpriteBatch::Shader = nullptr;
 
 GL::ShaderProgram& SpriteBatch::GetShader()
@@ -57,12 +97,48 @@ GL::ShaderProgram& SpriteBatch::GetShader()
 	return *Shader;
 }
 
+void SpriteBatch::ReleaseShaders()
+{
+	Shader.reset();
+}
+
 void SpriteBatch::DrawText(const Font* font, const std::string& text, const Vector2& position, const Vector4& colour)
 {
 	if (font == nullptr)
 		return;
 
-	Font::Glyph glyph;
+	// the clip rect decides which glyphs survive, don't cache that
+	if (_clipping)
+	{
+		LayoutText(font, text, position, colour);
+		return;
+	}
+
+	TextLayout& layout = _textLayouts[textLayoutKey(font, text, position)];
+	if (layout.font == font && layout.position == position && layout.text == text)
+	{
+		for (Sprite sprite : layout.sprites)
+		{
+			sprite._colour = colour;
+			_spritesToDraw.push_back(sprite);
+		}
+	}
+	else
+	{
+		const size_t first = _spritesToDraw.size();
+		LayoutText(font, text, position, colour);
+
+		layout.font = font;
+		layout.text = text;
+		layout.position = position;
+		layout.sprites.assign(_spritesToDraw.begin() + first, _spritesToDraw.end());
+	}
+
+	layout.lastUsed = _frame;
+}
+
+void SpriteBatch::LayoutText(const Font* font, const std::string& text, const Vector2& position, const Vector4& colour)
+{
 	Vector2 curPosition = position;
 	float fontHeight = font->GetHeight();
 
@@ -75,15 +151,16 @@ void SpriteBatch::DrawText(const Font* font, const std::string& text, const Vect
 			continue;
 		}
 
-		if (!font->TryGetGlyph(c, glyph))
+		const Font::Glyph* glyph = font->FindGlyph(static_cast<uint8_t>(c));
+		if (glyph == nullptr)
 			continue;
 
-		Texture* glyphTexture = font->GetTexture(glyph.textureId);
+		Texture* glyphTexture = font->GetTexture(glyph->textureId);
 
-		Draw(glyphTexture, curPosition + Vector2(glyph.leftBearing), Vector2(glyph.bottomLeftX, 1.0f - glyph.topRightY),
-		     Vector2(glyph.topRightX, 1.0f - glyph.bottomLeftY), Vector2(glyph.width, fontHeight), colour);
+		Draw(glyphTexture, curPosition + Vector2(glyph->leftBearing), Vector2(glyph->bottomLeftX, 1.0f - glyph->topRightY),
+		     Vector2(glyph->topRightX, 1.0f - glyph->bottomLeftY), Vector2(glyph->width, fontHeight), colour);
 
-		curPosition += Vector2(glyph.advance, 0);
+		curPosition += Vector2(glyph->advance, 0);
 	}
 }
 
@@ -98,26 +175,27 @@ SpriteBatch::Sprite::Sprite(Texture* texture, const Vector2& position, const Vec
 {
 }
 
-SpriteBatch::SpriteBatch(size_t maxSpriteCount): _clipping(false), _drawCallCount(0), _maxSpriteCount(maxSpriteCount)
+SpriteBatch::SpriteBatch(size_t maxSpriteCount)
+    : _clipping(false), _drawCallCount(0), _maxSpriteCount(maxSpriteCount), _frame(0)
 {
-	static const size_t vertSize = 8;
-	static const size_t faceVertCount = 6;
-	static const size_t vertStride = vertSize * sizeof(float);
+	static const size_t instanceStride = sizeof(SpriteInstance);
 
-	_vertexBuffer = std::make_unique<GL::VertexBuffer>(nullptr, _maxSpriteCount * faceVertCount, vertStride, GL_DYNAMIC_DRAW);
+	// one region holds a flush's worth of sprites, several flushes a frame share it
+	_instanceBuffer = std::make_unique<GL::StreamBuffer>(_maxSpriteCount * instanceStride);
 
-	GL::ArrayElement vertexLayout[] = {
-	    GL::ArrayElement(_vertexBuffer.get(), 0, 2, GL::AE_FLOAT, vertStride, 0),
-	    GL::ArrayElement(_vertexBuffer.get(), 1, 2, GL::AE_FLOAT, vertStride, 2 * sizeof(float)),
-	    GL::ArrayElement(_vertexBuffer.get(), 2, 4, GL::AE_FLOAT, vertStride, 4 * sizeof(float)),
+	GL::ArrayElement instanceLayout[] = {
+	    GL::ArrayElement(_instanceBuffer.get(), 0, 4, GL::AE_FLOAT, instanceStride, offsetof(SpriteInstance, rect), 1),
+	    GL::ArrayElement(_instanceBuffer.get(), 1, 4, GL::AE_FLOAT, instanceStride, offsetof(SpriteInstance, uv), 1),
+	    GL::ArrayElement(_instanceBuffer.get(), 2, 4, GL::AE_FLOAT, instanceStride, offsetof(SpriteInstance, colour), 1),
+	    GL::ArrayElement(_instanceBuffer.get(), 3, 2, GL::AE_FLOAT, instanceStride, offsetof(SpriteInstance, rotation), 1),
 	};
 
 	_vertexBinding = std::make_unique<GL::VertexBinding>();
-	_vertexBinding->Create(vertexLayout, 3, *_vertexBuffer);
-
-	_vertexData.resize(_maxSpriteCount * faceVertCount * vertSize);
+	_vertexBinding->Create(instanceLayout, 4);
 }
 
+SpriteBatch::~SpriteBatch() = default;
+
 void SpriteBatch::Draw(Texture* texture, const Vector2& position, float angle, const Vector4& colour)
 {
 	_spritesToDraw.push_back(Sprite(texture, position, Vector2(texture->GetSize()), angle, colour));
@@ -434,6 +512,18 @@ void SpriteBatch::Draw9Slice(Texture* texture, const Vector2& position, const Ve
 
 void SpriteBatch::Flush(const Matrix4x4& proj, float scale)
 {
+	_frame++;
+	if (_frame % kTextLayoutLifetime == 0)
+	{
+		for (auto it = _textLayouts.begin(); it != _textLayouts.end();)
+		{
+			if (_frame - it->second.lastUsed > kTextLayoutLifetime)
+				it = _textLayouts.erase(it);
+			else
+				++it;
+		}
+	}
+
 	if (_spritesToDraw.empty())
 	{
 		return;
@@ -441,105 +531,113 @@ void SpriteBatch::Flush(const Matrix4x4& proj, float scale)
 
 	_drawCallCount = 0;
 
-	glDisable(GL_DEPTH_TEST);
+	GL::StateCache::SetDepthTest(false);
 
 	GL::ShaderProgram& shader = GetShader();
 	shader.Bind();
 	shader.SetUniformValue("projMatrix", proj);
-
-	static const size_t vertSize = 8;
-	static const size_t faceVertCount = 6;
-	static const size_t vertStride = vertSize * sizeof(float);
-	static const uint32_t faceIndices[] = {0, 1, 2, 2, 3, 0};
-
-	size_t basePos = 0;
-	size_t maxSpriteBatch = _spritesToDraw.size();
-	if (maxSpriteBatch > _maxSpriteCount)
-	{
-		maxSpriteBatch = _maxSpriteCount;
-	}
+	shader.SetUniformValue("scale", scale);
 
 	_vertexBinding->Bind();
 
-	while (basePos < _spritesToDraw.size() && maxSpriteBatch > 0)
+	for (size_t chunk = 0; chunk < _spritesToDraw.size(); chunk += _maxSpriteCount)
 	{
-		size_t searchPos = basePos;
-		auto batchTexture = _spritesToDraw[basePos]._texture;
+		const size_t count = std::min(_maxSpriteCount, _spritesToDraw.size() - chunk);
+		BuildBatches(chunk, count);
 
-		while (searchPos < _spritesToDraw.size() && (searchPos - basePos) < maxSpriteBatch &&
-		       _spritesToDraw[searchPos]._texture == batchTexture)
-		{ searchPos++; }
+		size_t offset;
+		auto instances =
+		    static_cast<SpriteInstance*>(_instanceBuffer->Map(count * sizeof(SpriteInstance), sizeof(SpriteInstance), offset));
 
-		if (batchTexture != nullptr)
+		for (size_t i = 0; i < count; ++i)
 		{
-			batchTexture->Bind(0);
+			const Sprite& sprite = _spritesToDraw[chunk + i];
+			const float angle = Math::DegreesToRadians(sprite._angle);
+
+			SpriteInstance& instance = instances[_batches[_spriteBatches[i]].next++];
+			instance.rect = Vector4(sprite._position.X, sprite._position.Y, sprite._size.X, sprite._size.Y);
+			instance.uv = Vector4(sprite._uv1.X, sprite._uv1.Y, sprite._uv2.X, sprite._uv2.Y);
+			instance.colour = sprite._colour;
+			instance.rotation = Vector2(Math::Cos(angle), Math::Sin(angle));
 		}
 
-		for (size_t i = basePos; i < searchPos; ++i)
-		{
-			float* buffer = &_vertexData[(i - basePos) * faceVertCount * vertSize];
-			Sprite& sprite = _spritesToDraw[i];
+		_instanceBuffer->Unmap();
 
-			for (size_t j = 0; j < faceVertCount; ++j)
+		size_t first = offset / sizeof(SpriteInstance);
+		for (const Batch& batch : _batches)
+		{
+			if (batch.texture != nullptr)
 			{
-				buffer[4 + vertSize * j] = sprite._colour.X;
-				buffer[5 + vertSize * j] = sprite._colour.Y;
-				buffer[6 + vertSize * j] = sprite._colour.Z;
-				buffer[7 + vertSize * j] = sprite._colour.W;
+				batch.texture->Bind(0);
 			}
 
-			Vector2 vertexPositions[4] = {
-			    Vector2(-(sprite._size.X / 2), -(sprite._size.Y / 2)),
-			    Vector2(-(sprite._size.X / 2), sprite._size.Y / 2),
-			    Vector2(sprite._size.X / 2, sprite._size.Y / 2),
-			    Vector2(sprite._size.X / 2, -(sprite._size.Y / 2)),
-			};
-
-			Vector2 vertexTextureCoords[4] = {
-			    Vector2(sprite._uv1.X, sprite._uv1.Y),
-			    Vector2(sprite._uv1.X, sprite._uv2.Y),
-			    Vector2(sprite._uv2.X, sprite._uv2.Y),
-			    Vector2(sprite._uv2.X, sprite._uv1.Y),
-			};
-
-			for (size_t j = 0; j < 4; ++j)
-			{
-				float cosAngle = Math::Cos(Math::DegreesToRadians(sprite._angle));
-				float sinAngle = Math::Sin(Math::DegreesToRadians(sprite._angle));
+			GL::StateCache::CountDraw();
+			glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)batch.count, (GLuint)first);
 
-				Vector2 p = vertexPositions[j];
-				vertexPositions[j].X = p.X * cosAngle - p.Y * sinAngle;
-				vertexPositions[j].Y = p.Y * cosAngle + p.X * sinAngle;
-				vertexPositions[j] += sprite._position + (sprite._size * 0.5f);
-			}
+			first += batch.count;
+			_drawCallCount++;
+		}
+	}
 
-			for (size_t j = 0; j < faceVertCount; ++j)
-			{
-				size_t bufferIndex = j * vertSize;
-				size_t vertexIndex = faceIndices[j];
+	GL::StateCache::SetDepthTest(true);
 
-				buffer[bufferIndex] = vertexPositions[vertexIndex].X * scale;
-				buffer[bufferIndex + 1] = vertexPositions[vertexIndex].Y * scale;
-				buffer[bufferIndex + 2] = vertexTextureCoords[vertexIndex].X;
-				buffer[bufferIndex + 3] = vertexTextureCoords[vertexIndex].Y;
-			}
-		}
+	_spritesToDraw.clear();
+}
 
-		_vertexBuffer->UpdateBuffer(_vertexData.data(), 0, (searchPos - basePos) * faceVertCount * vertStride);
+void SpriteBatch::BuildBatches(size_t chunk, size_t count)
+{
+	static const uint32_t noBatch = ~0u;
 
-		glDrawArrays(GL_TRIANGLES, 0, (GLsizei)((searchPos - basePos) * faceVertCount));
+	_batches.clear();
+	_spriteBatches.resize(count);
 
-		_drawCallCount++;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const Sprite& sprite = _spritesToDraw[chunk + i];
 
-		basePos = searchPos;
-	}
+		// rotation is about the centre, the circle around the corners covers any angle
+		const Vector2 centre = sprite._position + sprite._size * 0.5f;
+		Vector2 extent = sprite._size * 0.5f;
+		if (sprite._angle != 0.0f)
+			extent = Vector2(extent.Length());
 
-	_vertexBinding->Unbind();
-	shader.Unbind();
+		const Vector4 bounds(centre.X - extent.X, centre.Y - extent.Y, centre.X + extent.X, centre.Y + extent.Y);
 
-	glEnable(GL_DEPTH_TEST);
+		// walk back to the newest batch with this texture, unless something in between would now be drawn over
+		uint32_t target = noBatch;
+		for (size_t j = _batches.size(); j-- > 0 && _batches.size() - j <= kBatchLookback;)
+		{
+			if (_batches[j].texture == sprite._texture)
+			{
+				target = static_cast<uint32_t>(j);
+				break;
+			}
 
-	_spritesToDraw.clear();
+			if (overlaps(_batches[j].bounds, bounds))
+				break;
+		}
+
+		if (target == noBatch)
+		{
+			target = static_cast<uint32_t>(_batches.size());
+			_batches.push_back(Batch {sprite._texture, bounds, 0, 0});
+		}
+		else
+		{
+			Vector4& b = _batches[target].bounds;
+			b = Vector4(std::min(b.X, bounds.X), std::min(b.Y, bounds.Y), std::max(b.Z, bounds.Z), std::max(b.W, bounds.W));
+		}
+
+		_batches[target].count++;
+		_spriteBatches[i] = target;
+	}
+
+	size_t next = 0;
+	for (Batch& batch : _batches)
+	{
+		batch.next = next;
+		next += batch.count;
+	}
 }
 
 bool SpriteBatch::IsSpriteInsideClippingRect(const Vector2& position, const Vector2& size)
@@ -6,10 +6,12 @@
 #include "Core/Math/Vector2.h"
 #include "Core/Math/Vector4.h"
 
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <stack>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace Donut
@@ -17,17 +19,22 @@ namespace Donut
 namespace GL
 {
 class VertexBinding;
-class VertexBuffer;
+class StreamBuffer;
 class ShaderProgram;
 } // namespace GL
 
+class Font;
 class Texture;
 
+// Sprites are drawn as instanced quads, one draw per texture batch. Flush groups sprites by texture, moving a sprite
+// ahead into an earlier batch of the same texture only when nothing drawn in between overlaps it, so the result
+// still matches submission order. Text layouts are cached by font, string and position across frames.
 class SpriteBatch
 {
 
 public:
 	SpriteBatch(size_t = 1000);
+	~SpriteBatch();
 
 	void Flush(const Matrix4x4&, float = 1.0f);
 	void DrawText(const class Font*, const std::string&, const Vector2&, const Vector4&);
@@ -46,6 +53,9 @@ public:
 
 	GL::ShaderProgram& GetShader();
 
+	// the shared sprite shader, while the context is still there to delete it
+	static void ReleaseShaders();
+
 private:
 	struct Sprite
 	{
@@ -61,6 +71,32 @@ private:
 		float _angle;
 	};
 
+	// per-instance attributes, the vertex shader builds the quad corners
+	struct SpriteInstance
+	{
+		Vector4 rect; // position, size
+		Vector4 uv;   // uv1, uv2
+		Vector4 colour;
+		Vector2 rotation; // cos, sin
+	};
+
+	struct Batch
+	{
+		Texture* texture;
+		Vector4 bounds; // min xy, max xy of everything in the batch
+		size_t count;
+		size_t next; // instance write cursor
+	};
+
+	struct TextLayout
+	{
+		const Font* font;
+		std::string text;
+		Vector2 position;
+		std::vector<Sprite> sprites;
+		uint64_t lastUsed;
+	};
+
 	struct Slice
 	{
 		Vector2 _uv1;
@@ -96,15 +132,22 @@ private:
 	static void TransformUV(Vector2&, const Vector2&, const Vector2&, const Vector2&);
 	static void TransformUVs(Slice&, const Vector2&, const Vector2&, const Vector2&);
 	bool IsSpriteInsideClippingRect(const Vector2&, const Vector2&);
+	void LayoutText(const Font*, const std::string&, const Vector2&, const Vector4&);
+	void BuildBatches(size_t, size_t);
 
 	std::vector<Sprite> _spritesToDraw;
 	bool _clipping;
 	Vector4 _clippingRect;
 	size_t _drawCallCount;
 	size_t _maxSpriteCount;
-	std::vector<float> _vertexData;
-	std::unique_ptr<GL::VertexBuffer> _vertexBuffer;
+	std::unique_ptr<GL::StreamBuffer> _instanceBuffer;
 	std::unique_ptr<GL::VertexBinding> _vertexBinding;
+	std::vector<Batch> _batches;
+	std::vector<uint32_t> _spriteBatches; // batch of each sprite in the chunk being flushed
+
+	// keyed by a hash of font, text and position; the entry holds them to confirm a hit
+	std::unordered_map<uint64_t, TextLayout> _textLayouts;
+	uint64_t _frame;
 
 	static std::unique_ptr<GL::ShaderProgram> Shader;
 };
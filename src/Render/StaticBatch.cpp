@@ -0,0 +1,225 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include "StaticBatch.h"
+
+#include "Core/Math/Frustum.h"
+#include "Game.h"
+#include "P3D/P3D.generated.h"
+#include "Render/CommandList.h"
+#include "Render/MeshOptimizer.h"
+#include "Render/OpenGL/IndexBuffer.h"
+#include "Render/OpenGL/ShaderProgram.h"
+#include "Render/OpenGL/StateCache.h"
+#include "Render/OpenGL/VertexBinding.h"
+#include "Render/OpenGL/VertexBuffer.h"
+#include "Render/Shader.h"
+#include "Render/ShaderVariants.h"
+#include "Render/TextureStreamer.h"
+#include "ResourceManager.h"
+
+#include <algorithm>
+
+namespace Donut
+{
+
+StaticBatch::StaticBatch() = default;
+
+StaticBatch::~StaticBatch() = default;
+
+void StaticBatch::Add(const P3D::Geometry& geometry)
+{
+	std::vector<Vertex> vertices;
+	std::vector<MeshOptimizer::PrimGroup> groups;
+
+	for (auto const& prim : geometry.GetPrimitiveGroups())
+	{
+		if (prim->GetVertices().empty() || prim->GetIndices().empty())
+			continue;
+
+		groups.push_back(PackPrimitiveGroup(*prim, vertices));
+	}
+
+	if (groups.empty())
+		return;
+
+	const auto remap = MeshOptimizer::Optimize(groups, vertices.size());
+	vertices = MeshOptimizer::RemapVertices(vertices, remap);
+
+	const uint32_t baseVertex = static_cast<uint32_t>(_vertices.size());
+	_vertices.insert(_vertices.end(), vertices.begin(), vertices.end());
+
+	for (auto& group : groups)
+	{
+		Vector3 boundsMin = vertices[group.indices[0]].pos;
+		Vector3 boundsMax = boundsMin;
+
+		// indices are rebased onto the shared vertex buffer so no base vertex is needed at draw time
+		for (auto& idx : group.indices)
+		{
+			const Vector3& pos = vertices[idx].pos;
+			boundsMin = Vector3(std::min(boundsMin.X, pos.X), std::min(boundsMin.Y, pos.Y), std::min(boundsMin.Z, pos.Z));
+			boundsMax = Vector3(std::max(boundsMax.X, pos.X), std::max(boundsMax.Y, pos.Y), std::max(boundsMax.Z, pos.Z));
+
+			idx += baseVertex;
+		}
+
+		_pending[{group.shaderName, group.mode}].emplace_back(std::move(group.indices), BoundingBox(boundsMin, boundsMax));
+	}
+}
+
+void StaticBatch::Commit()
+{
+	if (_pending.empty())
+		return;
+
+	std::vector<uint32_t> allIndices;
+	const std::size_t indexSize = GL::IndexBuffer::GetTypeSize(GL::IndexBuffer::GetIndexType(_vertices.size()));
+
+	// std::map keeps the batches sorted by shader, so drawing them in order groups texture/blend changes
+	for (auto& pending : _pending)
+	{
+		Batch batch {pending.first.first, pending.first.second, nullptr};
+		const bool merge = canMerge(batch.mode);
+
+		for (auto& range : pending.second)
+		{
+			const std::size_t offset = allIndices.size();
+			allIndices.insert(allIndices.end(), range.first.begin(), range.first.end());
+			batch.ranges.push_back(SubRange {offset, range.first.size(), range.second});
+
+			// every range of a batch is appended back to back, so lists collapse into one draw
+			if (merge && !batch.counts.empty())
+			{
+				batch.counts.back() += static_cast<GLsizei>(range.first.size());
+				continue;
+			}
+
+			batch.counts.push_back(static_cast<GLsizei>(range.first.size()));
+			batch.offsets.push_back(reinterpret_cast<const void*>(offset * indexSize));
+		}
+
+		_batches.push_back(std::move(batch));
+	}
+
+	_pending.clear();
+
+	_vertexBuffer = std::make_unique<GL::VertexBuffer>(_vertices.data(), _vertices.size(), sizeof(Vertex));
+	_indexBuffer = std::make_unique<GL::IndexBuffer>(allIndices, _vertices.size());
+
+	GL::ArrayElement vertexLayout[] = {
+	    GL::ArrayElement(_vertexBuffer.get(), 0, 3, GL::AE_FLOAT, sizeof(Vertex), offsetof(Vertex, pos)),
+	    GL::ArrayElement(_vertexBuffer.get(), 1, 2, GL::AE_HALF_FLOAT, sizeof(Vertex), offsetof(Vertex, uv)),
+	    GL::ArrayElement(_vertexBuffer.get(), 2, 4, GL::AE_UBYTE_NORM, sizeof(Vertex), offsetof(Vertex, color)),
+	};
+
+	_vertexBinding = std::make_unique<GL::VertexBinding>();
+	_vertexBinding->Create(vertexLayout, 3, *_indexBuffer, (GL::ElementType)_indexBuffer->GetType());
+
+	// the GPU has its copy now
+	_vertices.clear();
+	_vertices.shrink_to_fit();
+}
+
+void StaticBatch::Draw(ShaderVariants& shaders)
+{
+	if (_batches.empty())
+		return;
+
+	_vertexBinding->Bind();
+
+	for (auto& batch : _batches)
+	{
+		if (batch.cacheShader == nullptr)
+			batch.cacheShader = Game::GetInstance().GetResourceManager().GetShader(batch.shaderName);
+
+		if (!batch.cacheShader->IsAlphaTested() && batch.cacheShader->IsTranslucent())
+			continue;
+
+		shaders.Get(VertexColorFeature | batch.cacheShader->GetShaderFeatures()).Bind();
+		batch.cacheShader->Bind(0);
+
+		GL::StateCache::CountDraw();
+		glMultiDrawElements(batch.mode, batch.counts.data(), _indexBuffer->GetType(), batch.offsets.data(),
+		                    static_cast<GLsizei>(batch.counts.size()));
+	}
+}
+
+void StaticBatch::RecordTranslucent(CommandList& translucent, const Frustum& frustum, const Matrix4x4& viewProj)
+{
+	if (_batches.empty())
+		return;
+
+	const GLenum indexType = _indexBuffer->GetType();
+	const std::size_t indexSize = GL::IndexBuffer::GetTypeSize(indexType);
+
+	for (auto& batch : _batches)
+	{
+		if (batch.cacheShader == nullptr)
+			batch.cacheShader = Game::GetInstance().GetResourceManager().GetShader(batch.shaderName);
+
+		if (batch.cacheShader->IsAlphaTested() || !batch.cacheShader->IsTranslucent())
+			continue;
+
+		DrawItem item;
+		item.state.blend = true;
+		item.state.blendMode = batch.cacheShader->GetBlendMode();
+		item.features = VertexColorFeature | batch.cacheShader->GetShaderFeatures();
+		item.material = batch.cacheShader;
+		item.geometry = _vertexBinding.get();
+		item.primitive = batch.mode;
+		item.indexType = indexType;
+		item.object = CommandList::kIdentity;
+
+		for (const auto& range : batch.ranges)
+		{
+			const Vector3 min = range.bounds.GetMin();
+			const Vector3 max = range.bounds.GetMax();
+			const Vector3 centre = (min + max) * 0.5f;
+			if (!frustum.Intersects(BoundingSphere(centre, (max - min).Length() * 0.5f)))
+				continue;
+
+			// clip space w, the distance along the view direction
+			const float depth = viewProj.M[0][3] * centre.X + viewProj.M[1][3] * centre.Y +
+			                    viewProj.M[2][3] * centre.Z + viewProj.M[3][3];
+
+			item.indexCount = range.indicesCount;
+			item.indexOffset = range.indicesOffset * indexSize;
+			item.sortKey =
+			    CommandList::MakeTranslucentKey(item.state.blendMode, item.features, item.material, item.geometry, depth);
+			translucent.Draw(item);
+		}
+	}
+}
+
+void StaticBatch::RequestTextures(const TextureStreamer& streamer, const Frustum& frustum) const
+{
+	for (const auto& batch : _batches)
+	{
+		// resolved by the first Draw
+		if (batch.cacheShader == nullptr)
+			continue;
+
+		float largest = 0.0f;
+		for (const auto& range : batch.ranges)
+		{
+			const Vector3 min = range.bounds.GetMin();
+			const Vector3 max = range.bounds.GetMax();
+			const BoundingSphere sphere((min + max) * 0.5f, (max - min).Length() * 0.5f);
+
+			if (frustum.Intersects(sphere))
+				largest = std::max(largest, streamer.GetScreenSize(sphere));
+		}
+
+		streamer.Request(batch.cacheShader->GetDiffuseTexture(), largest);
+	}
+}
+
+std::size_t StaticBatch::GetSubRangeCount() const
+{
+	std::size_t count = 0;
+	for (auto const& batch : _batches) count += batch.ranges.size();
+
+	return count;
+}
+
+} // namespace Donut
@@ -0,0 +1,105 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include "Core/Math/BoundingBox.h"
+#include "Core/Math/Vector2.h"
+#include "Core/Math/Vector3.h"
+#include "Core/Math/Vector4.h"
+#include "Render/OpenGL/glad/glad.h"
+#include "Render/VertexPacking.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Donut
+{
+namespace GL
+{
+class VertexBuffer;
+class IndexBuffer;
+class VertexBinding;
+} // namespace GL
+
+namespace P3D
+{
+class Geometry;
+}
+
+class CommandList;
+class Frustum;
+class Matrix4x4;
+class Shader;
+class ShaderVariants;
+class TextureStreamer;
+
+// Merges the static geometry of a region into one vertex/index buffer pair, grouped by shader and primitive type.
+// Each group keeps a table of the index ranges that make it up and draws them in a single glMultiDrawElements.
+class StaticBatch
+{
+public:
+	struct SubRange
+	{
+		std::size_t indicesOffset;
+		std::size_t indicesCount;
+		BoundingBox bounds;
+	};
+
+	StaticBatch();
+	~StaticBatch();
+
+	// CPU side only until Commit
+	void Add(const P3D::Geometry& geometry);
+	void Commit();
+
+	// the opaque and alpha tested batches, the translucent ones only go through RecordTranslucent
+	void Draw(ShaderVariants& shaders);
+
+	// translucent ranges inside the frustum as separate draws keyed by their depth, so they can be sorted with
+	// everything else that blends
+	void RecordTranslucent(CommandList& translucent, const Frustum& frustum, const Matrix4x4& viewProj);
+
+	// asks for each shader's texture to suit the nearest of its ranges inside the frustum
+	void RequestTextures(const TextureStreamer& streamer, const Frustum& frustum) const;
+
+	bool IsEmpty() const { return _batches.empty(); }
+	std::size_t GetBatchCount() const { return _batches.size(); }
+	std::size_t GetSubRangeCount() const;
+
+private:
+	struct Vertex
+	{
+		Vector3 pos;
+		Half2 uv;
+		UByte4 color;
+	};
+
+	struct Batch
+	{
+		std::string shaderName;
+		GLenum mode;
+		Shader* cacheShader;
+		std::vector<SubRange> ranges;
+
+		// ranges flattened for glMultiDrawElements, neighbouring list ranges merged
+		std::vector<GLsizei> counts;
+		std::vector<const void*> offsets;
+	};
+
+	// strips can't be joined end to end without restart indices
+	static bool canMerge(GLenum mode) { return mode == GL_TRIANGLES || mode == GL_LINES; }
+
+	std::vector<Vertex> _vertices;
+	std::map<std::pair<std::string, GLenum>, std::vector<std::pair<std::vector<uint32_t>, BoundingBox>>> _pending;
+
+	std::vector<Batch> _batches;
+
+	std::unique_ptr<GL::VertexBuffer> _vertexBuffer;
+	std::unique_ptr<GL::IndexBuffer> _indexBuffer;
+	std::unique_ptr<GL::VertexBinding> _vertexBinding;
+};
+
+} // namespace Donut
@@ -1,43 +1,107 @@
 // Copyright 2019-2020 the donut authors. See AUTHORS.md
 
+#include <Core/JobSystem.h>
+#include <Game.h>
 #include <P3D/P3D.generated.h>
+#include <Render/OpenGL/DeletionQueue.h>
+#include <Render/OpenGL/StateCache.h>
 #include <Render/Texture.h>
+#include <Render/TextureStreamer.h>
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
 
 namespace Donut
 {
-Texture::Texture(const P3D::Texture& texture)
-    : _name(texture.GetName()), _width(texture.GetWidth()), _height(texture.GetHeight()), _glTexture(0)
+
+struct Texture::Decode
 {
-	// more mipmaps = more images?
-	assert(texture.GetNumMipMaps() == 1);
+	std::shared_ptr<const P3D::Texture> source;
+	std::vector<MipChain::Level> levels;
+	std::exception_ptr error;
+	JobSystem::Counter done;
+};
+
+Texture::Texture(const P3D::Texture& texture): Texture(texture.GetName(), Prepare(texture)) {}
 
-	// image handling code: move to own class?
-	auto const& image = texture.GetImage();
+Texture::Texture(std::string name, const std::vector<MipChain::Level>& levels)
+    : _name(std::move(name)), _width(levels.at(0).width), _height(levels.at(0).height), _glTexture(0)
+{
+	upload(levels);
+}
 
-	// generate the opengl texture, could probs do elsewhere but who cares
+Texture::Texture(std::string name, std::vector<MipChain::Level> levels, std::shared_ptr<const P3D::Texture> source,
+                 TextureStreamer& streamer)
+    : _name(std::move(name)), _width(levels.at(0).width), _height(levels.at(0).height), _glTexture(0),
+      _streamer(&streamer), _source(std::move(source)), _levels(std::move(levels))
+{
+	while (_initialLevel + 1 < _levels.size() &&
+	       std::max(_levels[_initialLevel].width, _levels[_initialLevel].height) > TextureStreamer::kInitialSize)
+		_initialLevel++;
+
+	_residentLevel = _initialLevel;
+	_wantedLevel = _initialLevel;
+
+	// mutable storage, so levels can come and go; the ones below the base level are never sampled
 	glGenTextures(1, &_glTexture);
-	glBindTexture(GL_TEXTURE_2D, _glTexture);
+	GL::StateCache::BindTexture(GL_TEXTURE_2D, _glTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(_levels.size() - 1));
+	for (uint32_t level = _initialLevel; level < _levels.size(); ++level) uploadLevel(level);
+	setBaseLevel(_initialLevel);
+	releaseLevels(_initialLevel);
 
-	switch (image->GetFormat())
-	{
-	case 1: // PNG
+	streamer.Register(*this);
+}
+
+std::vector<MipChain::Level> Texture::Prepare(const P3D::Texture& texture)
+{
+	std::vector<MipChain::Level> levels;
+
+	// the first image is the texture, any after it are authored mips
+	for (const auto& image : texture.GetImages())
 	{
-		auto imageData = P3D::ImageDecoder::Decode(image->GetData());
+		if (image->GetFormat() != 1) // PNG
+			throw std::runtime_error("non-png texture");
+
+		auto decoded = P3D::ImageDecoder::Decode(image->GetData());
+		const auto width = static_cast<uint32_t>(decoded.width);
+		const auto height = static_cast<uint32_t>(decoded.height);
 
-		if (imageData.comp == 4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, (GLsizei)_width, (GLsizei)_height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-			             imageData.data.data());
+		// a mip that doesn't halve the one before it can't be uploaded as the next level, build from there instead
+		if (!levels.empty() &&
+		    (width != std::max(levels.back().width / 2, 1u) || height != std::max(levels.back().height / 2, 1u)))
+			break;
+
+		MipChain::Level level {width, height, {}};
+		if (decoded.comp == 4)
+		{
+			level.rgba = std::move(decoded.data);
+		}
 		else
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, (GLsizei)_width, (GLsizei)_height, 0, GL_RGB, GL_UNSIGNED_BYTE,
-			             imageData.data.data());
+		{
+			// grey, grey + alpha or RGB out to RGBA
+			const int comp = decoded.comp;
+			level.rgba.resize(std::size_t(width) * height * 4);
+			for (std::size_t i = 0, pixels = std::size_t(width) * height; i < pixels; ++i)
+			{
+				const uint8_t* in = &decoded.data[i * comp];
+				uint8_t* out = &level.rgba[i * 4];
+				out[0] = in[0];
+				out[1] = comp >= 3 ? in[1] : in[0];
+				out[2] = comp >= 3 ? in[2] : in[0];
+				out[3] = comp == 2 ? in[1] : 255;
+			}
+		}
 
-		break;
-	}
-	default: throw std::runtime_error("non-png texture");
+		levels.push_back(std::move(level));
 	}
 
-	// generate mipmaps :)
-	glGenerateMipmap(GL_TEXTURE_2D);
+	if (levels.empty())
+		throw std::runtime_error("texture without an image");
+
+	MipChain::Build(levels);
+	return levels;
 }
 
 Texture::Texture(const P3D::Sprite& sprite)
@@ -83,27 +147,133 @@ Texture::Texture(const P3D::Sprite& sprite)
 		}
 	}
 
-	glGenTextures(1, &_glTexture);
-	glBindTexture(GL_TEXTURE_2D, _glTexture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, (GLsizei)_width, (GLsizei)_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
-	glGenerateMipmap(GL_TEXTURE_2D);
+	std::vector<MipChain::Level> levels {MipChain::Level {spriteWidth, spriteHeight, std::move(data)}};
+	MipChain::Build(levels);
+	upload(levels);
 }
 
 Texture::~Texture()
 {
-	if (_glTexture != 0)
-		glDeleteTextures(1, &_glTexture);
+	if (_streamer != nullptr)
+		_streamer->Unregister(*this);
+
+	GL::DeletionQueue::Retire(GL::DeletionQueue::Type::Texture, _glTexture);
+}
+
+void Texture::upload(const std::vector<MipChain::Level>& levels)
+{
+	glGenTextures(1, &_glTexture);
+	GL::StateCache::BindTexture(GL_TEXTURE_2D, _glTexture);
+
+	// immutable storage for the whole chain, then each level straight in
+	glTexStorage2D(GL_TEXTURE_2D, (GLsizei)levels.size(), GL_RGBA8, (GLsizei)levels[0].width, (GLsizei)levels[0].height);
+	for (std::size_t i = 0; i < levels.size(); ++i)
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, (GLint)i, 0, 0, (GLsizei)levels[i].width, (GLsizei)levels[i].height, GL_RGBA,
+		                GL_UNSIGNED_BYTE, levels[i].rgba.data());
+	}
+}
+
+std::size_t Texture::residentBytes() const
+{
+	std::size_t bytes = 0;
+	for (uint32_t level = _residentLevel; level < _levels.size(); ++level) bytes += levelBytes(level);
+	return bytes;
+}
+
+std::size_t Texture::cpuBytes() const
+{
+	std::size_t bytes = 0;
+	for (const auto& level : _levels) bytes += level.rgba.size();
+	if (_decode != nullptr && _decode->done.IsDone())
+		for (const auto& level : _decode->levels) bytes += level.rgba.size();
+
+	return bytes;
+}
+
+bool Texture::levelReady(uint32_t level)
+{
+	if (!_levels[level].rgba.empty())
+		return true;
+
+	if (_decode == nullptr)
+	{
+		// the whole chain again, it's built down from the top image; a job so the GL thread never waits on a decode
+		_decode = std::make_shared<Decode>();
+		_decode->source = _source;
+
+		auto& jobs = Game::GetInstance().GetJobSystem();
+		jobs.Run(_decode->done, [decode = _decode] {
+			try
+			{
+				decode->levels = Prepare(*decode->source);
+			}
+			catch (...)
+			{
+				decode->error = std::current_exception();
+			}
+		});
+
+		// nothing would ever pick it up otherwise
+		if (jobs.GetWorkerCount() == 0)
+			jobs.Wait(_decode->done);
+	}
+
+	if (!_decode->done.IsDone())
+		return false;
+
+	const std::shared_ptr<Decode> decode = std::move(_decode);
+	if (decode->error != nullptr)
+		std::rethrow_exception(decode->error);
+
+	// only what's still to go up, anything coarser is resident already
+	for (uint32_t i = _wantedLevel; i < _residentLevel; ++i) _levels[i].rgba = std::move(decode->levels[i].rgba);
+
+	return !_levels[level].rgba.empty();
+}
+
+void Texture::releaseLevels(uint32_t below)
+{
+	for (uint32_t level = 0; level < below && level < _levels.size(); ++level)
+		std::vector<uint8_t>().swap(_levels[level].rgba);
+
+	_decode.reset();
+}
+
+void Texture::uploadLevel(uint32_t level)
+{
+	MipChain::Level& source = _levels[level];
+
+	GL::StateCache::BindTexture(GL_TEXTURE_2D, _glTexture);
+	glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), GL_RGBA8, static_cast<GLsizei>(source.width),
+	             static_cast<GLsizei>(source.height), 0, GL_RGBA, GL_UNSIGNED_BYTE, source.rgba.data());
+
+	std::vector<uint8_t>().swap(source.rgba);
+}
+
+void Texture::freeLevel(uint32_t level)
+{
+	// an empty image gives the memory back, fine below the base level where completeness isn't checked
+	GL::StateCache::BindTexture(GL_TEXTURE_2D, _glTexture);
+	glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+}
+
+void Texture::setBaseLevel(uint32_t level)
+{
+	GL::StateCache::BindTexture(GL_TEXTURE_2D, _glTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(level));
 }
 
 void Texture::Bind() const
 {
-	glBindTexture(GL_TEXTURE_2D, _glTexture);
+	_bound = true;
+	GL::StateCache::BindTexture(GL_TEXTURE_2D, _glTexture);
 }
 
 void Texture::Bind(GLuint slot) const
 {
-	glActiveTexture(GL_TEXTURE0 + slot);
-	glBindTexture(GL_TEXTURE_2D, _glTexture);
+	_bound = true;
+	GL::StateCache::BindTexture(slot, GL_TEXTURE_2D, _glTexture);
 }
 
 } // namespace Donut
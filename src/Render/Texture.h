@@ -2,9 +2,12 @@
 
 #include "Core/Math/Vector2Int.h"
 #include "OpenGL/glad/glad.h"
+#include "Render/MipChain.h"
 
+#include <atomic>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace Donut
 {
@@ -16,13 +19,27 @@ class Sprite;
 class Texture;
 } // namespace P3D
 
+class TextureStreamer;
+
 class Texture
 {
 public:
 	Texture(const P3D::Texture&);
 	Texture(const P3D::Sprite&);
+
+	// uploads a finished chain a level at a time
+	Texture(std::string name, const std::vector<MipChain::Level>& levels);
+
+	// uploads only the coarse end of the chain and lets go of the pixels; the streamer decodes the finer levels from
+	// source again when they're needed
+	Texture(std::string name, std::vector<MipChain::Level> levels, std::shared_ptr<const P3D::Texture> source,
+	        TextureStreamer& streamer);
 	~Texture();
 
+	// the CPU half of loading: decodes the image and any authored mips, then builds the rest of the chain; no GL, so
+	// loaders run it on the job system and only the upload is left for the GL thread
+	static std::vector<MipChain::Level> Prepare(const P3D::Texture&);
+
 	void Bind() const;
 	void Bind(GLuint slot) const;
 
@@ -33,12 +50,45 @@ public:
 	// bool HasAlpha() const;
 	GLuint GetOpenGLHandle() const { return _glTexture; }
 
+	bool IsStreamed() const { return _streamer != nullptr; }
+	uint32_t GetResidentLevel() const { return _residentLevel; }
+
 protected:
+	friend class TextureStreamer;
+
+	struct Decode;
+
+	void upload(const std::vector<MipChain::Level>& levels);
+
+	// streamed textures only, GL thread
+	std::size_t levelBytes(uint32_t level) const { return std::size_t(_levels[level].width) * _levels[level].height * 4; }
+	std::size_t residentBytes() const;
+	std::size_t cpuBytes() const;
+	bool levelReady(uint32_t level); // starts decoding the source when the pixels aren't there, true once they are
+	void releaseLevels(uint32_t below); // drops the pixels of the levels finer than below and any decode in flight
+	void uploadLevel(uint32_t level);   // and drops its pixels, they're on the GPU now
+	void freeLevel(uint32_t level);
+	void setBaseLevel(uint32_t level);
+
 	std::string _name;
 	std::size_t _width;
 	std::size_t _height;
 
 	GLuint _glTexture;
+
+	// streaming state, TextureStreamer owns what these mean
+	TextureStreamer* _streamer = nullptr;
+	std::shared_ptr<const P3D::Texture> _source; // still encoded
+	std::vector<MipChain::Level> _levels;        // the whole chain, pixels only while a level waits to go up
+	std::shared_ptr<Decode> _decode;             // shared with the job, which may finish after the texture is gone
+	uint32_t _initialLevel = 0;                  // always resident
+	uint32_t _residentLevel = 0;                 // finest level on the GPU, GL_TEXTURE_BASE_LEVEL
+	uint32_t _wantedLevel = 0;
+	uint32_t _priority = 0;
+	uint64_t _lastSeen = 0;
+	bool _measured = false;
+	mutable bool _bound = false;
+	mutable std::atomic<uint32_t> _requestedSize {0}; // largest screen size asked for this frame
 };
 
 } // namespace Donut
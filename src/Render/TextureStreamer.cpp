@@ -0,0 +1,219 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include "TextureStreamer.h"
+
+#include "Core/Math/BoundingSphere.h"
+#include "Core/Math/Matrix4x4.h"
+#include "Render/Texture.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace Donut
+{
+
+TextureStreamer::TextureStreamer(std::size_t budgetBytes, std::size_t uploadBytesPerFrame)
+    : _budget(budgetBytes), _uploadBytesPerFrame(uploadBytesPerFrame), _cameraPosition(0.0f), _pixelsPerUnit(0.0f),
+      _viewportHeight(0.0f), _frame(0), _residentBytes(0), _cpuBytes(0), _streamingCount(0), _uploadedLastFrame(0)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	// whatever outlives us stops reporting in
+	for (Texture* texture : _textures) texture->_streamer = nullptr;
+}
+
+void TextureStreamer::Register(Texture& texture)
+{
+	_textures.push_back(&texture);
+	_residentBytes += texture.residentBytes();
+}
+
+void TextureStreamer::Unregister(Texture& texture)
+{
+	const auto it = std::find(_textures.begin(), _textures.end(), &texture);
+	assert(it != _textures.end());
+
+	_residentBytes -= texture.residentBytes();
+	*it = _textures.back();
+	_textures.pop_back();
+}
+
+void TextureStreamer::BeginFrame(const Vector3& cameraPosition, const Matrix4x4& proj, int viewportHeight)
+{
+	_cameraPosition = cameraPosition;
+	_viewportHeight = static_cast<float>(viewportHeight);
+	_pixelsPerUnit = proj.M[1][1] * _viewportHeight * 0.5f;
+}
+
+float TextureStreamer::GetScreenSize(const BoundingSphere& sphere) const
+{
+	const float distance = (sphere.GetCenter() - _cameraPosition).Length();
+	const float radius = sphere.GetRadius();
+
+	// from inside it could be covering the whole screen
+	if (distance <= radius)
+		return _viewportHeight;
+
+	return 2.0f * radius * _pixelsPerUnit / distance;
+}
+
+void TextureStreamer::Request(const Texture* texture, float screenSize) const
+{
+	if (texture == nullptr || texture->_streamer == nullptr || !(screenSize >= 1.0f))
+		return;
+
+	const uint32_t size = static_cast<uint32_t>(std::min(screenSize, 65536.0f));
+	uint32_t current = texture->_requestedSize.load(std::memory_order_relaxed);
+	while (current < size && !texture->_requestedSize.compare_exchange_weak(current, size, std::memory_order_relaxed)) {}
+}
+
+uint32_t TextureStreamer::levelForSize(const Texture& texture, uint32_t screenSize)
+{
+	// a texel per pixel across the object, assuming the texture spans it once
+	uint32_t level = 0;
+	std::size_t size = std::max(texture._width, texture._height);
+	while (level < texture._initialLevel && size / 2 >= screenSize)
+	{
+		size /= 2;
+		level++;
+	}
+
+	return level;
+}
+
+void TextureStreamer::Update()
+{
+	_frame++;
+
+	// what each texture would like before the budget has its say
+	std::size_t wantedBytes = 0;
+	for (Texture* texture : _textures)
+	{
+		const uint32_t requested = texture->_requestedSize.exchange(0, std::memory_order_relaxed);
+		const bool bound = texture->_bound;
+		texture->_bound = false;
+
+		texture->_priority = 0;
+
+		if (requested > 0)
+		{
+			texture->_measured = true;
+			texture->_lastSeen = _frame;
+			texture->_priority = requested;
+			texture->_wantedLevel = levelForSize(*texture, requested);
+		}
+		else if (bound && !texture->_measured)
+		{
+			texture->_lastSeen = _frame;
+			texture->_priority = UINT32_MAX;
+			texture->_wantedLevel = 0;
+		}
+		else if (_frame - texture->_lastSeen > kKeepFrames)
+		{
+			texture->_wantedLevel = texture->_initialLevel;
+		}
+		// otherwise it keeps what it wanted last, it's likely back on screen soon
+
+		for (uint32_t level = texture->_wantedLevel; level < texture->_levels.size(); ++level)
+			wantedBytes += texture->levelBytes(level);
+	}
+
+	// over budget, the finest wanted levels give way until it fits, those buying the least screen size per byte first:
+	// unseen textures before anything on screen, a big level far away before a small one close up
+	if (wantedBytes > _budget)
+	{
+		const auto value = [](const Texture* texture) {
+			return static_cast<double>(texture->_priority) / texture->levelBytes(texture->_wantedLevel);
+		};
+		const auto greater = [](const Trim& a, const Trim& b) { return a.value > b.value; };
+
+		_trims.clear();
+		for (Texture* texture : _textures)
+		{
+			if (texture->_wantedLevel < texture->_initialLevel)
+				_trims.push_back(Trim {value(texture), texture});
+		}
+		std::make_heap(_trims.begin(), _trims.end(), greater);
+
+		while (wantedBytes > _budget && !_trims.empty())
+		{
+			std::pop_heap(_trims.begin(), _trims.end(), greater);
+			Texture* texture = _trims.back().texture;
+			_trims.pop_back();
+
+			wantedBytes -= texture->levelBytes(texture->_wantedLevel);
+			texture->_wantedLevel++;
+
+			if (texture->_wantedLevel < texture->_initialLevel)
+			{
+				_trims.push_back(Trim {value(texture), texture});
+				std::push_heap(_trims.begin(), _trims.end(), greater);
+			}
+		}
+	}
+
+	// drops before uploads, so the uploads have the room
+	for (Texture* texture : _textures)
+	{
+		if (texture->_residentLevel >= texture->_wantedLevel)
+			continue;
+
+		_residentBytes -= texture->residentBytes();
+		texture->setBaseLevel(texture->_wantedLevel);
+		for (uint32_t level = texture->_residentLevel; level < texture->_wantedLevel; ++level) texture->freeLevel(level);
+		texture->_residentLevel = texture->_wantedLevel;
+		_residentBytes += texture->residentBytes();
+	}
+
+	// then one level per texture per round, largest on screen first, until this frame's share is used up; a level is
+	// only usable once every level below it is in, so each texture works its way up from the coarse end
+	_order = _textures;
+	std::stable_sort(_order.begin(), _order.end(),
+	                 [](const Texture* a, const Texture* b) { return a->_priority > b->_priority; });
+
+	_uploadedLastFrame = 0;
+	bool uploaded = true;
+	while (uploaded && _uploadedLastFrame < _uploadBytesPerFrame)
+	{
+		uploaded = false;
+		for (Texture* texture : _order)
+		{
+			if (_uploadedLastFrame >= _uploadBytesPerFrame)
+				break;
+
+			if (texture->_residentLevel <= texture->_wantedLevel)
+				continue;
+
+			// still being decoded, the rest go ahead meanwhile
+			const uint32_t level = texture->_residentLevel - 1;
+			if (!texture->levelReady(level))
+				continue;
+
+			texture->uploadLevel(level);
+			texture->setBaseLevel(level);
+			texture->_residentLevel = level;
+
+			_residentBytes += texture->levelBytes(level);
+			_uploadedLastFrame += texture->levelBytes(level);
+			uploaded = true;
+		}
+	}
+
+	// once a texture has what it wants its pixels go, whatever a decode brought in that the budget then took away
+	_streamingCount = 0;
+	_cpuBytes = 0;
+	for (Texture* texture : _textures)
+	{
+		if (texture->_residentLevel > texture->_wantedLevel)
+			_streamingCount++;
+		else
+			texture->releaseLevels(texture->_residentLevel);
+
+		_cpuBytes += texture->cpuBytes();
+	}
+}
+
+} // namespace Donut
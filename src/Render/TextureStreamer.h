@@ -0,0 +1,92 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include "Core/Math/Vector3.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Donut
+{
+
+class BoundingSphere;
+class Matrix4x4;
+class Texture;
+
+// Keeps the fine mip levels of streamed textures on the GPU only while something on screen is big enough to need them.
+// A streamed texture starts out with the levels up to kInitialSize, the draw paths report how many pixels each
+// texture's users cover once they're culled (Request), and once a frame Update turns that into the level each texture
+// wants, trims the wants to the memory budget and uploads the difference a level at a time. GL_TEXTURE_BASE_LEVEL
+// always points at a texture's finest resident level, so sampling never reaches for one that isn't there yet.
+// A texture that's bound but never requested has no size to go by and gets its whole chain.
+// Textures keep their source encoded rather than the decoded chain: a level that's wanted again is decoded on the
+// job system and uploads once that's done, and no pixels are held on to once they're on the GPU.
+class TextureStreamer
+{
+public:
+	static constexpr uint32_t kInitialSize = 64;  // the largest level a streamed texture starts out with
+	static constexpr uint64_t kKeepFrames = 120; // how long an unseen texture holds on to its levels
+
+	TextureStreamer(std::size_t budgetBytes, std::size_t uploadBytesPerFrame);
+	~TextureStreamer();
+
+	// no copying
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	// by the texture itself, GL thread
+	void Register(Texture&);
+	void Unregister(Texture&);
+
+	// GL thread, before the frame is culled: what screen sizes are measured against
+	void BeginFrame(const Vector3& cameraPosition, const Matrix4x4& proj, int viewportHeight);
+
+	// the height in pixels a world space sphere covers this frame
+	float GetScreenSize(const BoundingSphere& sphere) const;
+
+	// something drawn with texture covers screenSize pixels, the largest request of the frame counts; any thread,
+	// textures that aren't streamed are ignored
+	void Request(const Texture* texture, float screenSize) const;
+
+	// GL thread, once the frame's draws are issued
+	void Update();
+
+	std::size_t GetBudget() const { return _budget; }
+	std::size_t GetResidentBytes() const { return _residentBytes; }
+	std::size_t GetCpuBytes() const { return _cpuBytes; } // decoded pixels waiting to go up
+	std::size_t GetTextureCount() const { return _textures.size(); }
+	std::size_t GetStreamingCount() const { return _streamingCount; }
+	std::size_t GetUploadedLastFrame() const { return _uploadedLastFrame; }
+
+private:
+	struct Trim
+	{
+		double value; // screen size per byte of the texture's finest wanted level
+		Texture* texture;
+	};
+
+	// the finest level worth having for a texture drawn screenSize pixels high
+	static uint32_t levelForSize(const Texture& texture, uint32_t screenSize);
+
+	std::size_t _budget;
+	std::size_t _uploadBytesPerFrame;
+	std::vector<Texture*> _textures;
+
+	// scratch for Update
+	std::vector<Trim> _trims;
+	std::vector<Texture*> _order;
+
+	Vector3 _cameraPosition;
+	float _pixelsPerUnit; // screen pixels a unit covers one unit in front of the camera
+	float _viewportHeight;
+	uint64_t _frame;
+
+	std::size_t _residentBytes;
+	std::size_t _cpuBytes;
+	std::size_t _streamingCount;
+	std::size_t _uploadedLastFrame;
+};
+
+} // namespace Donut
@@ -0,0 +1,111 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#include <Render/OpenGL/ShaderProgram.h>
+#include <Render/OpenGL/StorageBuffer.h>
+#include <Render/OpenGL/StreamBuffer.h>
+#include <Render/OpenGL/UniformBuffer.h>
+#include <Render/UniformBlocks.h>
+
+#include <cassert>
+#include <cstring>
+
+namespace Donut
+{
+
+void BindUniformBlocks(GL::ShaderProgram& program)
+{
+	program.BindUniformBlock("FrameBlock", FrameBlockBinding);
+	program.BindUniformBlock("ObjectBlock", ObjectBlockBinding);
+}
+
+FrameUniforms::FrameUniforms(): _buffer(std::make_unique<GL::UniformBuffer>(sizeof(FrameBlock))) {}
+
+FrameUniforms::~FrameUniforms() = default;
+
+void FrameUniforms::Update(const Matrix4x4& view, const Matrix4x4& proj, double time, double deltaTime)
+{
+	_block.view = view;
+	_block.proj = proj;
+	_block.viewProj = proj * view;
+	_block.time = Vector4(static_cast<float>(time), static_cast<float>(deltaTime), 0.0f, 0.0f);
+
+	_buffer->Orphan();
+	_buffer->UpdateBuffer(&_block, 0, sizeof(FrameBlock));
+	_buffer->BindBase(FrameBlockBinding);
+}
+
+ObjectUniformRing::ObjectUniformRing(std::size_t capacity)
+    : _alignment(GL::UniformBuffer::GetOffsetAlignment()), _storageAlignment(GL::StorageBuffer::GetOffsetAlignment()),
+      _capacity(capacity)
+{
+	assert(capacity > 0);
+
+	_stride = ((sizeof(ObjectBlock) + _alignment - 1) / _alignment) * _alignment;
+	_buffer = std::make_unique<GL::StreamBuffer>(_stride * capacity);
+
+	_identity = std::make_unique<GL::UniformBuffer>(sizeof(ObjectBlock), GL_STATIC_DRAW);
+	_identity->UpdateBuffer(&Matrix4x4::Identity, 0, sizeof(ObjectBlock));
+}
+
+ObjectUniformRing::~ObjectUniformRing() = default;
+
+void ObjectUniformRing::BeginFrame()
+{
+	_buffer->NextRegion();
+}
+
+void ObjectUniformRing::Push(const Matrix4x4& model)
+{
+	std::size_t offset;
+	std::memcpy(_buffer->Map(sizeof(ObjectBlock), _alignment, offset), &model, sizeof(ObjectBlock));
+	_buffer->Unmap();
+
+	_buffer->BindRange(GL_UNIFORM_BUFFER, ObjectBlockBinding, offset, sizeof(ObjectBlock));
+}
+
+void ObjectUniformRing::PushIdentity() const
+{
+	_identity->BindRange(ObjectBlockBinding, 0, sizeof(ObjectBlock));
+}
+
+std::size_t ObjectUniformRing::Upload(const ObjectBlock* blocks, std::size_t count)
+{
+	assert(count > 0 && count <= _capacity);
+
+	std::size_t offset;
+	auto* dest = static_cast<uint8_t*>(_buffer->Map(_stride * count, _alignment, offset));
+	for (std::size_t i = 0; i < count; ++i) std::memcpy(dest + i * _stride, &blocks[i], sizeof(ObjectBlock));
+	_buffer->Unmap();
+
+	return offset;
+}
+
+void ObjectUniformRing::Bind(std::size_t base, std::size_t index) const
+{
+	_buffer->BindRange(GL_UNIFORM_BUFFER, ObjectBlockBinding, base + index * _stride, sizeof(ObjectBlock));
+}
+
+std::size_t ObjectUniformRing::UploadInstances(const Matrix4x4* transforms, std::size_t count)
+{
+	assert(count > 0 && count <= GetInstanceCapacity());
+
+	// std430 mat4 array, no padding between elements
+	std::size_t offset;
+	std::memcpy(_buffer->Map(count * sizeof(Matrix4x4), _storageAlignment, offset), transforms, count * sizeof(Matrix4x4));
+	_buffer->Unmap();
+
+	return offset;
+}
+
+std::size_t ObjectUniformRing::GetInstanceCapacity() const
+{
+	// a mapping never spans regions
+	return _buffer->GetRegionSize() / sizeof(Matrix4x4);
+}
+
+void ObjectUniformRing::BindInstances(std::size_t base, std::size_t count) const
+{
+	_buffer->BindRange(GL_SHADER_STORAGE_BUFFER, InstanceTransformsBinding, base, count * sizeof(Matrix4x4));
+}
+
+} // namespace Donut
@@ -0,0 +1,104 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include "Core/Math/Matrix4x4.h"
+#include "Core/Math/Vector4.h"
+#include "Render/OpenGL/glad/glad.h"
+
+#include <cstddef>
+#include <memory>
+
+namespace Donut
+{
+
+namespace GL
+{
+class ShaderProgram;
+class StreamBuffer;
+class UniformBuffer;
+} // namespace GL
+
+// binding points shared by every program, see BindUniformBlocks
+enum UniformBlockBinding : GLuint
+{
+	FrameBlockBinding = 0,
+	ObjectBlockBinding = 1,
+};
+
+// shader storage binding points, see world.vert
+enum StorageBlockBinding : GLuint
+{
+	InstanceTransformsBinding = 0, // mat4 transforms[] of the INSTANCED variants
+};
+
+// layout(std140) uniform FrameBlock, keep in sync with the shaders
+struct FrameBlock
+{
+	Matrix4x4 view;
+	Matrix4x4 proj;
+	Matrix4x4 viewProj;
+	Vector4 time; // x = seconds since start, y = frame delta
+};
+
+// layout(std140) uniform ObjectBlock
+struct ObjectBlock
+{
+	Matrix4x4 model;
+};
+
+static_assert(sizeof(FrameBlock) == 208, "FrameBlock must match the std140 layout");
+static_assert(sizeof(ObjectBlock) == 64, "ObjectBlock must match the std140 layout");
+
+// hook up whichever of the shared blocks the program declares
+void BindUniformBlocks(GL::ShaderProgram& program);
+
+// per-frame data, uploaded and bound once for all programs
+class FrameUniforms
+{
+public:
+	FrameUniforms();
+	~FrameUniforms();
+
+	void Update(const Matrix4x4& view, const Matrix4x4& proj, double time, double deltaTime);
+	const FrameBlock& GetBlock() const { return _block; }
+
+private:
+	std::unique_ptr<GL::UniformBuffer> _buffer;
+	FrameBlock _block;
+};
+
+// Per-draw object data, written front to back into a mapped stream buffer and bound with glBindBufferRange.
+// Each frame starts on a fresh region, the fences keep us off ranges an in-flight draw is still reading.
+class ObjectUniformRing
+{
+public:
+	explicit ObjectUniformRing(std::size_t capacity);
+	~ObjectUniformRing();
+
+	void BeginFrame();
+
+	// uploads the block and binds it to ObjectBlockBinding for the next draw
+	void Push(const Matrix4x4& model);
+	void PushIdentity() const;
+
+	// uploads count blocks in one go and returns the base to Bind them by index with
+	std::size_t Upload(const ObjectBlock* blocks, std::size_t count);
+	void Bind(std::size_t base, std::size_t index) const;
+
+	// instanced draws: count transforms packed together, bound as the INSTANCED transforms buffer so an instance
+	// index of i reads transforms[i]
+	std::size_t UploadInstances(const Matrix4x4* transforms, std::size_t count); // count up to GetInstanceCapacity
+	std::size_t GetInstanceCapacity() const;
+	void BindInstances(std::size_t base, std::size_t count) const;
+
+private:
+	std::unique_ptr<GL::StreamBuffer> _buffer;
+	std::unique_ptr<GL::UniformBuffer> _identity; // for things already in world space, never changes
+	std::size_t _alignment;
+	std::size_t _storageAlignment;
+	std::size_t _stride;
+	std::size_t _capacity;
+};
+
+} // namespace Donut
@@ -0,0 +1,173 @@
+// Copyright 2019-2020 the donut authors. See AUTHORS.md
+
+#pragma once
+
+#include "Core/Math/Vector2.h"
+#include "Core/Math/Vector3.h"
+#include "Core/Math/Vector4.h"
+#include "P3D/P3D.generated.h"
+#include "Render/MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace Donut
+{
+
+// Quantised vertex attribute types, the matching GL::ElementType is noted on each.
+
+struct Half2 // AE_HALF_FLOAT x2
+{
+	uint16_t x, y;
+};
+
+struct Snorm16x2 // AE_SHORT_NORM x2
+{
+	int16_t x, y;
+};
+
+struct UByte4 // AE_UBYTE_NORM / AE_UBYTE x4
+{
+	uint8_t x, y, z, w;
+};
+
+inline uint16_t FloatToHalf(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+	uint32_t abs = bits & 0x7FFFFFFF;
+
+	// out of range, infinity or nan
+	if (abs >= 0x47800000)
+		return sign | (abs > 0x7F800000 ? 0x7E00 : 0x7C00);
+
+	// denormal, shift the mantissa (with its implicit bit) down and round
+	if (abs < 0x38800000)
+	{
+		if (abs < 0x33000000)
+			return sign;
+
+		const uint32_t mantissa = (abs & 0x7FFFFF) | 0x800000;
+		const uint32_t shift = 126 - (abs >> 23);
+		return sign | static_cast<uint16_t>((mantissa >> shift) + ((mantissa >> (shift - 1)) & 1));
+	}
+
+	// rebias the exponent and round to nearest even
+	abs += 0xC8000FFF + ((abs >> 13) & 1);
+	return sign | static_cast<uint16_t>(abs >> 13);
+}
+
+inline int16_t PackSnorm16(float value)
+{
+	return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+inline uint8_t PackUnorm8(float value)
+{
+	return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+inline UByte4 PackColor(const Vector4& color)
+{
+	return UByte4 {PackUnorm8(color.X), PackUnorm8(color.Y), PackUnorm8(color.Z), PackUnorm8(color.W)};
+}
+
+// Octahedral normal: project onto the octahedron and fold the lower half over, see OctDecode in world.vert
+inline Snorm16x2 OctEncode(const Vector3& normal)
+{
+	const float l1 = std::abs(normal.X) + std::abs(normal.Y) + std::abs(normal.Z);
+	if (l1 <= 0.0f)
+		return Snorm16x2 {0, 0};
+
+	float x = normal.X / l1, y = normal.Y / l1;
+	if (normal.Z < 0.0f)
+	{
+		const float fx = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		const float fy = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = fx;
+		y = fy;
+	}
+
+	return Snorm16x2 {PackSnorm16(x), PackSnorm16(y)};
+}
+
+// 8-bit weights that still sum to exactly one, the first weight takes the rounding error
+inline UByte4 PackWeights(const Vector3& weights)
+{
+	const uint8_t w1 = PackUnorm8(weights.Y), w2 = PackUnorm8(std::min(weights.Z, 1.0f - w1 / 255.0f));
+	return UByte4 {static_cast<uint8_t>(255 - w1 - w2), w1, w2, 0};
+}
+
+// P3D uvs flipped into GL's convention and packed to halfs. Groups tiled far from the origin are shifted back by a
+// whole number of tiles, where a half still has sub-texel precision; anything near [0, 1] is left alone so clamped
+// textures sample the same texels.
+inline std::vector<Half2> PackUVs(const std::vector<Vector2>& uvs)
+{
+	float minU = 0.0f, minV = 0.0f;
+	if (!uvs.empty())
+	{
+		minU = uvs[0].X;
+		minV = 1.0f - uvs[0].Y;
+		for (auto const& uv : uvs)
+		{
+			minU = std::min(minU, uv.X);
+			minV = std::min(minV, 1.0f - uv.Y);
+		}
+	}
+
+	float originU = std::floor(minU), originV = std::floor(minV);
+	if (std::abs(originU) < 2.0f)
+		originU = 0.0f;
+	if (std::abs(originV) < 2.0f)
+		originV = 0.0f;
+
+	std::vector<Half2> packed;
+	packed.reserve(uvs.size());
+	for (auto const& uv : uvs) packed.push_back(Half2 {FloatToHalf(uv.X - originU), FloatToHalf(1.0f - uv.Y - originV)});
+
+	return packed;
+}
+
+// Appends a P3D primitive group's vertices to vertices as position, packed uv and packed colour (white where the group
+// has none) and returns the group with its GL mode and its indices rebased onto them. VertexType is any of the
+// {pos, uv, color} world vertex layouts.
+template <typename VertexType>
+MeshOptimizer::PrimGroup PackPrimitiveGroup(const P3D::PrimitiveGroup& prim, std::vector<VertexType>& vertices)
+{
+	auto const& verts = prim.GetVertices();
+	auto const& colors = prim.GetColors();
+	const auto uvs = PackUVs(prim.GetUvs(0));
+	const bool hasColors = !colors.empty();
+	const uint32_t vertOffset = static_cast<uint32_t>(vertices.size());
+
+	for (uint32_t i = 0; i < verts.size(); i++)
+	{
+		vertices.push_back(VertexType {
+		    verts[i],
+		    uvs[i],
+		    hasColors ? PackColor(P3D::P3DUtil::ConvertColor(colors[i])) : UByte4 {255, 255, 255, 255},
+		});
+	}
+
+	GLenum mode = GL_TRIANGLE_STRIP;
+	switch ((P3D::PrimitiveType)prim.GetPrimType())
+	{
+	case P3D::PrimitiveType::TriangleStrip: mode = GL_TRIANGLE_STRIP; break;
+	case P3D::PrimitiveType::TriangleList: mode = GL_TRIANGLES; break;
+	case P3D::PrimitiveType::LineStrip: mode = GL_LINE_STRIP; break;
+	case P3D::PrimitiveType::LineList: mode = GL_LINES; break;
+	}
+
+	MeshOptimizer::PrimGroup group {prim.GetShaderName(), mode, {}};
+	group.indices.reserve(prim.GetIndices().size());
+	for (auto const& idx : prim.GetIndices()) group.indices.push_back(idx + vertOffset);
+
+	return group;
+}
+
+} // namespace Donut
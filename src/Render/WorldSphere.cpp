@@ -5,6 +5,7 @@
 #include "Game.h"
 #include "Render/LineRenderer.h"
 #include "Render/SkinAnimation.h"
+#include "Render/UniformBlocks.h"
 #include "Skeleton.h"
 
 namespace Donut
@@ -138,16 +139,19 @@ WorldSphere::WorldSphere(const P3D::WorldSphere& worldSphere): _name(worldSphere
 	// Lens Flare
 }
 
-void WorldSphere::Draw(GL::ShaderProgram& shader, const Matrix4x4& viewProj, bool opaque) const
+void WorldSphere::Draw(ShaderVariants& shaders, bool opaque, const std::vector<Matrix4x4>& joints) const
 {
+	auto& objectUniforms = Game::GetInstance().GetObjectUniforms();
 	for (auto const& prop : _props)
 	{
-		const auto& joint = _skeleton->GetJoint(prop.skeleton_joint);
-		shader.SetUniformValue("viewProj", viewProj * joint.finalGlobal);
-		prop.mesh->Draw(shader, opaque);
+		if (static_cast<std::size_t>(prop.skeleton_joint) >= joints.size())
+			continue;
+
+		objectUniforms.Push(joints[prop.skeleton_joint]);
+		prop.mesh->Draw(shaders, opaque);
 	}
 
-	shader.SetUniformValue("viewProj", viewProj);
+	objectUniforms.PushIdentity();
 }
 
 void WorldSphere::Update(double deltatime)
@@ -160,4 +164,12 @@ void WorldSphere::Update(double deltatime)
 	// Game::GetInstance().GetLineRenderer().DrawSkeleton(Vector3(0.0, 0.0, 0.0), *_skeleton);
 }
 
+void WorldSphere::CopyJoints(std::vector<Matrix4x4>& joints) const
+{
+	auto const& skeletonJoints = _skeleton->GetJoints();
+
+	joints.resize(skeletonJoints.size());
+	for (std::size_t i = 0; i < skeletonJoints.size(); i++) joints[i] = skeletonJoints[i].finalGlobal;
+}
+
 } // namespace Donut
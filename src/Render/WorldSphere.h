@@ -30,8 +30,10 @@ class WorldSphere
 public:
 	WorldSphere(const P3D::WorldSphere&);
 
-	void Draw(GL::ShaderProgram&, const Matrix4x4& viewProj, bool opaque) const;
+	// joints as published by CopyJoints, the simulation owns the skeleton
+	void Draw(ShaderVariants&, bool opaque, const std::vector<Matrix4x4>& joints) const;
 	void Update(double deltatime);
+	void CopyJoints(std::vector<Matrix4x4>& joints) const;
 
 private:
 	std::string _name;
@@ -1,5 +1,6 @@
 // Copyright 2019-2020 the donut authors. See AUTHORS.md
 
+#include <Game.h>
 #include <P3D/P3D.generated.h>
 #include <Render/Font.h>
 #include <Render/Mesh.h>
@@ -28,6 +29,16 @@ void ResourceManager::LoadTexture(const P3D::Texture& texture)
 	_textures[texture.GetName()] = std::make_unique<Texture>(texture);
 }
 
+void ResourceManager::LoadTexture(std::shared_ptr<const P3D::Texture> source, std::vector<MipChain::Level> levels)
+{
+	const std::string name = source->GetName();
+	if (_textures.find(name) != _textures.end())
+		fmt::print("Texture {0} already loaded\n", name);
+
+	_textures[name] =
+	    std::make_unique<Texture>(name, std::move(levels), std::move(source), Game::GetInstance().GetTextureStreamer());
+}
+
 void ResourceManager::LoadTexture(const P3D::Sprite& sprite)
 {
 	if (_textures.find(sprite.GetName()) != _textures.end())
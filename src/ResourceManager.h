@@ -2,9 +2,12 @@
 
 #pragma once
 
+#include "Render/MipChain.h"
+
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace Donut
 {
@@ -35,6 +38,8 @@ public:
 
 	void LoadTexture(const P3D::Texture&);
 	void LoadTexture(const P3D::Sprite&);
+	// streamed, levels from Texture::Prepare(*source)
+	void LoadTexture(std::shared_ptr<const P3D::Texture> source, std::vector<MipChain::Level> levels);
 	void LoadShader(const P3D::Shader&);
 	void LoadSet(const P3D::Set&);
 	void LoadGeometry(const P3D::Geometry&);
@@ -27,12 +27,14 @@ int main(int argc, char** argv)
 	             "+---------------------------------------------------+\n"
 	          << std::endl;
 
+	int result = EXIT_SUCCESS;
+
 #ifdef NDEBUG
 	try
 	{
 #endif
 		const auto game = std::make_unique<Donut::Game>(argc, argv);
-		game->Run();
+		result = game->Run();
 #ifdef NDEBUG
 	}
 	catch (std::runtime_error& e)
@@ -42,7 +44,7 @@ int main(int argc, char** argv)
 	}
 #endif
 
-	return EXIT_SUCCESS;
+	return result;
 }
 
 #if defined(_WIN32) && !defined(_CONSOLE)